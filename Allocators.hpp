@@ -0,0 +1,328 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Instrumentation.hpp"
+
+namespace matrices {
+
+	/// <summary>
+	/// Allocator that puts every block on an Alignment byte boundary, the default storage of Matrix
+	/// </summary>
+	/// <remarks>64 bytes is a cache line and the width of an AVX-512 register, so rows never start half way through either</remarks>
+	template<class T, size_t Alignment = 64>
+	class AlignedAllocator {
+	public:
+		static_assert(Alignment >= alignof(T) && (Alignment & (Alignment - 1)) == 0,
+			"Alignment has to be a power of two no smaller than the alignment of T");
+
+		using value_type = T;
+		using is_always_equal = std::true_type;
+
+		template<class U>
+		struct rebind {
+			using other = AlignedAllocator<U, Alignment>;
+		};
+
+		AlignedAllocator() noexcept = default;
+
+		template<class U>
+		AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+		T* allocate(size_t count) {
+			if (count > std::numeric_limits<size_t>::max() / sizeof(T))
+				throw std::bad_array_new_length();
+			detail::recordAllocation(count * sizeof(T));
+			return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(Alignment)));
+		}
+
+		void deallocate(T* pointer, size_t) noexcept {
+			::operator delete(pointer, std::align_val_t(Alignment));
+		}
+
+		template<class U>
+		bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept {
+			return true;
+		}
+
+		template<class U>
+		bool operator!=(const AlignedAllocator<U, Alignment>&) const noexcept {
+			return false;
+		}
+	};
+
+	/// <summary>
+	/// Bump allocator for lots of short lived matrices, everything it handed out is released at once by reset()
+	/// </summary>
+	/// <remarks>
+	/// Memory comes from large blocks that are kept between resets, so once the arena has grown to the
+	/// size of one iteration of a loop it never calls malloc again. Freeing the most recent allocation
+	/// gives it back straight away, anything else waits for the next reset. An arena is not thread safe,
+	/// give every thread its own one
+	/// </remarks>
+	class Arena {
+	public:
+		/// <summary>
+		/// Creates an empty arena, nothing is allocated until it is first used
+		/// </summary>
+		/// <param name="blockSize">Size in bytes of the first block, later blocks double in size</param>
+		explicit Arena(size_t blockSize = size_t(1) << 20)
+			: blockSize_(std::max<size_t>(blockSize, BlockAlignment)) {}
+
+		~Arena() {
+			for (auto& block : blocks_)
+				::operator delete(block.data, std::align_val_t(BlockAlignment));
+		}
+
+		Arena(const Arena&) = delete;
+		Arena& operator=(const Arena&) = delete;
+
+		/// <summary>
+		/// Hands out bytes aligned to alignment, which can't be more than 64
+		/// </summary>
+		void* allocate(size_t bytes, size_t alignment) {
+			for (;;) {
+				if (current_ < blocks_.size()) {
+					Block& block = blocks_[current_];
+					size_t start = (offset_ + alignment - 1) & ~(alignment - 1);
+					if (start <= block.size && bytes <= block.size - start) {
+						offset_ = start + bytes;
+						return block.data + start;
+					}
+					if (current_ + 1 < blocks_.size()) {
+						current_++;
+						offset_ = 0;
+						continue;
+					}
+				}
+				size_t size = blocks_.empty() ? blockSize_ : blocks_.back().size * 2;
+				while (size < bytes + alignment)
+					size *= 2;
+				char* data = static_cast<char*>(::operator new(size, std::align_val_t(BlockAlignment)));
+				blocks_.push_back({ data, size });
+				current_ = blocks_.size() - 1;
+				offset_ = 0;
+			}
+		}
+
+		/// <summary>
+		/// Gives the memory back if it was the last thing allocated, otherwise it is kept until reset
+		/// </summary>
+		void deallocate(void* pointer, size_t bytes) noexcept {
+			if (current_ < blocks_.size() && static_cast<char*>(pointer) + bytes == blocks_[current_].data + offset_)
+				offset_ -= bytes;
+		}
+
+		/// <summary>
+		/// Releases everything the arena has handed out, the blocks are kept for reuse
+		/// </summary>
+		/// <remarks>Every container using the arena has to be gone or cleared before this is called</remarks>
+		void reset() noexcept {
+			current_ = 0;
+			offset_ = 0;
+		}
+
+		/// <summary>
+		/// Bytes reserved from the system across all blocks
+		/// </summary>
+		size_t capacity() const noexcept {
+			size_t total = 0;
+			for (auto& block : blocks_)
+				total += block.size;
+			return total;
+		}
+
+	private:
+		static constexpr size_t BlockAlignment = 64;
+
+		struct Block {
+			char* data;
+			size_t size;
+		};
+
+		std::vector<Block> blocks_;
+		size_t current_ = 0;
+		size_t offset_ = 0;
+		size_t blockSize_;
+	};
+
+	/// <summary>
+	/// The arena used by default constructed ArenaAllocators on the calling thread
+	/// </summary>
+	inline Arena& threadArena() {
+		thread_local Arena arena;
+		return arena;
+	}
+
+	/// <summary>
+	/// Allocator that takes its memory from an Arena, use it as Matrix<T, ArenaAllocator<T>>
+	/// </summary>
+	/// <remarks>
+	/// A default constructed allocator uses threadArena(), so matrices only need the allocator in
+	/// their type. Memory is 64 byte aligned for anything up to a cache line in size
+	/// </remarks>
+	template<class T>
+	class ArenaAllocator {
+	public:
+		using value_type = T;
+		using propagate_on_container_copy_assignment = std::true_type;
+		using propagate_on_container_move_assignment = std::true_type;
+		using propagate_on_container_swap = std::true_type;
+
+		template<class U>
+		struct rebind {
+			using other = ArenaAllocator<U>;
+		};
+
+		ArenaAllocator() noexcept
+			: arena_(&threadArena()) {}
+
+		explicit ArenaAllocator(Arena& arena) noexcept
+			: arena_(&arena) {}
+
+		template<class U>
+		ArenaAllocator(const ArenaAllocator<U>& other) noexcept
+			: arena_(other.arena()) {}
+
+		T* allocate(size_t count) {
+			if (count > std::numeric_limits<size_t>::max() / sizeof(T))
+				throw std::bad_array_new_length();
+			size_t alignment = count * sizeof(T) >= 64 ? 64 : alignof(T);
+			detail::recordAllocation(count * sizeof(T));
+			return static_cast<T*>(arena_->allocate(count * sizeof(T), alignment));
+		}
+
+		void deallocate(T* pointer, size_t count) noexcept {
+			arena_->deallocate(pointer, count * sizeof(T));
+		}
+
+		Arena* arena() const noexcept {
+			return arena_;
+		}
+
+		template<class U>
+		bool operator==(const ArenaAllocator<U>& other) const noexcept {
+			return arena_ == other.arena();
+		}
+
+		template<class U>
+		bool operator!=(const ArenaAllocator<U>& other) const noexcept {
+			return arena_ != other.arena();
+		}
+
+	private:
+		Arena* arena_;
+	};
+
+	namespace detail {
+		/// <summary>
+		/// Memory owned by someone else that an ExternalAllocator hands to exactly one container at a time
+		/// </summary>
+		struct ExternalBuffer {
+			void* data;
+			size_t count;
+			bool lent;
+			std::shared_ptr<void> owner;
+		};
+	}
+
+	/// <summary>
+	/// Allocator that gives a container memory that already exists, e.g. a memory mapped file, instead of allocating it
+	/// </summary>
+	/// <remarks>
+	/// The first allocation of exactly count elements gets the external memory and everything else,
+	/// e.g. after a resize, comes zeroed from the heap like AlignedAllocator. Elements constructed
+	/// without a value are left as the memory holds them, so a Matrix built on it sees the data that's
+	/// already there without a copy or even a pass over it, which is why T has to be trivial. owner is
+	/// kept alive for as long as any copy of the allocator exists and is where the memory is released,
+	/// e.g. by unmapping the file. Copies of a container always get memory of their own
+	/// </remarks>
+	template<class T>
+	class ExternalAllocator {
+	public:
+		static_assert(std::is_trivial<T>::value, "External memory can only hold trivial types");
+
+		using value_type = T;
+		using propagate_on_container_move_assignment = std::true_type;
+		using propagate_on_container_swap = std::true_type;
+
+		template<class U>
+		struct rebind {
+			using other = ExternalAllocator<U>;
+		};
+
+		/// <summary>
+		/// Allocator without external memory, everything comes from the heap
+		/// </summary>
+		ExternalAllocator() noexcept = default;
+
+		/// <param name="data">count elements of T, they have to stay valid for as long as owner is alive</param>
+		/// <param name="owner">Released once nothing uses the memory any more, can be empty when the caller looks after it</param>
+		ExternalAllocator(T* data, size_t count, std::shared_ptr<void> owner = nullptr)
+			: buffer_(std::make_shared<detail::ExternalBuffer>(detail::ExternalBuffer{ data, count, false, std::move(owner) })) {}
+
+		template<class U>
+		ExternalAllocator(const ExternalAllocator<U>&) noexcept {}
+
+		ExternalAllocator(const ExternalAllocator&) noexcept = default;
+		ExternalAllocator& operator=(const ExternalAllocator&) noexcept = default;
+
+		T* allocate(size_t count) {
+			if (buffer_ && !buffer_->lent && count == buffer_->count) {
+				buffer_->lent = true;
+				return static_cast<T*>(buffer_->data);
+			}
+			T* pointer = AlignedAllocator<T>().allocate(count);
+			std::memset(static_cast<void*>(pointer), 0, count * sizeof(T));
+			return pointer;
+		}
+
+		void deallocate(T* pointer, size_t count) noexcept {
+			if (buffer_ && pointer == buffer_->data)
+				buffer_->lent = false;
+			else
+				AlignedAllocator<T>().deallocate(pointer, count);
+		}
+
+		/// <summary>
+		/// Leaves the element as the memory holds it instead of value initialising it
+		/// </summary>
+		template<class U>
+		void construct(U* pointer) noexcept {
+			::new(static_cast<void*>(pointer)) U;
+		}
+
+		template<class U, class... Args>
+		void construct(U* pointer, Args&&... args) {
+			::new(static_cast<void*>(pointer)) U(std::forward<Args>(args)...);
+		}
+
+		ExternalAllocator select_on_container_copy_construction() const noexcept {
+			return ExternalAllocator();
+		}
+
+		const std::shared_ptr<detail::ExternalBuffer>& buffer() const noexcept {
+			return buffer_;
+		}
+
+		template<class U>
+		bool operator==(const ExternalAllocator<U>& other) const noexcept {
+			return buffer_ == other.buffer();
+		}
+
+		template<class U>
+		bool operator!=(const ExternalAllocator<U>& other) const noexcept {
+			return buffer_ != other.buffer();
+		}
+
+	private:
+		std::shared_ptr<detail::ExternalBuffer> buffer_;
+	};
+}
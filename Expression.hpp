@@ -0,0 +1,157 @@
+#pragma once
+#include <stdexcept>
+#include <type_traits>
+
+namespace matrices {
+
+	/// <summary>
+	/// Base of everything that can appear in a lazily evaluated matrix expression
+	/// </summary>
+	/// <remarks>
+	/// An expression only describes how every element is computed, nothing is evaluated until it is
+	/// assigned to a Matrix, which then fills itself in a single pass. Derived types have to provide
+	/// value_type, columns(), rows() and elementAt(col, row)
+	/// </remarks>
+	template<class E>
+	struct MatrixExpression {
+		const E& self() const {
+			return static_cast<const E&>(*this);
+		}
+	};
+
+	namespace detail {
+
+		/// <summary>
+		/// Matrices are held by reference inside an expression, intermediate nodes are cheap and held by value
+		/// </summary>
+		template<class E>
+		using ExpressionOperand = typename std::conditional<E::isExpressionLeaf, const E&, const E>::type;
+
+		struct AddOp {
+			template<class L, class R>
+			static constexpr auto apply(const L& l, const R& r) { return l + r; }
+		};
+
+		struct SubOp {
+			template<class L, class R>
+			static constexpr auto apply(const L& l, const R& r) { return l - r; }
+		};
+
+		/// <summary>
+		/// Throws if two operands of an element-wise operation are not the same shape
+		/// </summary>
+		template<class L, class R>
+		void checkSameShape(const MatrixExpression<L>& l, const MatrixExpression<R>& r) {
+			if (l.self().columns() != r.self().columns() || l.self().rows() != r.self().rows())
+				throw std::invalid_argument("Matrix dimensions do not match");
+		}
+	}
+
+	/// <summary>
+	/// Element-wise combination of two expressions of the same shape
+	/// </summary>
+	template<class L, class R, class Op>
+	class BinaryExpression : public MatrixExpression<BinaryExpression<L, R, Op>> {
+	public:
+		using value_type = typename std::common_type<typename L::value_type, typename R::value_type>::type;
+		using left_type = L;
+		using right_type = R;
+		using operation = Op;
+		static constexpr bool isExpressionLeaf = false;
+
+		BinaryExpression(const L& left, const R& right)
+			: left_(left), right_(right) {
+			detail::checkSameShape(left, right);
+		}
+
+		int columns() const { return left_.columns(); }
+		int rows() const { return left_.rows(); }
+
+		value_type elementAt(int col, int row) const {
+			return static_cast<value_type>(Op::apply(left_.elementAt(col, row), right_.elementAt(col, row)));
+		}
+
+		const L& left() const { return left_; }
+		const R& right() const { return right_; }
+
+	private:
+		detail::ExpressionOperand<L> left_;
+		detail::ExpressionOperand<R> right_;
+	};
+
+	/// <summary>
+	/// An expression with every element multiplied by the same scalar
+	/// </summary>
+	/// <remarks>The product is worked out in the common type of the element and the scalar, then converted back</remarks>
+	template<class E, class S>
+	class ScalarExpression : public MatrixExpression<ScalarExpression<E, S>> {
+	public:
+		using value_type = typename E::value_type;
+		static constexpr bool isExpressionLeaf = false;
+
+		ScalarExpression(const E& expression, S scalar)
+			: expression_(expression), scalar_(scalar) {}
+
+		int columns() const { return expression_.columns(); }
+		int rows() const { return expression_.rows(); }
+
+		value_type elementAt(int col, int row) const {
+			return static_cast<value_type>(expression_.elementAt(col, row) * scalar_);
+		}
+
+		const E& expression() const { return expression_; }
+		S scalar() const { return scalar_; }
+
+	private:
+		detail::ExpressionOperand<E> expression_;
+		S scalar_;
+	};
+
+	namespace detail {
+
+		/// <summary>
+		/// Whether an expression is Op applied directly to two leaves of type Leaf, which can skip the generic loop
+		/// </summary>
+		template<class E, class Leaf, class Op>
+		struct IsBinaryOfLeaves : std::false_type {};
+
+		template<class Leaf, class Op>
+		struct IsBinaryOfLeaves<BinaryExpression<Leaf, Leaf, Op>, Leaf, Op> : std::true_type {};
+	}
+
+	/// <summary>
+	/// Lazy element-wise addition, nothing is computed until the result is assigned to a Matrix
+	/// </summary>
+	/// <returns>An expression describing l + r</returns>
+	/// <remarks>Throws std::invalid_argument if the shapes differ</remarks>
+	template<class L, class R>
+	BinaryExpression<L, R, detail::AddOp> operator+(const MatrixExpression<L>& l, const MatrixExpression<R>& r) {
+		return BinaryExpression<L, R, detail::AddOp>(l.self(), r.self());
+	}
+
+	/// <summary>
+	/// Lazy element-wise subtraction, nothing is computed until the result is assigned to a Matrix
+	/// </summary>
+	/// <returns>An expression describing l - r</returns>
+	/// <remarks>Throws std::invalid_argument if the shapes differ</remarks>
+	template<class L, class R>
+	BinaryExpression<L, R, detail::SubOp> operator-(const MatrixExpression<L>& l, const MatrixExpression<R>& r) {
+		return BinaryExpression<L, R, detail::SubOp>(l.self(), r.self());
+	}
+
+	/// <summary>
+	/// Lazy multiplication of every element by a scalar
+	/// </summary>
+	template<class E, class S, typename std::enable_if<std::is_arithmetic<S>::value, int>::type = 0>
+	ScalarExpression<E, S> operator*(const MatrixExpression<E>& e, S scalar) {
+		return ScalarExpression<E, S>(e.self(), scalar);
+	}
+
+	/// <summary>
+	/// Lazy multiplication of every element by a scalar
+	/// </summary>
+	template<class E, class S, typename std::enable_if<std::is_arithmetic<S>::value, int>::type = 0>
+	ScalarExpression<E, S> operator*(S scalar, const MatrixExpression<E>& e) {
+		return ScalarExpression<E, S>(e.self(), scalar);
+	}
+}
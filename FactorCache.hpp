@@ -0,0 +1,170 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "Allocators.hpp"
+#include "Factorizations.hpp"
+
+namespace matrices {
+
+	/// <summary>
+	/// The norms getNorm can give
+	/// </summary>
+	enum class Norm {
+		Frobenius,  // square root of the sum of the squares of every element
+		One,        // largest sum of absolute values down a column
+		Infinity,   // largest sum of absolute values along a row
+		Max         // largest absolute value
+	};
+
+	namespace detail {
+
+		/// <summary>
+		/// LU factorisation of a square matrix with partial pivoting, and the determinant that comes with it
+		/// </summary>
+		template<class F>
+		struct LuFactors {
+			template<class T>
+			LuFactors(int n, const T* elements)
+				: lu(elements, elements + static_cast<size_t>(n) * n), pivots(n) {
+				info = luFactor(n, lu.data(), n, pivots.data());
+				determinant = luDeterminant(n, lu.data(), n, pivots.data());
+			}
+
+			std::vector<F, AlignedAllocator<F>> lu;
+			std::vector<int> pivots;
+			int info;           // 1 + the first column with a zero pivot, 0 if the matrix isn't singular
+			double determinant;
+		};
+
+		/// <summary>
+		/// Cholesky factor L of a symmetric positive definite matrix, only its lower triangle means anything
+		/// </summary>
+		template<class F>
+		struct CholeskyFactors {
+			template<class T>
+			CholeskyFactors(int n, const T* elements)
+				: l(elements, elements + static_cast<size_t>(n) * n) {
+				info = choleskyFactor(n, l.data(), n);
+			}
+
+			std::vector<F, AlignedAllocator<F>> l;
+			int info;           // 1 + the column where the matrix turned out not to be positive definite, 0 if it is
+		};
+
+		/// <summary>
+		/// The trace and norms, all worked out in a single pass over the elements
+		/// </summary>
+		struct MatrixSummary {
+			template<class T>
+			MatrixSummary(int columns, int rows, const T* elements) {
+				std::vector<double> columnSums(columns);
+				double squares = 0;
+				for (int row = 0; row < rows; row++) {
+					const T* r = elements + static_cast<size_t>(row) * columns;
+					double rowSum = 0;
+					for (int col = 0; col < columns; col++) {
+						double v = std::abs(static_cast<double>(r[col]));
+						squares += v * v;
+						rowSum += v;
+						columnSums[col] += v;
+						max = std::max(max, v);
+					}
+					infinity = std::max(infinity, rowSum);
+					if (row < columns)
+						trace += static_cast<double>(r[row]);
+				}
+				for (double sum : columnSums)
+					one = std::max(one, sum);
+				frobenius = std::sqrt(squares);
+			}
+
+			double trace = 0, frobenius = 0, one = 0, infinity = 0, max = 0;
+		};
+
+		/// <summary>
+		/// What a matrix knows about itself that is expensive to work out, kept from the first time it's asked
+		/// for until the matrix changes
+		/// </summary>
+		/// <remarks>
+		/// Const member functions of a matrix can be called from several threads at once, so every entry is an
+		/// immutable object behind a shared_ptr that is loaded and stored atomically. Two threads asking at the
+		/// same time may both work an entry out, one of them is kept. Copies share the entries. clear() is only
+		/// called by whoever is changing the matrix, which can't overlap with anyone reading it
+		/// </remarks>
+		template<class F>
+		class FactorCache {
+		public:
+			FactorCache() = default;
+
+			FactorCache(const FactorCache& other) noexcept {
+				*this = other;
+			}
+
+			FactorCache& operator=(const FactorCache& other) noexcept {
+				if (this != &other) {
+					std::atomic_store(&lu_, std::atomic_load(&other.lu_));
+					std::atomic_store(&cholesky_, std::atomic_load(&other.cholesky_));
+					std::atomic_store(&summary_, std::atomic_load(&other.summary_));
+					filled_.store(other.filled_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+				}
+				return *this;
+			}
+
+			/// <summary>
+			/// Forgets everything, a single relaxed load when there was nothing to forget
+			/// </summary>
+			void clear() noexcept {
+				if (!filled_.load(std::memory_order_relaxed))
+					return;
+				std::atomic_store(&lu_, std::shared_ptr<const LuFactors<F>>());
+				std::atomic_store(&cholesky_, std::shared_ptr<const CholeskyFactors<F>>());
+				std::atomic_store(&summary_, std::shared_ptr<const MatrixSummary>());
+				filled_.store(false, std::memory_order_relaxed);
+			}
+
+			/// <summary>
+			/// The LU factorisation if it has been worked out already, empty otherwise
+			/// </summary>
+			std::shared_ptr<const LuFactors<F>> cachedLu() const noexcept {
+				return std::atomic_load(&lu_);
+			}
+
+			template<class T>
+			std::shared_ptr<const LuFactors<F>> lu(int n, const T* elements) {
+				return get(lu_, [&] { return std::make_shared<const LuFactors<F>>(n, elements); });
+			}
+
+			template<class T>
+			std::shared_ptr<const CholeskyFactors<F>> cholesky(int n, const T* elements) {
+				return get(cholesky_, [&] { return std::make_shared<const CholeskyFactors<F>>(n, elements); });
+			}
+
+			template<class T>
+			std::shared_ptr<const MatrixSummary> summary(int columns, int rows, const T* elements) {
+				return get(summary_, [&] { return std::make_shared<const MatrixSummary>(columns, rows, elements); });
+			}
+
+		private:
+			template<class P, class Make>
+			P get(P& slot, const Make& make) {
+				P entry = std::atomic_load(&slot);
+				if (!entry) {
+					entry = make();
+					std::atomic_store(&slot, entry);
+					filled_.store(true, std::memory_order_relaxed);
+				}
+				return entry;
+			}
+
+			std::shared_ptr<const LuFactors<F>> lu_;
+			std::shared_ptr<const CholeskyFactors<F>> cholesky_;
+			std::shared_ptr<const MatrixSummary> summary_;
+			std::atomic<bool> filled_{ false };
+		};
+	}
+}
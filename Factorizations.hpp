@@ -0,0 +1,554 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "Gemm.hpp"
+#include "ThreadPool.hpp"
+
+namespace matrices {
+
+	/// <summary>
+	/// How solve works out X in A * X = B
+	/// </summary>
+	enum class Solver {
+		Auto,       // LU when A is square, QR when it has more rows than columns
+		LU,         // partial pivoting, any square A that isn't singular
+		Cholesky,   // symmetric positive definite A, half the work of LU and no pivoting
+		QR          // Householder, the least squares solution when A has more rows than columns
+	};
+
+	namespace detail {
+
+		/// <summary>
+		/// The type factorisations are done in, floating point types use their own and everything else double
+		/// </summary>
+		template<class T>
+		using FactorType = typename std::conditional<std::is_floating_point<T>::value, T, double>::type;
+
+		/// <summary>
+		/// Width of the column panels in the blocked factorizations, the trailing updates are gemm calls of this depth
+		/// </summary>
+		constexpr int FactorizationBlock = 64;
+
+		/// <summary>
+		/// Swaps two rows of a row major matrix
+		/// </summary>
+		template<class T>
+		void swapRows(T* a, std::ptrdiff_t lda, int n, int r1, int r2) {
+			if (r1 != r2)
+				std::swap_ranges(a + r1 * lda, a + r1 * lda + n, a + r2 * lda);
+		}
+
+		/// <summary>
+		/// Unblocked LU with partial pivoting of the panel made of columns k to k + nb and rows k to n
+		/// </summary>
+		/// <returns>1 + the first column with an exactly zero pivot, 0 if there wasn't one</returns>
+		/// <remarks>Row swaps are applied across the whole width of the matrix straight away</remarks>
+		template<class T>
+		int luPanel(int n, int k, int nb, T* a, std::ptrdiff_t lda, int* pivots) {
+			using std::abs;
+			int info = 0;
+			for (int j = k; j < k + nb; j++) {
+				int p = j;
+				auto best = abs(a[j * lda + j]);
+				for (int i = j + 1; i < n; i++) {
+					auto v = abs(a[i * lda + j]);
+					if (v > best) {
+						best = v;
+						p = i;
+					}
+				}
+				pivots[j] = p;
+				swapRows(a, lda, n, j, p);
+
+				T pivot = a[j * lda + j];
+				if (pivot == T()) {
+					if (info == 0)
+						info = j + 1;
+					continue;
+				}
+				T inverse = T(1) / pivot;
+				const T* rowJ = a + j * lda;
+				for (int i = j + 1; i < n; i++) {
+					T* rowI = a + i * lda;
+					T l = rowI[j] *= inverse;
+					for (int c = j + 1; c < k + nb; c++)
+						rowI[c] -= l * rowJ[c];
+				}
+			}
+			return info;
+		}
+
+		/// <summary>
+		/// In place LU factorisation with partial pivoting, P * A = L * U, blocked right looking
+		/// </summary>
+		/// <param name="n">Rows and columns of the matrix</param>
+		/// <param name="a">Row major matrix, overwritten with U on and above the diagonal and the unit lower L below it</param>
+		/// <param name="pivots">n entries, row i was swapped with row pivots[i]</param>
+		/// <returns>1 + the first column with an exactly zero pivot, 0 if the matrix is not singular</returns>
+		template<class T>
+		int luFactor(int n, T* a, std::ptrdiff_t lda, int* pivots) {
+			int info = 0;
+			for (int k = 0; k < n; k += FactorizationBlock) {
+				int nb = std::min(FactorizationBlock, n - k);
+				int panelInfo = luPanel(n, k, nb, a, lda, pivots);
+				if (info == 0 && panelInfo != 0)
+					info = panelInfo;
+
+				int rest = n - k - nb;
+				if (rest <= 0)
+					continue;
+				// U12 = inverse(L11) * A12, row by row so every update is a contiguous axpy, columns are independent
+				T* a12 = a + k * lda + k + nb;
+				parallelFor(0, rest, 256, static_cast<size_t>(nb) * nb * rest, [&](std::ptrdiff_t first, std::ptrdiff_t last) {
+					for (int r = 1; r < nb; r++) {
+						const T* l = a + (k + r) * lda + k;
+						T* row = a12 + r * lda;
+						for (int i = 0; i < r; i++) {
+							T factor = l[i];
+							const T* src = a12 + i * lda;
+							for (std::ptrdiff_t c = first; c < last; c++)
+								row[c] -= factor * src[c];
+						}
+					}
+				});
+				// A22 -= L21 * U12
+				gemm<T>(rest, rest, nb, T(-1),
+					a + (k + nb) * lda + k, lda, 1,
+					a12, lda, 1, T(1),
+					a + (k + nb) * lda + k + nb, lda, 1);
+			}
+			return info;
+		}
+
+		/// <summary>
+		/// Determinant from an LU factorisation, the product of the pivots with the sign of the permutation
+		/// </summary>
+		template<class T>
+		double luDeterminant(int n, const T* lu, std::ptrdiff_t lda, const int* pivots) {
+			double det = 1.0;
+			for (int i = 0; i < n; i++) {
+				det *= static_cast<double>(lu[i * lda + i]);
+				if (pivots[i] != i)
+					det = -det;
+			}
+			return det;
+		}
+
+		/// <summary>
+		/// Solves A * x = b for a single right hand side from an LU factorisation
+		/// </summary>
+		/// <param name="x">On entry b, on exit the solution</param>
+		template<class T>
+		void luSolveVector(int n, const T* lu, std::ptrdiff_t lda, const int* pivots, T* x) {
+			for (int i = 0; i < n; i++)
+				if (pivots[i] != i)
+					std::swap(x[i], x[pivots[i]]);
+			for (int i = 1; i < n; i++) {
+				const T* row = lu + i * lda;
+				T sum = x[i];
+				for (int j = 0; j < i; j++)
+					sum -= row[j] * x[j];
+				x[i] = sum;
+			}
+			for (int i = n - 1; i >= 0; i--) {
+				const T* row = lu + i * lda;
+				T sum = x[i];
+				for (int j = i + 1; j < n; j++)
+					sum -= row[j] * x[j];
+				x[i] = sum / row[i];
+			}
+		}
+
+		/// <summary>
+		/// Inverts the upper triangle of a square block in place, unblocked
+		/// </summary>
+		template<class T>
+		void invertUpperUnblocked(int n, T* a, std::ptrdiff_t lda) {
+			for (int j = 0; j < n; j++) {
+				a[j * lda + j] = T(1) / a[j * lda + j];
+				T ajj = -a[j * lda + j];
+				// column j above the diagonal = inverse(U[0:j, 0:j]) * column j, top down as row i only needs rows below it
+				for (int i = 0; i < j; i++) {
+					T sum = T();
+					for (int k = i; k < j; k++)
+						sum += a[i * lda + k] * a[k * lda + j];
+					a[i * lda + j] = sum * ajj;
+				}
+			}
+		}
+
+		/// <summary>
+		/// Inverts an upper triangular matrix in place, blocked by columns
+		/// </summary>
+		template<class T>
+		void invertUpper(int n, T* a, std::ptrdiff_t lda) {
+			std::vector<T> block(static_cast<size_t>(n) * FactorizationBlock);
+			for (int j = 0; j < n; j += FactorizationBlock) {
+				int jb = std::min(FactorizationBlock, n - j);
+				// A[0:j, j:j+jb] = inverse(U11) * A[0:j, j:j+jb], U11 already inverted in the earlier steps.
+				// The block is copied first so every row can be worked out independently
+				for (int i = 0; i < j; i++)
+					std::copy(a + i * lda + j, a + i * lda + j + jb, block.begin() + static_cast<size_t>(i) * jb);
+				parallelFor(0, j, 16, static_cast<size_t>(j) * j * jb / 2, [&](std::ptrdiff_t first, std::ptrdiff_t last) {
+					for (std::ptrdiff_t i = first; i < last; i++) {
+						T* out = a + i * lda + j;
+						for (int c = 0; c < jb; c++)
+							out[c] = T();
+						for (int k = static_cast<int>(i); k < j; k++) {
+							T u = a[i * lda + k];
+							const T* src = block.data() + static_cast<size_t>(k) * jb;
+							for (int c = 0; c < jb; c++)
+								out[c] += u * src[c];
+						}
+					}
+				});
+				// A[0:j, j:j+jb] = -A[0:j, j:j+jb] * inverse(U22), every row solved on its own
+				const T* u22 = a + j * lda + j;
+				parallelFor(0, j, 16, static_cast<size_t>(j) * jb * jb, [&](std::ptrdiff_t first, std::ptrdiff_t last) {
+					T row[FactorizationBlock];
+					for (std::ptrdiff_t i = first; i < last; i++) {
+						T* x = a + i * lda + j;
+						for (int c = 0; c < jb; c++) {
+							T sum = x[c];
+							for (int k = 0; k < c; k++)
+								sum -= row[k] * u22[k * lda + c];
+							row[c] = sum / u22[c * lda + c];
+						}
+						for (int c = 0; c < jb; c++)
+							x[c] = -row[c];
+					}
+				});
+				invertUpperUnblocked(jb, a + j * lda + j, lda);
+			}
+		}
+
+		/// <summary>
+		/// Turns an LU factorisation into the inverse of the original matrix in place
+		/// </summary>
+		/// <remarks>Solves inverse(A) * L = inverse(U) one block column at a time from the right, then undoes the pivoting on the columns</remarks>
+		template<class T>
+		void luInvert(int n, T* a, std::ptrdiff_t lda, const int* pivots) {
+			invertUpper(n, a, lda);
+
+			int nb = FactorizationBlock;
+			std::vector<T> work(static_cast<size_t>(n) * nb);
+			int last = (n - 1) / nb * nb;
+			for (int j = last; j >= 0; j -= nb) {
+				int jb = std::min(nb, n - j);
+				// move the strictly lower part of this block column of L out of the way
+				for (int i = j; i < n; i++)
+					for (int c = 0; c < jb; c++) {
+						if (i > j + c) {
+							work[static_cast<size_t>(i) * nb + c] = a[i * lda + j + c];
+							a[i * lda + j + c] = T();
+						}
+						else {
+							work[static_cast<size_t>(i) * nb + c] = T();
+						}
+					}
+				if (j + jb < n)
+					gemm<T>(n, jb, n - j - jb, T(-1),
+						a + j + jb, lda, 1,
+						work.data() + static_cast<size_t>(j + jb) * nb, nb, 1, T(1),
+						a + j, lda, 1);
+				// X * L22 = B with L22 unit lower triangular, every row on its own
+				parallelFor(0, n, 16, static_cast<size_t>(n) * jb * jb, [&](std::ptrdiff_t first, std::ptrdiff_t last) {
+					for (std::ptrdiff_t i = first; i < last; i++) {
+						T* x = a + i * lda + j;
+						for (int c = jb - 1; c >= 0; c--) {
+							T sum = x[c];
+							for (int k = c + 1; k < jb; k++)
+								sum -= x[k] * work[static_cast<size_t>(j + k) * nb + c];
+							x[c] = sum;
+						}
+					}
+				});
+			}
+
+			for (int j = n - 2; j >= 0; j--) {
+				int p = pivots[j];
+				if (p != j)
+					for (int i = 0; i < n; i++)
+						std::swap(a[i * lda + j], a[i * lda + p]);
+			}
+		}
+
+		/// <summary>
+		/// Inverts a square matrix in place through its LU factorisation
+		/// </summary>
+		/// <returns>False if the matrix is singular, in which case it is left as it was</returns>
+		/// <remarks>
+		/// A copy of the matrix is put back when it turns out to be singular. Multiplying the factors back
+		/// together would round, and the matrix has to be given back bit for bit
+		/// </remarks>
+		template<class T>
+		bool invertInPlace(int n, T* a, std::ptrdiff_t lda) {
+			std::vector<int> pivots(n);
+			std::vector<T> original(static_cast<size_t>(n) * n);
+			for (int i = 0; i < n; i++)
+				std::copy(a + i * lda, a + i * lda + n, original.begin() + static_cast<size_t>(i) * n);
+			if (luFactor(n, a, lda, pivots.data()) != 0) {
+				for (int i = 0; i < n; i++)
+					std::copy(original.begin() + static_cast<size_t>(i) * n, original.begin() + static_cast<size_t>(i + 1) * n, a + i * lda);
+				return false;
+			}
+			luInvert(n, a, lda, pivots.data());
+			return true;
+		}
+
+		/// <summary>
+		/// Solves T * X = B in place for a triangular n x n T, blocked so everything off the diagonal is a gemm call
+		/// </summary>
+		/// <param name="lower">Whether T is lower or upper triangular, the other triangle is never read</param>
+		/// <param name="unit">Whether T has an implicit unit diagonal, as L of an LU factorisation does</param>
+		/// <param name="t">Element i, j of T is t[i * rst + j * cst], swapping the strides solves with the transpose</param>
+		/// <param name="b">Row major n x nrhs, on exit X</param>
+		template<class T>
+		void triangularSolve(bool lower, bool unit, int n, int nrhs, const T* t, std::ptrdiff_t rst, std::ptrdiff_t cst, T* b, std::ptrdiff_t ldb) {
+			int nb = FactorizationBlock;
+			// X1 = inverse(T11) * B1 for one diagonal block, every right hand side is independent
+			auto diagonal = [&](int k, int kb) {
+				const T* tkk = t + k * rst + k * cst;
+				T* bk = b + k * ldb;
+				parallelFor(0, nrhs, 256, static_cast<size_t>(kb) * kb * nrhs, [&](std::ptrdiff_t first, std::ptrdiff_t last) {
+					for (int s = 0; s < kb; s++) {
+						int i = lower ? s : kb - 1 - s;
+						T* row = bk + i * ldb;
+						int from = lower ? 0 : i + 1, to = lower ? i : kb;
+						for (int j = from; j < to; j++) {
+							T factor = tkk[i * rst + j * cst];
+							const T* src = bk + j * ldb;
+							for (std::ptrdiff_t c = first; c < last; c++)
+								row[c] -= factor * src[c];
+						}
+						if (!unit) {
+							T inverse = T(1) / tkk[i * rst + i * cst];
+							for (std::ptrdiff_t c = first; c < last; c++)
+								row[c] *= inverse;
+						}
+					}
+				});
+			};
+
+			if (lower) {
+				for (int k = 0; k < n; k += nb) {
+					int kb = std::min(nb, n - k);
+					diagonal(k, kb);
+					// B2 -= T21 * X1
+					if (k + kb < n)
+						gemm<T>(n - k - kb, nrhs, kb, T(-1),
+							t + (k + kb) * rst + k * cst, rst, cst,
+							b + k * ldb, ldb, 1, T(1),
+							b + (k + kb) * ldb, ldb, 1);
+				}
+			}
+			else {
+				for (int k = (n - 1) / nb * nb; k >= 0; k -= nb) {
+					int kb = std::min(nb, n - k);
+					diagonal(k, kb);
+					// B0 -= T01 * X1
+					if (k > 0)
+						gemm<T>(k, nrhs, kb, T(-1),
+							t + k * cst, rst, cst,
+							b + k * ldb, ldb, 1, T(1),
+							b, ldb, 1);
+				}
+			}
+		}
+
+		/// <summary>
+		/// Solves A * X = B in place from an LU factorisation, B is row major n x nrhs
+		/// </summary>
+		template<class T>
+		void luSolve(int n, int nrhs, const T* lu, std::ptrdiff_t lda, const int* pivots, T* b, std::ptrdiff_t ldb) {
+			for (int i = 0; i < n; i++)
+				swapRows(b, ldb, nrhs, i, pivots[i]);
+			triangularSolve(true, true, n, nrhs, lu, lda, 1, b, ldb);
+			triangularSolve(false, false, n, nrhs, lu, lda, 1, b, ldb);
+		}
+
+		/// <summary>
+		/// In place Cholesky factorisation A = L * L^T of a symmetric positive definite matrix, blocked right looking
+		/// </summary>
+		/// <param name="a">Row major, only the lower triangle is read and it is overwritten with L. The strict upper triangle of the diagonal blocks is used as scratch</param>
+		/// <returns>1 + the first column where the matrix turned out not to be positive definite, 0 if it is</returns>
+		template<class T>
+		int choleskyFactor(int n, T* a, std::ptrdiff_t lda) {
+			using std::sqrt;
+			int nb = FactorizationBlock;
+			for (int k = 0; k < n; k += nb) {
+				int kb = std::min(nb, n - k);
+				// L11, the columns before k were already taken off by the trailing updates
+				for (int j = k; j < k + kb; j++) {
+					T* rowJ = a + j * lda;
+					T d = rowJ[j];
+					for (int p = k; p < j; p++)
+						d -= rowJ[p] * rowJ[p];
+					if (!(d > T()))
+						return j + 1;
+					d = rowJ[j] = sqrt(d);
+					for (int i = j + 1; i < k + kb; i++) {
+						T* rowI = a + i * lda;
+						T sum = rowI[j];
+						for (int p = k; p < j; p++)
+							sum -= rowI[p] * rowJ[p];
+						rowI[j] = sum / d;
+					}
+				}
+
+				int rest = n - k - kb;
+				if (rest <= 0)
+					continue;
+				// L21 = A21 * inverse(L11)^T, every row on its own
+				parallelFor(k + kb, n, 16, static_cast<size_t>(rest) * kb * kb, [&](std::ptrdiff_t first, std::ptrdiff_t last) {
+					for (std::ptrdiff_t i = first; i < last; i++) {
+						T* row = a + i * lda;
+						for (int j = k; j < k + kb; j++) {
+							const T* rowJ = a + j * lda;
+							T sum = row[j];
+							for (int p = k; p < j; p++)
+								sum -= row[p] * rowJ[p];
+							row[j] = sum / rowJ[j];
+						}
+					}
+				});
+				// A22 -= L21 * L21^T, one block row at a time so only the lower triangle is worked out
+				const T* l21 = a + (k + kb) * lda + k;
+				for (int i = 0; i < rest; i += nb) {
+					int ib = std::min(nb, rest - i);
+					gemm<T>(ib, i + ib, kb, T(-1),
+						l21 + i * lda, lda, 1,
+						l21, 1, lda, T(1),
+						a + (k + kb + i) * lda + k + kb, lda, 1);
+				}
+			}
+			return 0;
+		}
+
+		/// <summary>
+		/// Solves A * X = B in place from a Cholesky factorisation, B is row major n x nrhs
+		/// </summary>
+		template<class T>
+		void choleskySolve(int n, int nrhs, const T* l, std::ptrdiff_t lda, T* b, std::ptrdiff_t ldb) {
+			triangularSolve(true, false, n, nrhs, l, lda, 1, b, ldb);
+			triangularSolve(false, false, n, nrhs, l, 1, lda, b, ldb);
+		}
+
+		/// <summary>
+		/// Applies H = I - tau * v * v^T from the left to rows x columns of C
+		/// </summary>
+		/// <param name="v">rows entries spaced incv apart, the first one is taken to be 1 whatever is stored there</param>
+		/// <param name="w">columns entries of workspace, every chunk of columns only touches its own part</param>
+		/// <remarks>w = v^T * C then C -= tau * v * w^T, both row by row so every update is a contiguous axpy</remarks>
+		template<class T>
+		void applyReflector(int rows, int columns, const T* v, std::ptrdiff_t incv, T tau, T* c, std::ptrdiff_t ldc, T* w) {
+			if (tau == T())
+				return;
+			parallelFor(0, columns, 256, static_cast<size_t>(rows) * columns * 2, [&](std::ptrdiff_t first, std::ptrdiff_t last) {
+				std::copy(c + first, c + last, w + first);
+				for (int i = 1; i < rows; i++) {
+					T vi = v[i * incv];
+					const T* row = c + i * ldc;
+					for (std::ptrdiff_t j = first; j < last; j++)
+						w[j] += vi * row[j];
+				}
+				for (int i = 0; i < rows; i++) {
+					T factor = tau * (i == 0 ? T(1) : v[i * incv]);
+					T* row = c + i * ldc;
+					for (std::ptrdiff_t j = first; j < last; j++)
+						row[j] -= factor * w[j];
+				}
+			});
+		}
+
+		/// <summary>
+		/// Works out the Householder reflector H = I - tau * v * v^T with H * x = beta * e1
+		/// </summary>
+		/// <param name="x">m entries spaced incx apart, overwritten with beta followed by v without its implicit leading 1</param>
+		/// <returns>tau, 0 when x is already a multiple of e1 and H is the identity</returns>
+		template<class T>
+		T householder(int m, T* x, std::ptrdiff_t incx) {
+			using std::sqrt;
+			T alpha = x[0], sum = T();
+			for (int i = 1; i < m; i++)
+				sum += x[i * incx] * x[i * incx];
+			if (sum == T())
+				return T();
+			T beta = sqrt(alpha * alpha + sum);
+			if (alpha > T())
+				beta = -beta;
+			T scale = T(1) / (alpha - beta);
+			for (int i = 1; i < m; i++)
+				x[i * incx] *= scale;
+			x[0] = beta;
+			return (beta - alpha) / beta;
+		}
+
+		/// <summary>
+		/// In place Householder QR factorisation A = Q * R of an m x n matrix with m >= n
+		/// </summary>
+		/// <param name="a">Row major, overwritten with R on and above the diagonal and the Householder vectors below it</param>
+		/// <param name="tau">n scalars, H_j = I - tau[j] * v_j * v_j^T with an implicit 1 at the top of v_j</param>
+		/// <param name="work">n entries of workspace</param>
+		/// <returns>1 + the first column where R has an exactly zero diagonal, 0 if A has full rank</returns>
+		template<class T>
+		int qrFactor(int m, int n, T* a, std::ptrdiff_t lda, T* tau, T* work) {
+			int info = 0;
+			for (int j = 0; j < n; j++) {
+				T* column = a + j * lda + j;
+				tau[j] = householder(m - j, column, lda);
+				if (column[0] == T() && info == 0)
+					info = j + 1;
+				applyReflector(m - j, n - j - 1, column, lda, tau[j], column + 1, lda, work);
+			}
+			return info;
+		}
+
+		/// <summary>
+		/// Least squares solution of A * X = B in place from a QR factorisation, B is row major m x nrhs
+		/// </summary>
+		/// <param name="work">nrhs entries of workspace</param>
+		/// <remarks>X ends up in the first n rows of B, the rest hold the residuals in the basis of Q</remarks>
+		template<class T>
+		void qrSolve(int m, int n, int nrhs, const T* qr, std::ptrdiff_t lda, const T* tau, T* b, std::ptrdiff_t ldb, T* work) {
+			for (int j = 0; j < n; j++)
+				applyReflector(m - j, nrhs, qr + j * lda + j, lda, tau[j], b + j * ldb, ldb, work);
+			triangularSolve(false, false, n, nrhs, qr, lda, 1, b, ldb);
+		}
+
+		/// <summary>
+		/// Factorises the m x n matrix a in place and solves a * X = b, X ends up in the first n rows of b
+		/// </summary>
+		/// <remarks>Throws std::invalid_argument when the method can't be used or the matrix is singular</remarks>
+		template<class T>
+		void solveSystem(Solver solver, int m, int n, int nrhs, T* a, std::ptrdiff_t lda, T* b, std::ptrdiff_t ldb) {
+			if (solver == Solver::Auto)
+				solver = m == n ? Solver::LU : Solver::QR;
+			if (solver == Solver::QR ? m < n : m != n)
+				throw std::invalid_argument(solver == Solver::QR ? "Matrix has fewer rows than columns" : "Matrix is not n by n");
+
+			if (solver == Solver::LU) {
+				std::vector<int> pivots(n);
+				if (luFactor(n, a, lda, pivots.data()) != 0)
+					throw std::invalid_argument("Matrix is singular");
+				luSolve(n, nrhs, a, lda, pivots.data(), b, ldb);
+			}
+			else if (solver == Solver::Cholesky) {
+				if (choleskyFactor(n, a, lda) != 0)
+					throw std::invalid_argument("Matrix is not positive definite");
+				choleskySolve(n, nrhs, a, lda, b, ldb);
+			}
+			else {
+				std::vector<T> tau(n), work(std::max(n, nrhs));
+				if (qrFactor(m, n, a, lda, tau.data(), work.data()) != 0)
+					throw std::invalid_argument("Matrix is singular");
+				qrSolve(m, n, nrhs, a, lda, tau.data(), b, ldb, work.data());
+			}
+		}
+	}
+}
@@ -0,0 +1,421 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Expression.hpp"
+#include "Factorizations.hpp"
+#include "TextFormat.hpp"
+
+namespace matrices {
+
+	/// <summary>
+	/// Matrix with its size fixed at compile time, stored inline with no heap allocation
+	/// </summary>
+	/// <remarks>
+	/// Meant for the small matrices of geometry code, 2x2 to 4x4 mostly. Products, sums and transposes
+	/// are unrolled completely at compile time and the determinant and inverse up to 4x4 are closed
+	/// form. Shapes are checked when compiling, so multiplying a 3x4 by a 3x4 doesn't build. Elements are
+	/// addressed col, row like Matrix, and because it is a MatrixExpression it can be mixed with or
+	/// assigned to a Matrix
+	/// </remarks>
+	/// <typeparam name="Rows">Number of rows</typeparam>
+	/// <typeparam name="Columns">Number of columns</typeparam>
+	template<class T, int Rows, int Columns>
+	class FixedMatrix : public MatrixExpression<FixedMatrix<T, Rows, Columns>> {
+		static_assert(Rows > 0 && Columns > 0, "A fixed matrix needs at least one row and one column");
+
+	public:
+		using value_type = T;
+		static constexpr bool isExpressionLeaf = true;
+		static constexpr int rowCount = Rows;
+		static constexpr int columnCount = Columns;
+		static constexpr int elementCount = Rows * Columns;
+
+		// row major like Matrix
+		std::array<T, Rows * Columns> inner_;
+
+		/// <summary>
+		/// Creates a matrix filled with T()
+		/// </summary>
+		constexpr FixedMatrix()
+			: inner_() {}
+
+		/// <summary>
+		/// Creates a matrix from its elements, row by row, e.g. Matrix2d({ 1, 2, 3, 4 })
+		/// </summary>
+		constexpr explicit FixedMatrix(const T (&elements)[Rows * Columns])
+			: inner_() {
+			for (int i = 0; i < Rows * Columns; i++)
+				inner_[i] = elements[i];
+		}
+
+		/// <summary>
+		/// Copies a Matrix or evaluates an expression into a fixed matrix
+		/// </summary>
+		/// <remarks>Throws std::invalid_argument if the shape doesn't match, this is the one check that has to wait until run time</remarks>
+		template<class E>
+		explicit FixedMatrix(const MatrixExpression<E>& expression) {
+			const E& e = expression.self();
+			if (e.columns() != Columns || e.rows() != Rows)
+				throw std::invalid_argument("Matrix dimensions do not match");
+			for (int row = 0; row < Rows; row++)
+				for (int col = 0; col < Columns; col++)
+					inner_[row * Columns + col] = static_cast<T>(e.elementAt(col, row));
+		}
+
+		/// <summary>
+		/// The identity matrix
+		/// </summary>
+		static constexpr FixedMatrix identity() {
+			static_assert(Rows == Columns, "Only a square matrix has an identity");
+			FixedMatrix result;
+			for (int i = 0; i < Rows; i++)
+				result.inner_[i * Columns + i] = T(1);
+			return result;
+		}
+
+		static constexpr int columns() { return Columns; }
+		static constexpr int rows() { return Rows; }
+
+		/// <summary>
+		/// Unchecked read of the element at col, row, used when the matrix is part of an expression
+		/// </summary>
+		constexpr const T& elementAt(int col, int row) const {
+			return inner_[row * Columns + col];
+		}
+
+		/// <summary>
+		/// Returns a value at the specified position within the matrix
+		/// </summary>
+		/// <remarks>Will throw an error if out of range</remarks>
+		T& getAt(int col, int row) {
+			if (isOutOfRange(col, row))
+				throw std::out_of_range("Index out of range");
+			return inner_[row * Columns + col];
+		}
+
+		/// <summary>
+		/// Returns a value at the specified position within the matrix
+		/// </summary>
+		/// <remarks>Will throw an error if out of range</remarks>
+		const T& getAt(int col, int row) const {
+			if (isOutOfRange(col, row))
+				throw std::out_of_range("Index out of range");
+			return inner_[row * Columns + col];
+		}
+
+		/// <summary>
+		/// Add an element to the matrix at a specific position
+		/// </summary>
+		void add(T value, int col, int row) {
+			getAt(col, row) = value;
+		}
+
+		/// <summary>
+		/// Fills the matrix with the passed object
+		/// </summary>
+		constexpr void fill(T objToFill) {
+			for (auto& element : inner_)
+				element = objToFill;
+		}
+
+		/// <summary>
+		/// Returns the determinant of the matrix
+		/// </summary>
+		/// <remarks>Closed form up to 4x4, an LU factorisation of a copy above that</remarks>
+		double getDeterminant() const {
+			static_assert(Rows == Columns, "Matrix is not n by n");
+			using W = factor_type;
+			const T* m = inner_.data();
+			if constexpr (Rows == 1) {
+				return static_cast<double>(m[0]);
+			}
+			else if constexpr (Rows == 2) {
+				return static_cast<double>(W(m[0]) * W(m[3]) - W(m[1]) * W(m[2]));
+			}
+			else if constexpr (Rows == 3) {
+				std::array<W, 9> a = widen();
+				return static_cast<double>(
+					a[0] * (a[4] * a[8] - a[5] * a[7]) -
+					a[1] * (a[3] * a[8] - a[5] * a[6]) +
+					a[2] * (a[3] * a[7] - a[4] * a[6]));
+			}
+			else if constexpr (Rows == 4) {
+				std::array<W, 16> a = widen();
+				Minors4<W> k(a);
+				return static_cast<double>(k.determinant());
+			}
+			else {
+				std::array<W, elementCount> lu = widen();
+				std::array<int, Rows> pivots;
+				detail::luFactor(Rows, lu.data(), Rows, pivots.data());
+				return detail::luDeterminant(Rows, lu.data(), Rows, pivots.data());
+			}
+		}
+
+		/// <summary>
+		/// Inverts the matrix
+		/// </summary>
+		/// <remarks>
+		/// Closed form from the adjugate up to 4x4, LU with partial pivoting above that. Throws
+		/// std::invalid_argument and leaves the matrix as it was if it is singular
+		/// </remarks>
+		void invert() {
+			static_assert(Rows == Columns, "Matrix is not n by n");
+			using W = factor_type;
+			std::array<W, elementCount> a = widen();
+			std::array<W, elementCount> inv;
+			if constexpr (Rows == 1) {
+				if (a[0] == W())
+					throw std::invalid_argument("Matrix is singular");
+				inv[0] = W(1) / a[0];
+			}
+			else if constexpr (Rows == 2) {
+				W det = a[0] * a[3] - a[1] * a[2];
+				if (det == W())
+					throw std::invalid_argument("Matrix is singular");
+				W r = W(1) / det;
+				inv = { a[3] * r, -a[1] * r, -a[2] * r, a[0] * r };
+			}
+			else if constexpr (Rows == 3) {
+				W c0 = a[4] * a[8] - a[5] * a[7];
+				W c1 = a[5] * a[6] - a[3] * a[8];
+				W c2 = a[3] * a[7] - a[4] * a[6];
+				W det = a[0] * c0 + a[1] * c1 + a[2] * c2;
+				if (det == W())
+					throw std::invalid_argument("Matrix is singular");
+				W r = W(1) / det;
+				inv = {
+					c0 * r, (a[2] * a[7] - a[1] * a[8]) * r, (a[1] * a[5] - a[2] * a[4]) * r,
+					c1 * r, (a[0] * a[8] - a[2] * a[6]) * r, (a[2] * a[3] - a[0] * a[5]) * r,
+					c2 * r, (a[1] * a[6] - a[0] * a[7]) * r, (a[0] * a[4] - a[1] * a[3]) * r };
+			}
+			else if constexpr (Rows == 4) {
+				Minors4<W> k(a);
+				W det = k.determinant();
+				if (det == W())
+					throw std::invalid_argument("Matrix is singular");
+				W r = W(1) / det;
+				inv = {
+					(a[5] * k.c5 - a[6] * k.c4 + a[7] * k.c3) * r,
+					(-a[1] * k.c5 + a[2] * k.c4 - a[3] * k.c3) * r,
+					(a[13] * k.s5 - a[14] * k.s4 + a[15] * k.s3) * r,
+					(-a[9] * k.s5 + a[10] * k.s4 - a[11] * k.s3) * r,
+					(-a[4] * k.c5 + a[6] * k.c2 - a[7] * k.c1) * r,
+					(a[0] * k.c5 - a[2] * k.c2 + a[3] * k.c1) * r,
+					(-a[12] * k.s5 + a[14] * k.s2 - a[15] * k.s1) * r,
+					(a[8] * k.s5 - a[10] * k.s2 + a[11] * k.s1) * r,
+					(a[4] * k.c4 - a[5] * k.c2 + a[7] * k.c0) * r,
+					(-a[0] * k.c4 + a[1] * k.c2 - a[3] * k.c0) * r,
+					(a[12] * k.s4 - a[13] * k.s2 + a[15] * k.s0) * r,
+					(-a[8] * k.s4 + a[9] * k.s2 - a[11] * k.s0) * r,
+					(-a[4] * k.c3 + a[5] * k.c1 - a[6] * k.c0) * r,
+					(a[0] * k.c3 - a[1] * k.c1 + a[2] * k.c0) * r,
+					(-a[12] * k.s3 + a[13] * k.s1 - a[14] * k.s0) * r,
+					(a[8] * k.s3 - a[9] * k.s1 + a[10] * k.s0) * r };
+			}
+			else {
+				inv = a;
+				if (!detail::invertInPlace(Rows, inv.data(), Rows))
+					throw std::invalid_argument("Matrix is singular");
+			}
+			for (int i = 0; i < elementCount; i++)
+				inner_[i] = static_cast<T>(inv[i]);
+		}
+
+		/// <summary>
+		/// Returns the inverse as a new matrix, this one is left alone
+		/// </summary>
+		FixedMatrix inverse() const {
+			FixedMatrix result(*this);
+			result.invert();
+			return result;
+		}
+
+		/// <summary>
+		/// Returns the transpose as a new matrix, the rows and columns swap so the type changes as well
+		/// </summary>
+		constexpr FixedMatrix<T, Columns, Rows> transposed() const {
+			return transposed(std::make_index_sequence<elementCount>());
+		}
+
+		/// <summary>
+		/// Transposes this matrix, only square matrices can do this in place
+		/// </summary>
+		constexpr void transpose() {
+			static_assert(Rows == Columns, "Only a square matrix can be transposed in place, use transposed()");
+			*this = transposed();
+		}
+
+		constexpr bool operator==(const FixedMatrix& arg) const {
+			for (int i = 0; i < elementCount; i++)
+				if (inner_[i] != arg.inner_[i])
+					return false;
+			return true;
+		}
+
+		constexpr bool operator!=(const FixedMatrix& arg) const {
+			return !(*this == arg);
+		}
+
+		constexpr FixedMatrix& operator+=(const FixedMatrix& arg) {
+			return *this = *this + arg;
+		}
+
+		constexpr FixedMatrix& operator-=(const FixedMatrix& arg) {
+			return *this = *this - arg;
+		}
+
+		template<int K>
+		constexpr FixedMatrix& operator*=(const FixedMatrix<T, K, Columns>& arg) {
+			static_assert(K == Columns, "Multiplying in place needs a square right hand matrix");
+			return *this = *this * arg;
+		}
+
+		template<class S, typename std::enable_if<std::is_arithmetic<S>::value, int>::type = 0>
+		constexpr FixedMatrix& operator*=(S scalar) {
+			return *this = *this * scalar;
+		}
+
+		/// <summary>
+		/// Writes the matrix out in the same format as Matrix
+		/// </summary>
+		std::string toString(const TextFormat& format = TextFormat()) const {
+			return detail::toText(inner_.data(), Columns, Rows, Columns, 1, format);
+		}
+
+		void print(std::ostream& os, const TextFormat& format = TextFormat()) const {
+			detail::writeText(os, inner_.data(), Columns, Rows, Columns, 1, format);
+		}
+
+		friend std::ostream& operator<<(std::ostream& os, const FixedMatrix& matrix) {
+			matrix.print(os);
+			return os;
+		}
+
+	private:
+		using factor_type = typename std::conditional<std::is_floating_point<T>::value, T, double>::type;
+
+		bool isOutOfRange(int col, int row) const {
+			return col >= Columns || row >= Rows || col < 0 || row < 0;
+		}
+
+		/// <summary>
+		/// Copy of the elements in the type the factorisations are done in
+		/// </summary>
+		std::array<factor_type, elementCount> widen() const {
+			std::array<factor_type, elementCount> result;
+			for (int i = 0; i < elementCount; i++)
+				result[i] = static_cast<factor_type>(inner_[i]);
+			return result;
+		}
+
+		template<size_t... I>
+		constexpr FixedMatrix<T, Columns, Rows> transposed(std::index_sequence<I...>) const {
+			// element I of the result is row I / Rows, column I % Rows of it, so column I / Rows, row I % Rows of this
+			return FixedMatrix<T, Columns, Rows>({ inner_[(I % Rows) * Columns + I / Rows]... });
+		}
+
+		/// <summary>
+		/// The 2x2 minors of the top two and bottom two rows of a 4x4, shared by its determinant and inverse
+		/// </summary>
+		template<class W>
+		struct Minors4 {
+			W s0, s1, s2, s3, s4, s5, c0, c1, c2, c3, c4, c5;
+
+			explicit Minors4(const std::array<W, 16>& a)
+				: s0(a[0] * a[5] - a[1] * a[4]), s1(a[0] * a[6] - a[2] * a[4]), s2(a[0] * a[7] - a[3] * a[4]),
+				s3(a[1] * a[6] - a[2] * a[5]), s4(a[1] * a[7] - a[3] * a[5]), s5(a[2] * a[7] - a[3] * a[6]),
+				c0(a[8] * a[13] - a[9] * a[12]), c1(a[8] * a[14] - a[10] * a[12]), c2(a[8] * a[15] - a[11] * a[12]),
+				c3(a[9] * a[14] - a[10] * a[13]), c4(a[9] * a[15] - a[11] * a[13]), c5(a[10] * a[15] - a[11] * a[14]) {}
+
+			W determinant() const {
+				return s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+			}
+		};
+	};
+
+	namespace detail {
+
+		/// <summary>
+		/// One element of a fixed size product, the sum over the shared dimension is unrolled
+		/// </summary>
+		template<class T, int R, int K, int C, size_t... P>
+		constexpr T fixedDot(const FixedMatrix<T, R, K>& a, const FixedMatrix<T, K, C>& b, int row, int col, std::index_sequence<P...>) {
+			return ((a.inner_[row * K + P] * b.inner_[P * C + col]) + ...);
+		}
+
+		template<class T, int R, int K, int C, size_t... I>
+		constexpr FixedMatrix<T, R, C> fixedProduct(const FixedMatrix<T, R, K>& a, const FixedMatrix<T, K, C>& b, std::index_sequence<I...>) {
+			return FixedMatrix<T, R, C>({ fixedDot(a, b, static_cast<int>(I / C), static_cast<int>(I % C), std::make_index_sequence<K>())... });
+		}
+
+		template<class T, int R, int C, class Op, size_t... I>
+		constexpr FixedMatrix<T, R, C> fixedElementWise(const FixedMatrix<T, R, C>& a, const FixedMatrix<T, R, C>& b, Op, std::index_sequence<I...>) {
+			return FixedMatrix<T, R, C>({ static_cast<T>(Op::apply(a.inner_[I], b.inner_[I]))... });
+		}
+
+		template<class T, int R, int C, class S, size_t... I>
+		constexpr FixedMatrix<T, R, C> fixedScale(const FixedMatrix<T, R, C>& a, S scalar, std::index_sequence<I...>) {
+			return FixedMatrix<T, R, C>({ static_cast<T>(a.inner_[I] * scalar)... });
+		}
+	}
+
+	/// <summary>
+	/// Fixed size matrix multiplication, unrolled at compile time
+	/// </summary>
+	/// <returns>A Rows of a by Columns of b matrix</returns>
+	/// <remarks>Fails to compile if a doesn't have as many columns as b has rows</remarks>
+	template<class T, int R, int K, int K2, int C>
+	constexpr FixedMatrix<T, R, C> operator*(const FixedMatrix<T, R, K>& a, const FixedMatrix<T, K2, C>& b) {
+		static_assert(K == K2, "Matrix dimensions do not match");
+		return detail::fixedProduct(a, b, std::make_index_sequence<R * C>());
+	}
+
+	/// <summary>
+	/// Fixed size element-wise addition, evaluated straight away rather than lazily
+	/// </summary>
+	template<class T, int R, int C, int R2, int C2>
+	constexpr FixedMatrix<T, R, C> operator+(const FixedMatrix<T, R, C>& a, const FixedMatrix<T, R2, C2>& b) {
+		static_assert(R == R2 && C == C2, "Matrix dimensions do not match");
+		return detail::fixedElementWise(a, b, detail::AddOp(), std::make_index_sequence<R * C>());
+	}
+
+	/// <summary>
+	/// Fixed size element-wise subtraction, evaluated straight away rather than lazily
+	/// </summary>
+	template<class T, int R, int C, int R2, int C2>
+	constexpr FixedMatrix<T, R, C> operator-(const FixedMatrix<T, R, C>& a, const FixedMatrix<T, R2, C2>& b) {
+		static_assert(R == R2 && C == C2, "Matrix dimensions do not match");
+		return detail::fixedElementWise(a, b, detail::SubOp(), std::make_index_sequence<R * C>());
+	}
+
+	/// <summary>
+	/// Multiplies every element of a fixed size matrix by a scalar
+	/// </summary>
+	template<class T, int R, int C, class S, typename std::enable_if<std::is_arithmetic<S>::value, int>::type = 0>
+	constexpr FixedMatrix<T, R, C> operator*(const FixedMatrix<T, R, C>& a, S scalar) {
+		return detail::fixedScale(a, scalar, std::make_index_sequence<R * C>());
+	}
+
+	/// <summary>
+	/// Multiplies every element of a fixed size matrix by a scalar
+	/// </summary>
+	template<class T, int R, int C, class S, typename std::enable_if<std::is_arithmetic<S>::value, int>::type = 0>
+	constexpr FixedMatrix<T, R, C> operator*(S scalar, const FixedMatrix<T, R, C>& a) {
+		return detail::fixedScale(a, scalar, std::make_index_sequence<R * C>());
+	}
+
+	using Matrix2d = FixedMatrix<double, 2, 2>;
+	using Matrix3d = FixedMatrix<double, 3, 3>;
+	using Matrix4d = FixedMatrix<double, 4, 4>;
+	using Matrix2f = FixedMatrix<float, 2, 2>;
+	using Matrix3f = FixedMatrix<float, 3, 3>;
+	using Matrix4f = FixedMatrix<float, 4, 4>;
+}
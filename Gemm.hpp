@@ -0,0 +1,319 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "Instrumentation.hpp"
+#include "Precision.hpp"
+#include "ThreadPool.hpp"
+
+namespace matrices {
+	namespace detail {
+
+		/// <summary>
+		/// Per thread scratch memory that is kept between calls so packing buffers aren't reallocated every time
+		/// </summary>
+		/// <remarks>
+		/// A thread that is waiting for its own parallel loop can pick up a task that needs the same
+		/// buffer, so a buffer that is already in use falls back to a plain allocation
+		/// </remarks>
+		template<class T, class Tag>
+		class ScratchBuffer {
+		public:
+			explicit ScratchBuffer(size_t size) {
+				Cache& cache = threadCache();
+				if (!cache.busy) {
+					cache.busy = true;
+					owner_ = &cache;
+					if (cache.data.size() < size) {
+						recordAllocation(size * sizeof(T));
+						cache.data.resize(size);
+					}
+					data_ = cache.data.data();
+				}
+				else {
+					recordAllocation(size * sizeof(T));
+					local_.resize(size);
+					data_ = local_.data();
+				}
+			}
+
+			~ScratchBuffer() {
+				if (owner_)
+					owner_->busy = false;
+			}
+
+			ScratchBuffer(const ScratchBuffer&) = delete;
+			ScratchBuffer& operator=(const ScratchBuffer&) = delete;
+
+			T* data() {
+				return data_;
+			}
+
+		private:
+			struct Cache {
+				std::vector<T> data;
+				bool busy = false;
+			};
+
+			static Cache& threadCache() {
+				thread_local Cache cache;
+				return cache;
+			}
+
+			Cache* owner_ = nullptr;
+			std::vector<T> local_;
+			T* data_;
+		};
+
+		/// <summary>
+		/// Keeps a parameter out of template argument deduction, so its type only comes from the template arguments
+		/// </summary>
+		template<class T>
+		struct NonDeducedType {
+			using type = T;
+		};
+
+		template<class T>
+		using NonDeduced = typename NonDeducedType<T>::type;
+
+		struct PackedATag;
+		struct PackedBTag;
+		struct WideCTag;
+
+		/// <summary>
+		/// Register tile and cache block sizes used by the gemm kernel
+		/// </summary>
+		/// <remarks>
+		/// MR x NR is the tile of C kept in registers by the micro-kernel, KC x NR panels of B
+		/// are sized to stay in L1, MC x KC blocks of A in L2 and KC x NC panels of B in L3
+		/// </remarks>
+		template<class T>
+		struct GemmBlocking {
+			static constexpr int MR = 4;
+			static constexpr int NR = 4;
+			static constexpr int KC = 256;
+			static constexpr int MC = 64;
+			static constexpr int NC = 2048;
+		};
+
+		template<>
+		struct GemmBlocking<double> {
+			static constexpr int MR = 6;
+			static constexpr int NR = 8;
+			static constexpr int KC = 256;
+			static constexpr int MC = 72;
+			static constexpr int NC = 4080;
+		};
+
+		template<>
+		struct GemmBlocking<float> {
+			static constexpr int MR = 6;
+			static constexpr int NR = 8;
+			static constexpr int KC = 256;
+			static constexpr int MC = 120;
+			static constexpr int NC = 4080;
+		};
+
+		template<>
+		struct GemmBlocking<std::int32_t> {
+			static constexpr int MR = 6;
+			static constexpr int NR = 8;
+			static constexpr int KC = 256;
+			static constexpr int MC = 120;
+			static constexpr int NC = 4080;
+		};
+
+		/// <summary>
+		/// Copies an mc x kc block of A into row panels of MR elements, zero padding the last panel
+		/// </summary>
+		/// <param name="rsa">Distance between two rows of A</param>
+		/// <param name="csa">Distance between two columns of A</param>
+		/// <remarks>Elements are widened to the accumulator type here, so the narrow type is all that's read from memory</remarks>
+		template<class T, class Acc, int MR>
+		void packA(int mc, int kc, const T* a, std::ptrdiff_t rsa, std::ptrdiff_t csa, Acc* out) {
+			for (int i = 0; i < mc; i += MR) {
+				int rows = std::min(MR, mc - i);
+				for (int p = 0; p < kc; p++) {
+					const T* src = a + i * rsa + p * csa;
+					for (int r = 0; r < rows; r++)
+						out[r] = static_cast<Acc>(src[r * rsa]);
+					for (int r = rows; r < MR; r++)
+						out[r] = Acc();
+					out += MR;
+				}
+			}
+		}
+
+		/// <summary>
+		/// Copies a kc x nc block of B into column panels of NR elements, zero padding the last panel
+		/// </summary>
+		/// <param name="rsb">Distance between two rows of B</param>
+		/// <param name="csb">Distance between two columns of B</param>
+		template<class T, class Acc, int NR>
+		void packB(int kc, int nc, const T* b, std::ptrdiff_t rsb, std::ptrdiff_t csb, Acc* out) {
+			for (int j = 0; j < nc; j += NR) {
+				int cols = std::min(NR, nc - j);
+				for (int p = 0; p < kc; p++) {
+					const T* src = b + p * rsb + j * csb;
+					for (int c = 0; c < cols; c++)
+						out[c] = static_cast<Acc>(src[c * csb]);
+					for (int c = cols; c < NR; c++)
+						out[c] = Acc();
+					out += NR;
+				}
+			}
+		}
+
+		/// <summary>
+		/// Computes an MR x NR tile of C = alpha * A * B + beta * C from packed panels of A and B
+		/// </summary>
+		/// <param name="mr">Rows of the tile that are actually written back</param>
+		/// <param name="nr">Columns of the tile that are actually written back</param>
+		/// <remarks>
+		/// The tile is summed in Acc and only scaled in Scale and rounded to TC when it's written back.
+		/// C is never read when beta is zero so it may hold uninitialised values
+		/// </remarks>
+		template<class Acc, class TC, class Scale, int MR, int NR>
+		void microKernel(int kc, const Acc* a, const Acc* b, Scale alpha, Scale beta, TC* c,
+			std::ptrdiff_t rsc, std::ptrdiff_t csc, int mr, int nr) {
+			Acc acc[MR][NR] = {};
+			for (int p = 0; p < kc; p++) {
+				for (int i = 0; i < MR; i++) {
+					Acc ai = a[i];
+					for (int j = 0; j < NR; j++)
+						acc[i][j] += ai * b[j];
+				}
+				a += MR;
+				b += NR;
+			}
+			for (int i = 0; i < mr; i++) {
+				for (int j = 0; j < nr; j++) {
+					TC& out = c[i * rsc + j * csc];
+					Scale sum = alpha * static_cast<Scale>(acc[i][j]);
+					out = static_cast<TC>(beta == Scale() ? sum : sum + beta * static_cast<Scale>(out));
+				}
+			}
+		}
+
+		/// <summary>
+		/// General matrix multiply, C = alpha * A * B + beta * C
+		/// </summary>
+		/// <param name="m">Rows of A and C</param>
+		/// <param name="n">Columns of B and C</param>
+		/// <param name="k">Columns of A and rows of B</param>
+		/// <remarks>
+		/// Every operand is addressed through a row and a column stride so transposed or strided
+		/// operands can be passed without copying them first. C must not alias A or B.
+		/// Large products are split over blocks of C across the thread pool.
+		/// A and B are stored as T but packed and summed as Acc, which is float for the 16 bit floats and
+		/// int32 for int8, so only the narrow type crosses the memory bus. C is stored as TC and alpha and
+		/// beta are applied in Scale, so an int8 product can be written straight out as scaled floats.
+		/// When TC is not Acc and k takes more than one slice, the slices are summed in Acc for a band of
+		/// rows of C at a time, at most MC x NC elements, so every element is only rounded to TC once
+		/// </remarks>
+		template<class T, class Acc = AccumulatorType<T>, class TC = T, class Scale = Acc>
+		void gemm(int m, int n, int k, NonDeduced<Scale> alpha,
+			const T* a, std::ptrdiff_t rsa, std::ptrdiff_t csa,
+			const T* b, std::ptrdiff_t rsb, std::ptrdiff_t csb, NonDeduced<Scale> beta,
+			TC* c, std::ptrdiff_t rsc, std::ptrdiff_t csc) {
+			using B = GemmBlocking<Acc>;
+			if (m <= 0 || n <= 0)
+				return;
+			if (k <= 0 || alpha == Scale()) {
+				for (int i = 0; i < m; i++)
+					for (int j = 0; j < n; j++) {
+						TC& out = c[i * rsc + j * csc];
+						out = beta == Scale() ? TC() : static_cast<TC>(beta * static_cast<Scale>(out));
+					}
+				return;
+			}
+			if constexpr (!std::is_same<TC, Acc>::value) {
+				if (k > B::KC) {
+					// the sums never hold more than MC x NC elements, a narrow C gets taller bands so B is repacked less often
+					int ncMax = std::min(n, B::NC);
+					int band = std::max(1, B::MC * B::NC / ncMax / B::MC) * B::MC;
+					ScratchBuffer<Acc, WideCTag> sums(static_cast<size_t>(std::min(m, band)) * ncMax);
+					for (int ic = 0; ic < m; ic += band) {
+						int mc = std::min(band, m - ic);
+						for (int jc = 0; jc < n; jc += B::NC) {
+							int nc = std::min(B::NC, n - jc);
+							gemm<T, Acc, Acc, Acc>(mc, nc, k, Acc(1), a + ic * rsa, rsa, csa, b + jc * csb, rsb, csb, Acc(), sums.data(), nc, 1);
+							for (int i = 0; i < mc; i++)
+								for (int j = 0; j < nc; j++) {
+									TC& out = c[(ic + i) * rsc + (jc + j) * csc];
+									Scale sum = alpha * static_cast<Scale>(sums.data()[static_cast<size_t>(i) * nc + j]);
+									out = static_cast<TC>(beta == Scale() ? sum : sum + beta * static_cast<Scale>(out));
+								}
+						}
+					}
+					return;
+				}
+			}
+
+			int kcMax = std::min(k, B::KC);
+			int mcMax = (std::min(m, B::MC) + B::MR - 1) / B::MR * B::MR;
+			int ncMax = (std::min(n, B::NC) + B::NR - 1) / B::NR * B::NR;
+			ScratchBuffer<Acc, PackedBTag> bufB(static_cast<size_t>(ncMax) * kcMax);
+
+			bool parallel = shouldParallelize(static_cast<size_t>(m) * n * k);
+			int threads = parallel ? static_cast<int>(threadPool().size()) : 1;
+			int icBlocks = (m + B::MC - 1) / B::MC;
+
+			for (int jc = 0; jc < n; jc += B::NC) {
+				int nc = std::min(B::NC, n - jc);
+				int panels = (nc + B::NR - 1) / B::NR;
+				// with too few row blocks to keep every thread busy the columns are split as well
+				int groups = 1;
+				if (parallel && icBlocks < 2 * threads)
+					groups = std::min(panels, (2 * threads + icBlocks - 1) / icBlocks);
+				int panelsPerGroup = (panels + groups - 1) / groups;
+				groups = (panels + panelsPerGroup - 1) / panelsPerGroup;
+
+				for (int pc = 0; pc < k; pc += B::KC) {
+					int kc = std::min(B::KC, k - pc);
+					// only the first slice of k scales the existing C, the rest accumulate onto it
+					Scale betaEff = pc == 0 ? beta : Scale(1);
+					Acc* packedB = bufB.data();
+					const T* srcB = b + pc * rsb + jc * csb;
+					auto packPanels = [&](std::ptrdiff_t first, std::ptrdiff_t last) {
+						for (std::ptrdiff_t panel = first; panel < last; panel++) {
+							int j = static_cast<int>(panel) * B::NR;
+							packB<T, Acc, B::NR>(kc, std::min(B::NR, nc - j), srcB + j * csb, rsb, csb, packedB + static_cast<size_t>(j) * kc);
+						}
+					};
+					if (parallel)
+						threadPool().parallelFor(0, panels, 4, packPanels);
+					else
+						packPanels(0, panels);
+
+					auto computeTiles = [&](std::ptrdiff_t first, std::ptrdiff_t last) {
+						ScratchBuffer<Acc, PackedATag> bufA(static_cast<size_t>(mcMax) * kcMax);
+						for (std::ptrdiff_t tile = first; tile < last; tile++) {
+							int ic = static_cast<int>(tile / groups) * B::MC;
+							int mc = std::min(B::MC, m - ic);
+							int jrBegin = static_cast<int>(tile % groups) * panelsPerGroup * B::NR;
+							int jrEnd = std::min(nc, jrBegin + panelsPerGroup * B::NR);
+							packA<T, Acc, B::MR>(mc, kc, a + ic * rsa + pc * csa, rsa, csa, bufA.data());
+							for (int jr = jrBegin; jr < jrEnd; jr += B::NR) {
+								int nr = std::min(B::NR, nc - jr);
+								const Acc* panelB = packedB + static_cast<size_t>(jr) * kc;
+								for (int ir = 0; ir < mc; ir += B::MR) {
+									int mr = std::min(B::MR, mc - ir);
+									microKernel<Acc, TC, Scale, B::MR, B::NR>(kc, bufA.data() + static_cast<size_t>(ir) * kc, panelB,
+										alpha, betaEff, c + (ic + ir) * rsc + (jc + jr) * csc, rsc, csc, mr, nr);
+								}
+							}
+						}
+					};
+					if (parallel)
+						threadPool().parallelFor(0, static_cast<std::ptrdiff_t>(icBlocks) * groups, 1, computeTiles);
+					else
+						computeTiles(0, static_cast<std::ptrdiff_t>(icBlocks) * groups);
+				}
+			}
+		}
+	}
+}
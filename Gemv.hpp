@@ -0,0 +1,101 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+#include "Precision.hpp"
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+
+namespace matrices {
+	namespace detail {
+
+		/// <summary>
+		/// Elements of y the column oriented gemv keeps in cache while it sweeps across the columns of A
+		/// </summary>
+		constexpr int GemvBlock = 2048;
+
+		/// <summary>
+		/// y = alpha * A * x + beta * y for an m x n A, x has n elements and y has m
+		/// </summary>
+		/// <param name="rsa">Distance between two rows of A</param>
+		/// <param name="csa">Distance between two columns of A</param>
+		/// <remarks>
+		/// A is addressed through two strides like in gemm, so swapping them gives A^T * x. With contiguous
+		/// rows every element of y is a vectorised dot product and the rows are split over the pool. With
+		/// contiguous columns, e.g. a transposed row major matrix, x[j] times column j is added to blocks of
+		/// y that stay in cache. When there are too few of those blocks to keep every thread busy the columns
+		/// are split instead and the partial sums added up in order. Either way A is read from memory once.
+		/// y must not alias A or x, types with a wider accumulator go through a plain loop that sums in it
+		/// </remarks>
+		template<class T>
+		void gemv(int m, int n, T alpha, const T* a, std::ptrdiff_t rsa, std::ptrdiff_t csa, const T* x, T beta, T* y) {
+			using Acc = AccumulatorType<T>;
+			if (m <= 0)
+				return;
+			size_t work = static_cast<size_t>(m) * std::max(n, 1);
+			std::ptrdiff_t rowGrain = std::max<std::ptrdiff_t>(1, simd::ParallelChunk / std::max(n, 1));
+
+			if constexpr (std::is_same<Acc, T>::value) {
+				if (csa == 1 && n > 0) {
+					auto dot = simd::kernels<T>().dot;
+					parallelFor(0, m, rowGrain, work, [&](std::ptrdiff_t first, std::ptrdiff_t last) {
+						for (std::ptrdiff_t row = first; row < last; row++) {
+							T sum = alpha * dot(a + row * rsa, x, static_cast<size_t>(n));
+							y[row] = beta == T() ? sum : sum + beta * y[row];
+						}
+					});
+					return;
+				}
+				if (rsa == 1 && n > 0) {
+					auto axpy = simd::kernels<T>().axpy;
+					int blocks = (m + GemvBlock - 1) / GemvBlock;
+					int threads = shouldParallelize(work) ? static_cast<int>(threadPool().size()) : 1;
+					if (blocks >= threads) {
+						parallelFor(0, m, GemvBlock, work, [&](std::ptrdiff_t first, std::ptrdiff_t last) {
+							for (std::ptrdiff_t begin = first; begin < last; begin += GemvBlock) {
+								size_t rows = static_cast<size_t>(std::min<std::ptrdiff_t>(GemvBlock, last - begin));
+								T* out = y + begin;
+								for (size_t i = 0; i < rows; i++)
+									out[i] = beta == T() ? T() : beta * out[i];
+								for (int col = 0; col < n; col++)
+									axpy(alpha * x[col], a + begin + col * csa, out, rows);
+							}
+						});
+						return;
+					}
+
+					int parts = std::min(threads, n);
+					int columnsPerPart = (n + parts - 1) / parts;
+					std::vector<T> partial(static_cast<size_t>(parts) * m);
+					threadPool().parallelFor(0, parts, 1, [&](std::ptrdiff_t first, std::ptrdiff_t last) {
+						for (std::ptrdiff_t part = first; part < last; part++) {
+							T* out = partial.data() + part * m;
+							int end = std::min(n, static_cast<int>(part + 1) * columnsPerPart);
+							for (int col = static_cast<int>(part) * columnsPerPart; col < end; col++)
+								axpy(x[col], a + col * csa, out, static_cast<size_t>(m));
+						}
+					});
+					for (int row = 0; row < m; row++) {
+						T sum = T();
+						for (int part = 0; part < parts; part++)
+							sum += partial[static_cast<size_t>(part) * m + row];
+						y[row] = beta == T() ? alpha * sum : alpha * sum + beta * y[row];
+					}
+					return;
+				}
+			}
+
+			parallelFor(0, m, rowGrain, work, [&](std::ptrdiff_t first, std::ptrdiff_t last) {
+				for (std::ptrdiff_t row = first; row < last; row++) {
+					Acc sum = Acc();
+					for (int col = 0; col < n; col++)
+						sum += static_cast<Acc>(a[row * rsa + col * csa]) * static_cast<Acc>(x[col]);
+					sum *= static_cast<Acc>(alpha);
+					y[row] = static_cast<T>(beta == T() ? sum : sum + static_cast<Acc>(beta) * static_cast<Acc>(y[row]));
+				}
+			});
+		}
+	}
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <numeric>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+namespace matrices {
+	namespace detail {
+
+		/// <summary>
+		/// Elements looked at per band of rows, the coordinates of one band are gathered and then handed to the histogram together
+		/// </summary>
+		/// <remarks>Keeps the gathered coordinates to at most 16 MB however big the matrix is</remarks>
+		constexpr size_t HistogramBand = size_t(1) << 20;
+
+		/// <summary>
+		/// Whether hist->FillN(n, x, w) exists, like TH1::FillN
+		/// </summary>
+		template<class HistT, class = void>
+		struct HasFillN : std::false_type {};
+
+		template<class HistT>
+		struct HasFillN<HistT, std::void_t<decltype(std::declval<HistT&>()->FillN(1, std::declval<const double*>(), std::declval<const double*>()))>>
+			: std::true_type {};
+
+		/// <summary>
+		/// Whether hist->FillN(n, x, y, w) exists, like TH2::FillN
+		/// </summary>
+		template<class HistT, class = void>
+		struct HasFillN2D : std::false_type {};
+
+		template<class HistT>
+		struct HasFillN2D<HistT, std::void_t<decltype(std::declval<HistT&>()->FillN(1, std::declval<const double*>(),
+			std::declval<const double*>(), std::declval<const double*>()))>>
+			: std::true_type {};
+
+		/// <summary>
+		/// Fills hist with the row (and for TwoD the column) of every positive element of a row-major matrix
+		/// </summary>
+		/// <remarks>
+		/// The matrix is worked through in bands of rows. For each band the positive elements of every row
+		/// are counted across the pool, which is a partial histogram of the band, the counts are summed into
+		/// offsets and the coordinates are then written in parallel straight to their place. Fill isn't
+		/// thread safe, so the whole band goes to the histogram in one FillN call, or a tight loop of Fill
+		/// when HistT doesn't have one. Entries, sums of weights and errors come out exactly as if every
+		/// element had been filled on its own
+		/// </remarks>
+		template<bool TwoD, class T, class HistT>
+		void fillHistogram(HistT hist, const T* data, int columns, int rows, double weight) {
+			if (columns <= 0 || rows <= 0)
+				return;
+			int bandRows = static_cast<int>(std::min<size_t>(rows, std::max<size_t>(1, HistogramBand / columns)));
+			std::vector<size_t> offsets(static_cast<size_t>(bandRows) + 1);
+			std::vector<double> x, y, w;
+
+			for (int first = 0; first < rows; first += bandRows) {
+				int last = std::min(rows, first + bandRows);
+				size_t work = static_cast<size_t>(last - first) * columns;
+				std::ptrdiff_t grain = std::max<std::ptrdiff_t>(1, 4096 / columns);
+
+				parallelFor(first, last, grain, work, [&](std::ptrdiff_t begin, std::ptrdiff_t end) {
+					for (std::ptrdiff_t row = begin; row < end; row++) {
+						const T* elements = data + static_cast<size_t>(row) * columns;
+						size_t count = 0;
+						for (int col = 0; col < columns; col++)
+							count += elements[col] > 0;
+						offsets[row - first + 1] = count;
+					}
+				});
+				offsets[0] = 0;
+				std::partial_sum(offsets.begin(), offsets.begin() + (last - first) + 1, offsets.begin());
+				size_t total = offsets[last - first];
+				if (total == 0)
+					continue;
+
+				x.resize(total);
+				if (TwoD)
+					y.resize(total);
+				parallelFor(first, last, grain, work, [&](std::ptrdiff_t begin, std::ptrdiff_t end) {
+					for (std::ptrdiff_t row = begin; row < end; row++) {
+						size_t at = offsets[row - first];
+						if (!TwoD) {
+							std::fill(x.begin() + at, x.begin() + offsets[row - first + 1], static_cast<double>(row));
+							continue;
+						}
+						const T* elements = data + static_cast<size_t>(row) * columns;
+						for (int col = 0; col < columns; col++)
+							if (elements[col] > 0) {
+								x[at] = static_cast<double>(row);
+								y[at] = static_cast<double>(col);
+								at++;
+							}
+					}
+				});
+
+				if constexpr (TwoD ? HasFillN2D<HistT>::value : HasFillN<HistT>::value) {
+					// every weight is the same, so the buffer only grows
+					if (w.size() < total)
+						w.resize(total, weight);
+					if constexpr (TwoD)
+						hist->FillN(static_cast<int>(total), x.data(), y.data(), w.data());
+					else
+						hist->FillN(static_cast<int>(total), x.data(), w.data());
+				}
+				else {
+					for (size_t i = 0; i < total; i++) {
+						if constexpr (TwoD)
+							hist->Fill(x[i], y[i], weight);
+						else
+							hist->Fill(x[i], weight);
+					}
+				}
+			}
+		}
+	}
+}
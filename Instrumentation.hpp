@@ -0,0 +1,264 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <ostream>
+
+#ifdef MATRICES_INSTRUMENTATION
+#include <chrono>
+#endif
+
+namespace matrices {
+
+	/// <summary>
+	/// The operations instrumentation keeps statistics for
+	/// </summary>
+	enum class Operation {
+		Multiply,
+		Invert,
+		Determinant,
+		Cofactor,
+		Transpose,
+		Arithmetic,  // element-wise expressions, +=, -= and scaling
+		Normalise,
+		Solve,
+		Eigensystem,
+		Other,       // allocations and copies made outside any of the above
+		Count
+	};
+
+	inline const char* operationName(Operation operation) {
+		static const char* const names[] = { "multiply", "invert", "determinant", "cofactor", "transpose", "arithmetic", "normalise", "solve", "eigensystem", "other" };
+		return names[static_cast<int>(operation)];
+	}
+
+	/// <summary>
+	/// Totals for one operation since the program started or the last instrumentation::reset()
+	/// </summary>
+	struct OperationStats {
+		/// <summary>
+		/// Latency histogram buckets, bucket i counts calls that took between 2^i and 2^(i+1) nanoseconds
+		/// </summary>
+		static constexpr int LatencyBuckets = 40;
+
+		std::uint64_t calls = 0;
+		std::uint64_t flops = 0;
+		std::uint64_t allocations = 0;
+		std::uint64_t bytesAllocated = 0;
+		std::uint64_t copies = 0;        // whole matrices copied
+		std::uint64_t bytesCopied = 0;
+		std::uint64_t nanoseconds = 0;
+		std::array<std::uint64_t, LatencyBuckets> latency = {};
+
+		/// <summary>
+		/// Upper bound in nanoseconds of the bucket that holds the given fraction of calls, e.g. 0.99 for the 99th percentile
+		/// </summary>
+		std::uint64_t percentile(double fraction) const {
+			std::uint64_t target = static_cast<std::uint64_t>(fraction * calls), seen = 0;
+			for (int i = 0; i < LatencyBuckets; i++) {
+				seen += latency[i];
+				if (seen > target || seen == calls)
+					return std::uint64_t(2) << i;
+			}
+			return std::uint64_t(2) << (LatencyBuckets - 1);
+		}
+	};
+
+	/// <summary>
+	/// What a callback registered with instrumentation::setCallback is told after every instrumented call
+	/// </summary>
+	struct OperationEvent {
+		Operation operation;
+		std::uint64_t flops;
+		std::uint64_t nanoseconds;
+	};
+
+	using OperationStatsTable = std::array<OperationStats, static_cast<size_t>(Operation::Count)>;
+
+	namespace detail {
+		struct AtomicOperationStats {
+			std::atomic<std::uint64_t> calls{ 0 };
+			std::atomic<std::uint64_t> flops{ 0 };
+			std::atomic<std::uint64_t> allocations{ 0 };
+			std::atomic<std::uint64_t> bytesAllocated{ 0 };
+			std::atomic<std::uint64_t> copies{ 0 };
+			std::atomic<std::uint64_t> bytesCopied{ 0 };
+			std::atomic<std::uint64_t> nanoseconds{ 0 };
+			std::array<std::atomic<std::uint64_t>, OperationStats::LatencyBuckets> latency = {};
+		};
+
+		inline std::array<AtomicOperationStats, static_cast<size_t>(Operation::Count)>& operationStats() {
+			static std::array<AtomicOperationStats, static_cast<size_t>(Operation::Count)> stats;
+			return stats;
+		}
+
+		inline std::shared_ptr<const std::function<void(const OperationEvent&)>>& operationCallback() {
+			static std::shared_ptr<const std::function<void(const OperationEvent&)>> callback;
+			return callback;
+		}
+
+		/// <summary>
+		/// The innermost instrumented operation running on this thread, allocations and copies are charged to it
+		/// </summary>
+		inline Operation& currentOperation() {
+			thread_local Operation operation = Operation::Other;
+			return operation;
+		}
+
+		inline void add(std::atomic<std::uint64_t>& counter, std::uint64_t value) {
+			counter.fetch_add(value, std::memory_order_relaxed);
+		}
+
+#ifdef MATRICES_INSTRUMENTATION
+		/// <summary>
+		/// Times an operation from construction to destruction and records it, compiles to nothing without MATRICES_INSTRUMENTATION
+		/// </summary>
+		class OperationScope {
+		public:
+			OperationScope(Operation operation, double flops)
+				: operation_(operation), outer_(currentOperation()), flops_(static_cast<std::uint64_t>(flops)),
+				start_(std::chrono::steady_clock::now()) {
+				currentOperation() = operation;
+			}
+
+			~OperationScope() {
+				std::uint64_t elapsed = static_cast<std::uint64_t>(
+					std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count());
+				currentOperation() = outer_;
+				AtomicOperationStats& stats = operationStats()[static_cast<size_t>(operation_)];
+				add(stats.calls, 1);
+				add(stats.flops, flops_);
+				add(stats.nanoseconds, elapsed);
+				int bucket = 0;
+				while (bucket + 1 < OperationStats::LatencyBuckets && (elapsed >> (bucket + 1)) != 0)
+					bucket++;
+				add(stats.latency[bucket], 1);
+				if (auto callback = std::atomic_load(&operationCallback()))
+					(*callback)(OperationEvent{ operation_, flops_, elapsed });
+			}
+
+			OperationScope(const OperationScope&) = delete;
+			OperationScope& operator=(const OperationScope&) = delete;
+
+		private:
+			Operation operation_;
+			Operation outer_;
+			std::uint64_t flops_;
+			std::chrono::steady_clock::time_point start_;
+		};
+
+		inline void recordAllocation(size_t bytes) {
+			AtomicOperationStats& stats = operationStats()[static_cast<size_t>(currentOperation())];
+			add(stats.allocations, 1);
+			add(stats.bytesAllocated, bytes);
+		}
+
+		inline void recordCopy(size_t bytes) {
+			AtomicOperationStats& stats = operationStats()[static_cast<size_t>(currentOperation())];
+			add(stats.copies, 1);
+			add(stats.bytesCopied, bytes);
+		}
+#else
+		class OperationScope {
+		public:
+			constexpr OperationScope(Operation, double) noexcept {}
+		};
+
+		inline void recordAllocation(size_t) noexcept {}
+		inline void recordCopy(size_t) noexcept {}
+#endif
+	}
+
+	/// <summary>
+	/// Counters, timings and allocation tracking for the expensive operations, enabled by defining
+	/// MATRICES_INSTRUMENTATION before including Matrix.hpp
+	/// </summary>
+	/// <remarks>
+	/// Without the define every hook is empty and inlines away. With it each instrumented call costs two
+	/// clock reads and a few relaxed atomic adds. Allocations and copies are charged to the innermost
+	/// operation running on the same thread, work done by the thread pool's workers counts as Other
+	/// </remarks>
+	namespace instrumentation {
+
+		constexpr bool enabled() {
+#ifdef MATRICES_INSTRUMENTATION
+			return true;
+#else
+			return false;
+#endif
+		}
+
+		/// <summary>
+		/// Copies the current totals of every operation, indexed by Operation
+		/// </summary>
+		inline OperationStatsTable snapshot() {
+			OperationStatsTable table;
+			auto& stats = detail::operationStats();
+			for (size_t i = 0; i < table.size(); i++) {
+				table[i].calls = stats[i].calls.load(std::memory_order_relaxed);
+				table[i].flops = stats[i].flops.load(std::memory_order_relaxed);
+				table[i].allocations = stats[i].allocations.load(std::memory_order_relaxed);
+				table[i].bytesAllocated = stats[i].bytesAllocated.load(std::memory_order_relaxed);
+				table[i].copies = stats[i].copies.load(std::memory_order_relaxed);
+				table[i].bytesCopied = stats[i].bytesCopied.load(std::memory_order_relaxed);
+				table[i].nanoseconds = stats[i].nanoseconds.load(std::memory_order_relaxed);
+				for (int bucket = 0; bucket < OperationStats::LatencyBuckets; bucket++)
+					table[i].latency[bucket] = stats[i].latency[bucket].load(std::memory_order_relaxed);
+			}
+			return table;
+		}
+
+		/// <summary>
+		/// Sets every counter back to zero
+		/// </summary>
+		inline void reset() {
+			for (auto& stats : detail::operationStats()) {
+				for (auto* counter : { &stats.calls, &stats.flops, &stats.allocations, &stats.bytesAllocated, &stats.copies, &stats.bytesCopied, &stats.nanoseconds })
+					counter->store(0, std::memory_order_relaxed);
+				for (auto& bucket : stats.latency)
+					bucket.store(0, std::memory_order_relaxed);
+			}
+		}
+
+		/// <summary>
+		/// Calls callback on the calling thread after every instrumented operation finishes, an empty function removes it
+		/// </summary>
+		/// <remarks>The callback can be called from several threads at once</remarks>
+		inline void setCallback(std::function<void(const OperationEvent&)> callback) {
+			std::shared_ptr<const std::function<void(const OperationEvent&)>> next;
+			if (callback)
+				next = std::make_shared<const std::function<void(const OperationEvent&)>>(std::move(callback));
+			std::atomic_store(&detail::operationCallback(), next);
+		}
+
+		/// <summary>
+		/// Writes a table of every operation that has been used
+		/// </summary>
+		inline void report(std::ostream& os) {
+			if (!enabled()) {
+				os << "matrices instrumentation is off, define MATRICES_INSTRUMENTATION to turn it on\n";
+				return;
+			}
+			char line[256];
+			std::snprintf(line, sizeof(line), "%-12s %10s %12s %10s %14s %8s %14s %12s %10s %10s\n", "operation", "calls", "GFLOP", "allocs",
+				"bytes alloc", "copies", "bytes copied", "total ms", "p50 us", "p99 us");
+			os << line;
+			OperationStatsTable table = snapshot();
+			for (size_t i = 0; i < table.size(); i++) {
+				const OperationStats& stats = table[i];
+				if (stats.calls == 0 && stats.allocations == 0 && stats.copies == 0)
+					continue;
+				std::snprintf(line, sizeof(line), "%-12s %10llu %12.3f %10llu %14llu %8llu %14llu %12.3f %10.1f %10.1f\n",
+					operationName(static_cast<Operation>(i)), static_cast<unsigned long long>(stats.calls), stats.flops * 1e-9,
+					static_cast<unsigned long long>(stats.allocations), static_cast<unsigned long long>(stats.bytesAllocated),
+					static_cast<unsigned long long>(stats.copies), static_cast<unsigned long long>(stats.bytesCopied),
+					stats.nanoseconds * 1e-6, stats.calls ? stats.percentile(0.5) * 1e-3 : 0.0, stats.calls ? stats.percentile(0.99) * 1e-3 : 0.0);
+				os << line;
+			}
+		}
+	}
+}
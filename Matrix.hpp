@@ -5,15 +5,54 @@
 #include <typeinfo>
 #include <iterator>
 #include <cmath>
+#include <algorithm>
+#include <iostream>
+#include <type_traits>
+#include <cstdint>
+
+#include "Allocators.hpp"
+#include "Expression.hpp"
+#include "FactorCache.hpp"
+#include "Factorizations.hpp"
+#include "FixedMatrix.hpp"
+#include "Gemm.hpp"
+#include "Gemv.hpp"
+#include "Histogram.hpp"
+#include "Instrumentation.hpp"
+#include "MatrixBatch.hpp"
+#include "MatrixView.hpp"
+#include "Precision.hpp"
+#include "Simd.hpp"
+#include "Strassen.hpp"
+#include "SymmetricEigen.hpp"
+#include "TextFormat.hpp"
+#include "ThreadPool.hpp"
+#include "Transpose.hpp"
+#include "Vector.hpp"
 
 namespace matrices {
 
-	template <class T, class alloc = std::allocator<T>>
-	class Matrix {
+	template <class T, class alloc = AlignedAllocator<T>>
+	class Matrix : public MatrixExpression<Matrix<T, alloc>> {
 
 	public:
+		using value_type = T;
+		using allocator_type = alloc;
+		using storage_type = std::vector<T, alloc>;
+		static constexpr bool isExpressionLeaf = true;
+
+		/// <summary>
+		/// Largest rectangular matrix, in elements, that transpose() rearranges through a scratch copy
+		/// </summary>
+		static constexpr size_t TransposeScratchLimit = size_t(1) << 22;
+
+		/// <summary>
+		/// Largest product, in elements, that operator*= builds in a per thread scratch buffer, bigger ones get a temporary of their own
+		/// </summary>
+		static constexpr size_t ProductScratchLimit = size_t(1) << 22;
+
 		// public variables
-		std::vector<T> inner_; // set to private later
+		storage_type inner_; // set to private later
 		int dimx_, dimy_; // set to private later
 
 		/// <summary>
@@ -21,9 +60,79 @@ namespace matrices {
 		/// </summary>
 		/// <param name="dimx">Amount of columns</param>
 		/// <param name="dimy">Amount of rows</param>
-		Matrix(int dimx, int dimy)
-			: dimx_(dimx), dimy_(dimy) {
-			inner_.resize(dimx_ * dimy_);
+		/// <param name="allocator">Where the elements are stored, e.g. an ArenaAllocator on a particular Arena</param>
+		Matrix(int dimx, int dimy, const alloc& allocator = alloc())
+			: inner_(allocator), dimx_(dimx), dimy_(dimy) {
+			inner_.resize(static_cast<size_t>(dimx_) * dimy_);
+		}
+
+		Matrix(const Matrix& other)
+			: inner_(other.inner_), dimx_(other.dimx_), dimy_(other.dimy_), cache_(other.cache_) {
+			detail::recordCopy(inner_.size() * sizeof(T));
+		}
+
+		Matrix(Matrix&&) noexcept = default;
+
+		Matrix& operator=(const Matrix& other) {
+			inner_ = other.inner_;
+			dimx_ = other.dimx_;
+			dimy_ = other.dimy_;
+			cache_ = other.cache_;
+			detail::recordCopy(inner_.size() * sizeof(T));
+			return *this;
+		}
+
+		Matrix& operator=(Matrix&&) noexcept = default;
+
+		/// <summary>
+		/// Evaluates an expression such as A + B - C * 2 into a new matrix in a single pass
+		/// </summary>
+		/// <param name="expression">The expression to evaluate</param>
+		/// <param name="allocator">Where the elements are stored</param>
+		template<class E>
+		Matrix(const MatrixExpression<E>& expression, const alloc& allocator = alloc())
+			: inner_(allocator), dimx_(expression.self().columns()), dimy_(expression.self().rows()) {
+			inner_.resize(static_cast<size_t>(dimx_) * dimy_);
+			assign(expression.self());
+		}
+
+		/// <summary>
+		/// Evaluates an expression into this matrix in a single pass, resizing it if the shape differs
+		/// </summary>
+		/// <param name="expression">The expression to evaluate, it may refer to this matrix</param>
+		/// <returns>This matrix</returns>
+		template<class E>
+		Matrix& operator=(const MatrixExpression<E>& expression) {
+			const E& e = expression.self();
+			if (e.columns() != dimx_ || e.rows() != dimy_) {
+				// the old contents are still needed if the expression reads from this matrix
+				Matrix temp(e, inner_.get_allocator());
+				*this = std::move(temp);
+				return *this;
+			}
+			assign(e);
+			return *this;
+		}
+
+		/// <summary>
+		/// Number of columns, used when the matrix is part of an expression
+		/// </summary>
+		int columns() const {
+			return dimx_;
+		}
+
+		/// <summary>
+		/// Number of rows, used when the matrix is part of an expression
+		/// </summary>
+		int rows() const {
+			return dimy_;
+		}
+
+		/// <summary>
+		/// Unchecked read of the element at col, row, used when the matrix is part of an expression
+		/// </summary>
+		const T& elementAt(int col, int row) const {
+			return inner_[dimx_ * row + col];
 		}
 
 		/// <summary>
@@ -34,6 +143,20 @@ namespace matrices {
 		/// <returns>Object requested</returns>
 		/// <remarks>Will throw an error if out of range</remarks>
 		T& getAt(int col, int row) {
+			if (isOutOfRange(col, row))
+				throw std::out_of_range("Index out of range");
+			invalidate();
+			return inner_[dimx_ * row + col];
+		}
+
+		/// <summary>
+		/// Returns a value at the specified position within the matrix
+		/// </summary>
+		/// <param name="col">Position in the row</param>
+		/// <param name="row">Position in the column</param>
+		/// <returns>Object requested</returns>
+		/// <remarks>Will throw an error if out of range</remarks>
+		const T& getAt(int col, int row) const {
 			if (isOutOfRange(col, row))
 				throw std::out_of_range("Index out of range");
 			return inner_[dimx_ * row + col];
@@ -48,31 +171,133 @@ namespace matrices {
 		void add(T value, int col, int row) {
 			if (isOutOfRange(col, row))
 				throw std::out_of_range("Index out of range");
+			invalidate();
 			inner_[dimx_ * row + col] = value;
 		}
 
 		/// <summary>
 		/// Inverts the matrix
 		/// </summary>
+		/// <remarks>
+		/// Uses an LU factorisation with partial pivoting, done in place for floating point matrices, or the
+		/// cached one if the determinant or a cofactor was asked for first.
+		/// Throws std::invalid_argument and leaves every element as it was if it is singular, the in place
+		/// factorisation keeps a copy of the matrix to put back
+		/// </remarks>
 		void invert() {
 			if (dimx_ != dimy_)
 				throw std::invalid_argument("Matrix is not n by n");
-			double det = getDeterminant();
-			Matrix<double> temp(dimx_, dimy_);
-			for (int i = 0; i < dimx_; i++)
-				for (int j = 0; j < dimy_; j++)
-					temp.add(getCofactor(i, j, *this), i, j);
-			(*this) = temp;
-			scalarMultiply(1 / det);
+			detail::OperationScope scope(Operation::Invert, 2.0 * dimx_ * dimx_ * dimx_);
+			if (auto factors = cache_.cachedLu()) {
+				if (factors->info != 0)
+					throw std::invalid_argument("Matrix is singular");
+				factor_storage work(factors->lu);
+				detail::luInvert(dimx_, work.data(), dimx_, factors->pivots.data());
+				for (size_t i = 0; i < work.size(); i++)
+					inner_[i] = static_cast<T>(work[i]);
+			}
+			else if constexpr (std::is_same<factor_type, T>::value) {
+				if (!detail::invertInPlace(dimx_, inner_.data(), dimx_))
+					throw std::invalid_argument("Matrix is singular");
+			}
+			else {
+				factor_storage work(inner_.begin(), inner_.end());
+				if (!detail::invertInPlace(dimx_, work.data(), dimx_))
+					throw std::invalid_argument("Matrix is singular");
+				for (size_t i = 0; i < work.size(); i++)
+					inner_[i] = static_cast<T>(work[i]);
+			}
+			invalidate();
 		}
 
 		/// <summary>
 		/// Returns the determinant of the matrix
 		/// </summary>
-		/// <returns>The deteminant as an integer</returns>
-		/// TODO : add to a specialised templated class, won't work with matrices of types other than numbers
-		double getDeterminant() {
-			return determinant(*this);
+		/// <returns>The deteminant as a double</returns>
+		/// <remarks>Worked out from an LU factorisation of a copy, O(n^3) the first time and O(1) until the matrix changes</remarks>
+		double getDeterminant() const {
+			if (dimx_ != dimy_)
+				throw std::invalid_argument("Matrix is not n by n");
+			detail::OperationScope scope(Operation::Determinant, 2.0 * dimx_ * dimx_ * dimx_ / 3);
+			return luFactors()->determinant;
+		}
+
+		/// <summary>
+		/// Returns the sum of the elements on the diagonal
+		/// </summary>
+		/// <remarks>Worked out together with the norms and kept until the matrix changes</remarks>
+		double getTrace() const {
+			if (dimx_ != dimy_)
+				throw std::invalid_argument("Matrix is not n by n");
+			return summary()->trace;
+		}
+
+		/// <summary>
+		/// Returns a norm of the matrix
+		/// </summary>
+		/// <param name="norm">Which one, Frobenius if not given</param>
+		/// <remarks>Every norm comes out of the same pass over the elements and is kept until the matrix changes</remarks>
+		double getNorm(Norm norm = Norm::Frobenius) const {
+			auto values = summary();
+			switch (norm) {
+			case Norm::One:
+				return values->one;
+			case Norm::Infinity:
+				return values->infinity;
+			case Norm::Max:
+				return values->max;
+			default:
+				return values->frobenius;
+			}
+		}
+
+		/// <summary>
+		/// Returns the eigenvalues of a symmetric matrix in ascending order
+		/// </summary>
+		/// <param name="method">Jacobi rotations for small matrices and a tridiagonal reduction for the rest unless told otherwise</param>
+		/// <remarks>
+		/// Only the lower triangle is read, symmetry isn't checked. Skips everything to do with eigenvectors, so
+		/// for large matrices it is several times quicker than eigenSystem. Integer matrices give double eigenvalues
+		/// </remarks>
+		std::vector<detail::FactorType<T>> getEigenvalues(EigenMethod method = EigenMethod::Auto) const {
+			if (dimx_ != dimy_)
+				throw std::invalid_argument("Matrix is not n by n");
+			detail::OperationScope scope(Operation::Eigensystem, 4.0 * dimx_ * dimx_ * dimx_ / 3);
+			factor_storage work = detail::symmetricCopy<factor_type>(dimx_, inner_.data());
+			std::vector<factor_type> values(dimx_);
+			detail::symmetricEigen(method, dimx_, work.data(), dimx_, values.data(), static_cast<factor_type*>(nullptr), dimx_);
+			return values;
+		}
+
+		/// <summary>
+		/// The LU factorisation of this matrix, worked out the first time it's needed and kept until the matrix changes
+		/// </summary>
+		/// <remarks>Shared with the determinant, cofactors, invert() and solve(). Its info is non zero if the matrix is singular</remarks>
+		std::shared_ptr<const detail::LuFactors<detail::FactorType<T>>> luFactors() const {
+			if (dimx_ != dimy_)
+				throw std::invalid_argument("Matrix is not n by n");
+			return cache_.lu(dimx_, inner_.data());
+		}
+
+		/// <summary>
+		/// The Cholesky factorisation of this matrix, worked out the first time it's needed and kept until the matrix changes
+		/// </summary>
+		/// <remarks>Used by solve() with Solver::Cholesky. Its info is non zero if the matrix isn't positive definite</remarks>
+		std::shared_ptr<const detail::CholeskyFactors<detail::FactorType<T>>> choleskyFactors() const {
+			if (dimx_ != dimy_)
+				throw std::invalid_argument("Matrix is not n by n");
+			return cache_.cholesky(dimx_, inner_.data());
+		}
+
+		/// <summary>
+		/// Forgets the cached factorisations, determinant, trace and norms
+		/// </summary>
+		/// <remarks>
+		/// Everything that changes the matrix calls this itself. It's only needed after writing to inner_
+		/// directly, through a view taken before the last query, or to borrowed memory behind the matrix's back
+		/// </remarks>
+		void invalidate() noexcept {
+			cache_.clear();
 		}
 
 		/// <summary>
@@ -80,32 +305,86 @@ namespace matrices {
 		/// </summary>
 		/// <param name="col">The column where the element is</param>
 		/// <param name="row">The row where the element is</param>
-		/// <returns></returns>
-		double getCofactorOf(int col, int row) {
-			return getCofactor(row, col, *this);
+		/// <returns>The signed minor of the element</returns>
+		/// <remarks>
+		/// For a non singular matrix this is det(A) * inverse(A)[col][row], which only needs one O(n^2) solve
+		/// against the cached LU factors. A singular matrix falls back to factorising the minor itself
+		/// </remarks>
+		double getCofactorOf(int col, int row) const {
+			if (dimx_ != dimy_)
+				throw std::invalid_argument("Matrix is not n by n");
+			if (col < 0 || row < 0 || col >= dimx_ || row >= dimy_)
+				throw std::out_of_range("Index out of range");
+			detail::OperationScope scope(Operation::Cofactor, 2.0 * dimx_ * dimx_ * dimx_ / 3);
+			int n = dimx_;
+			if (n == 1)
+				return 1.0;
+
+			auto factors = luFactors();
+			if (factors->info == 0) {
+				factor_storage x(n);
+				x[row] = factor_type(1);
+				detail::luSolveVector(n, factors->lu.data(), n, factors->pivots.data(), x.data());
+				return factors->determinant * static_cast<double>(x[col]);
+			}
+
+			std::vector<int> pivots(n);
+			factor_storage minor;
+			minor.reserve(static_cast<size_t>(n - 1) * (n - 1));
+			for (int i = 0; i < n; i++)
+				for (int j = 0; j < n; j++)
+					if (i != row && j != col)
+						minor.push_back(static_cast<factor_type>(inner_[i * dimx_ + j]));
+			detail::luFactor(n - 1, minor.data(), n - 1, pivots.data());
+			double det = detail::luDeterminant(n - 1, minor.data(), n - 1, pivots.data());
+			return (row + col) % 2 == 0 ? det : -det;
 		}
 
 		/// <summary>
-		/// Transposes this matrix
+		/// Transposes this matrix in place, the number of rows and columns swap
 		/// </summary>
+		/// <remarks>
+		/// Square matrices swap mirrored tiles. Other shapes go through a per thread scratch buffer up to
+		/// TransposeScratchLimit elements, above that they follow the cycles of the permutation so a huge
+		/// matrix never needs a second copy of itself
+		/// </remarks>
 		void transpose() {
-			Matrix<T> temp = *this;
-			for (int i = 0; i < dimy_ * dimx_; i++)
-				inner_[i] = temp.getAt(i / dimy_, i % dimx_);
+			detail::OperationScope scope(Operation::Transpose, 0);
+			invalidate();
+			if (dimx_ == dimy_) {
+				detail::transposeSquare(dimx_, inner_.data(), dimx_);
+			}
+			else if (inner_.size() <= TransposeScratchLimit) {
+				detail::ScratchBuffer<T, Matrix> temp(inner_.size());
+				detail::transposeInto(dimy_, dimx_, inner_.data(), dimx_, temp.data(), dimy_);
+				std::copy(temp.data(), temp.data() + inner_.size(), inner_.begin());
+			}
+			else {
+				detail::transposeCycles(dimy_, dimx_, inner_.data());
+			}
+			std::swap(dimx_, dimy_);
+		}
+
+		/// <summary>
+		/// Returns the transpose as a new matrix, this one is left alone
+		/// </summary>
+		Matrix transposed() const {
+			detail::OperationScope scope(Operation::Transpose, 0);
+			Matrix result(dimy_, dimx_, inner_.get_allocator());
+			detail::transposeInto(dimy_, dimx_, inner_.data(), dimx_, result.inner_.data(), result.dimx_);
+			return result;
 		}
 
 		/// <summary>
 		/// Normalises the matrix
 		/// </summary>
 		void normalise() {
-			double sum = 0.0;
-			for (int i = 0; i < vecSize(); i++)
-				sum += pow(inner_[i], 2);
-			if (sum == 1)
+			detail::OperationScope scope(Operation::Normalise, 3.0 * inner_.size());
+			invalidate();
+			double sum = detail::simd::sumSquares(inner_.data(), inner_.size());
+			if (sum == 1 || sum == 0)
 				return;
-			for (int i = 0; i < vecSize(); i++)
-				inner_[i] /= sqrt(sum);
-			std::cout << sum << std::endl;
+			scalarMultiply(1 / sqrt(sum));
 		}
 
 		// operators
@@ -115,15 +394,11 @@ namespace matrices {
 		/// </summary>
 		/// <param name="arg">The matrix to compare against</param>
 		/// <returns>Whether the two are the same or not as a bool</returns>
-		bool operator==(Matrix<T> arg) {
-			//if (isOutOfRange(arg))
-				//throw std::invalid_argument("Matrix is out of range");
+		bool operator==(const Matrix& arg) const {
 			if (inner_.size() == 0) return false;
 			if (arg.size() == 0) return false;
-			for (int i = 0; i < inner_.size(); i++)
-				if (inner_[i] != arg.inner_[i])
-					return false;
-			return true;
+			if (dimx_ != arg.dimx_ || dimy_ != arg.dimy_) return false;
+			return std::equal(inner_.begin(), inner_.end(), arg.inner_.begin());
 		}
 
 		/// <summary>
@@ -131,7 +406,7 @@ namespace matrices {
 		/// </summary>
 		/// <param name="arg">The matrix to compare</param>
 		/// <returns>Bool</returns>
-		bool operator!=(Matrix<T> arg) {
+		bool operator!=(const Matrix& arg) const {
 			return !(*this == arg);
 		}
 
@@ -146,108 +421,192 @@ namespace matrices {
 		//}
 
 		/// <summary>
-		/// Simple matrix addition
+		/// Matrix multiplication
 		/// </summary>
-		/// <param name="arg"></param>
-		/// <returns></returns>
-		/// TODO : Need to fix this function as it will change this object
-		/// rather than just return a new one with the two matrices added together
-		Matrix<T> operator+(Matrix<T> arg) {
-			if (isOutOfRange(arg))
-				throw std::invalid_argument("Matrix is out of range");
-			Matrix<T> temp(*this);
-			for (int i = 0; i < temp.inner_.size(); i++)
-				temp.inner_[i] = this->getAt(i % dimx_, i / dimy_) + arg.getAt(i % dimx_, i / dimy_);
+		/// <param name="arg">The right hand matrix, it needs as many rows as this matrix has columns</param>
+		/// <returns>A new matrix with the rows of this matrix and the columns of arg</returns>
+		template<class B>
+		Matrix operator*(const Matrix<T, B>& arg) const {
+			if (dimx_ != arg.dimy_)
+				throw std::invalid_argument("Matrix dimensions do not match");
+			detail::OperationScope scope(Operation::Multiply, 2.0 * dimy_ * arg.dimx_ * dimx_);
+			Matrix temp(arg.dimx_, dimy_, inner_.get_allocator());
+			multiply(*this, arg, temp);
 			return temp;
 		}
 
 		/// <summary>
-		/// Matrix subtraction
+		/// Matrix division, the X that solves this * X = arg
 		/// </summary>
-		/// <param name="arg"></param>
-		/// <returns></returns>
-		Matrix<T> operator-(Matrix<T> arg) {
-			if (isOutOfRange(arg))
-				throw std::invalid_argument("Matrix is out of range");
-			Matrix<T> temp(*this);
-			for (int i = 0; i < temp.inner_.size(); i++)
-				temp.inner_[i] = this->getAt(i % dimx_, i / dimy_) - arg.getAt(i % dimx_, i / dimy_);
-			return temp;
+		/// <param name="arg">The right hand side, it needs as many rows as this matrix</param>
+		/// <returns>X from an LU factorisation of a copy, or the least squares X when this matrix has more rows than columns</returns>
+		/// <remarks>No inverse is formed, see solve for the other methods and solveInPlace to skip the copy</remarks>
+		Matrix operator/(const Matrix& arg) const {
+			return solve(*this, arg);
 		}
 
 		/// <summary>
-		/// Matrix multiplication
+		/// Adds a matrix or an expression to this matrix in place
 		/// </summary>
-		/// <param name="arg"></param>
-		/// <returns></returns>
-		/// TODO : make this more efficient
-		Matrix<T> operator*(Matrix<T> arg) {
-			if (isOutOfRange(arg))
-				throw std::out_of_range("Matrix out of range");
-			Matrix<T> temp(dimx_, dimy_);
-			multiply(*this, arg, temp);
-			return temp;
+		/// <param name="arg">Has to be the same shape as this matrix</param>
+		/// <returns>This matrix</returns>
+		template<class E>
+		Matrix& operator+=(const MatrixExpression<E>& arg) {
+			assign(*this + arg.self());
+			return *this;
 		}
 
 		/// <summary>
-		/// Matrix division
+		/// Subtracts a matrix or an expression from this matrix in place
 		/// </summary>
-		/// <param name="arg"></param>
-		/// <returns></returns>
-		Matrix<T> operator/(Matrix<T> arg) {
-			Matrix<T> returnMatrix(dimy_, dimx_);
-			Matrix<T> temp(dimy_, dimx_);
-			temp = (*this);
-			invert();
-			multiply(*this, temp, returnMatrix);
-			return returnMatrix;
+		/// <param name="arg">Has to be the same shape as this matrix</param>
+		/// <returns>This matrix</returns>
+		template<class E>
+		Matrix& operator-=(const MatrixExpression<E>& arg) {
+			assign(*this - arg.self());
+			return *this;
 		}
 
 		/// <summary>
-		/// Overrides the += operator
+		/// Multiplies this matrix by arg and keeps the product
 		/// </summary>
-		/// <param name="arg"></param>
-		/// <returns></returns>
-		Matrix<T>& operator+=(Matrix<T> arg) {
-			return *this + arg;
+		/// <param name="arg">Needs as many rows as this matrix has columns</param>
+		/// <returns>This matrix</returns>
+		/// <remarks>
+		/// Products up to ProductScratchLimit elements are built in a per thread scratch buffer and copied
+		/// back, so when the shape doesn't change nothing is allocated after the first call. Bigger ones
+		/// go through a temporary that is freed again, so no thread holds on to a copy of a huge result
+		/// </remarks>
+		Matrix& operator*=(const Matrix& arg) {
+			if (dimx_ != arg.dimy_)
+				throw std::invalid_argument("Matrix dimensions do not match");
+			detail::OperationScope scope(Operation::Multiply, 2.0 * dimy_ * arg.dimx_ * dimx_);
+			int columns = arg.dimx_;
+			size_t count = static_cast<size_t>(columns) * dimy_;
+			invalidate();
+			if (count <= ProductScratchLimit) {
+				detail::ScratchBuffer<T, Matrix> product(count);
+				detail::product<T>(dimy_, columns, dimx_, inner_.data(), dimx_, arg.inner_.data(), arg.dimx_, product.data(), columns);
+				inner_.resize(count);
+				std::copy(product.data(), product.data() + count, inner_.begin());
+			}
+			else {
+				std::vector<T, AlignedAllocator<T>> product(count);
+				detail::recordAllocation(count * sizeof(T));
+				detail::product<T>(dimy_, columns, dimx_, inner_.data(), dimx_, arg.inner_.data(), arg.dimx_, product.data(), columns);
+				inner_.resize(count);
+				std::copy(product.begin(), product.end(), inner_.begin());
+			}
+			dimx_ = columns;
+			return *this;
 		}
 
 		/// <summary>
-		/// Overrides the -= operator
+		/// Multiplies every element by a scalar in place
 		/// </summary>
-		/// <param name="arg"></param>
-		/// <returns></returns>
-		Matrix<T>& operator-=(Matrix<T> arg) {
-			return *this - arg;
+		/// <returns>This matrix</returns>
+		template<class S, typename std::enable_if<std::is_arithmetic<S>::value, int>::type = 0>
+		Matrix& operator*=(S arg) {
+			assign(*this * arg);
+			return *this;
 		}
 
 		/// <summary>
-		/// Overrides the *= operator
+		/// Divides every element by a scalar in place
 		/// </summary>
-		/// <param name="arg"></param>
-		/// <returns></returns>
-		Matrix<T>& operator*=(Matrix<T> arg) {
-			return *this * arg;
+		/// <returns>This matrix</returns>
+		Matrix& operator/=(T arg) {
+			detail::OperationScope scope(Operation::Arithmetic, static_cast<double>(inner_.size()));
+			invalidate();
+			if constexpr (std::is_floating_point<T>::value) {
+				detail::simd::scale(inner_.data(), T(1) / arg, inner_.data(), inner_.size());
+			}
+			else {
+				for (auto& element : inner_)
+					element /= arg;
+			}
+			return *this;
 		}
 
 		/// <summary>
-		/// overrides the /= operator
+		/// Allows users to do Matrix[col][row]
 		/// </summary>
-		/// <param name="arg"></param>
-		/// <returns></returns>
-		Matrix<T>& operator/=(T arg) {
-			return *this / arg;
+		/// <param name="index">The column</param>
+		/// <returns>A view of the column, indexing it gives the row</returns>
+		MatrixView<T> operator[](int index) {
+			return column(index);
 		}
 
 		/// <summary>
 		/// Allows users to do Matrix[col][row]
 		/// </summary>
-		/// <param name="index"></param>
-		/// <returns></returns>
-		/// This is pretty inefficient but it does allow users to use the [col][row] as if
-		/// they are using a 2D array, perhaps find a better way to implement this
-		std::vector<T> operator[](int index) {
-			return getColumn(index);
+		/// <param name="index">The column</param>
+		/// <returns>A read only view of the column, indexing it gives the row</returns>
+		ConstMatrixView<T> operator[](int index) const {
+			return column(index);
+		}
+
+		/// <summary>
+		/// View of the whole matrix
+		/// </summary>
+		/// <remarks>
+		/// Taking a writable view, or any of the ones below, forgets the cached factorisations. Writing
+		/// through a view kept from before the last getDeterminant, solve etc. needs invalidate()
+		/// </remarks>
+		MatrixView<T> view() {
+			invalidate();
+			return MatrixView<T>(inner_.data(), dimx_, dimy_, dimx_, 1);
+		}
+
+		/// <summary>
+		/// Read only view of the whole matrix
+		/// </summary>
+		ConstMatrixView<T> view() const {
+			return ConstMatrixView<T>(inner_.data(), dimx_, dimy_, dimx_, 1);
+		}
+
+		/// <summary>
+		/// View of a row, writing to it writes to this matrix
+		/// </summary>
+		MatrixView<T> row(int row) {
+			return view().row(row);
+		}
+
+		ConstMatrixView<T> row(int row) const {
+			return view().row(row);
+		}
+
+		/// <summary>
+		/// View of a column, writing to it writes to this matrix
+		/// </summary>
+		MatrixView<T> column(int column) {
+			return view().column(column);
+		}
+
+		ConstMatrixView<T> column(int column) const {
+			return view().column(column);
+		}
+
+		/// <summary>
+		/// View of columns x rows elements starting at col, row, writing to it writes to this matrix
+		/// </summary>
+		MatrixView<T> block(int col, int row, int columns, int rows) {
+			return view().block(col, row, columns, rows);
+		}
+
+		ConstMatrixView<T> block(int col, int row, int columns, int rows) const {
+			return view().block(col, row, columns, rows);
+		}
+
+		/// <summary>
+		/// View of the main diagonal as a single column, writing to it writes to this matrix
+		/// </summary>
+		MatrixView<T> diagonal() {
+			return view().diagonal();
+		}
+
+		ConstMatrixView<T> diagonal() const {
+			return view().diagonal();
 		}
 
 		/// <summary>
@@ -255,7 +614,7 @@ namespace matrices {
 		/// </summary>
 		/// <param name="key">The value to get</param>
 		/// <returns>A const iterator of where the element is </returns>
-		typename std::vector<T>::iterator find(const T& key) const {
+		typename storage_type::const_iterator find(const T& key) const {
 			return std::find(inner_.begin(), inner_.end(), key);
 		}
 
@@ -264,7 +623,7 @@ namespace matrices {
 		/// </summary>
 		/// <returns>Only returns the amount of columns</returns>
 		size_t size() const {
-			return dimx_ * dimy_;
+			return static_cast<size_t>(dimx_) * dimy_;
 		}
 
 		/// <summary>
@@ -272,7 +631,7 @@ namespace matrices {
 		/// </summary>
 		/// <returns>The size of the vector</returns>
 		size_t max_size() const {
-			return std::vector.max_size();
+			return inner_.max_size();
 		}
 
 		/// <summary>
@@ -281,7 +640,7 @@ namespace matrices {
 		/// <param name="col">The column</param>
 		/// <param name="row">The row</param>
 		/// <returns>The element at col,row</returns>
-		T& at(int col, int row) const {
+		const T& at(int col, int row) const {
 			return getAt(col, row);
 		}
 
@@ -290,7 +649,8 @@ namespace matrices {
 		/// </summary>
 		/// <param name="key">The value requred</param>
 		/// <returns>The iterator within the vector where the element is</returns>
-		typename std::vector<T>::iterator find(const T& key) {
+		typename storage_type::iterator find(const T& key) {
+			invalidate();
 			return std::find(inner_.begin(), inner_.end(), key);
 		}
 
@@ -298,7 +658,7 @@ namespace matrices {
 		/// Gets the size of inner_
 		/// </summary>
 		/// <returns></returns>
-		size_t vecSize() {
+		size_t vecSize() const {
 			return inner_.size();
 		}
 
@@ -306,18 +666,16 @@ namespace matrices {
 		/// Deletes all the elements of the matrix
 		/// </summary>
 		void erase() {
-			delete inner_;
-			inner_ = std::vector<T>;
-			inner_.resize(dimx_ * dimy_);
+			invalidate();
+			inner_.assign(inner_.size(), T());
 		}
 
 		/// <summary>
 		/// Clears the vector
 		/// </summary>
 		void clear() {
-			delete inner_;
-			inner_ = std::vector<T>;
-			inner_.resize(dimx_ * dimy_);
+			invalidate();
+			inner_.assign(inner_.size(), T());
 		}
 
 		/// <summary>
@@ -326,38 +684,52 @@ namespace matrices {
 		/// </summary>
 		/// <param name="objToFill"></param>
 		void fill(T objToFill) {
-			for (int i = 0; i < inner_.size(); i++)
-				inner_[i] = objToFill;
+			invalidate();
+			detail::simd::fill(inner_.data(), objToFill, inner_.size());
 		}
 
 		/// <summary>
-		/// 
+		/// Writes the matrix into a string, by default in the same format as operator<<
 		/// </summary>
-		/// <returns></returns>
-		std::string toString() {
-			std::string builder = "";
-			for (int loop = 0; loop < vecSize(); loop++) {
-				if (loop % dimx_ == 0 && loop != 0) {
-					builder += "\n";
-				}
-				builder += "(" + std::to_string(getAt(loop % dimx_, loop / dimy_)) + ") ";
-			}
-			return builder;
+		/// <param name="format">Brackets, delimiters and precision, e.g. TextFormat::csv()</param>
+		std::string toString(const TextFormat& format = TextFormat()) const {
+			return detail::toText(inner_.data(), dimx_, dimy_, dimx_, 1, format);
 		}
 
-#ifdef ROOT_TH1
+		/// <summary>
+		/// Streams the matrix straight to os without building a string first
+		/// </summary>
+		/// <param name="format">Brackets, delimiters and precision, e.g. TextFormat::csv()</param>
+		void print(std::ostream& os, const TextFormat& format = TextFormat()) const {
+			detail::writeText(os, inner_.data(), dimx_, dimy_, dimx_, 1, format);
+		}
 
 		/// <summary>
-		/// Fills a histogram with each row of the matrix
+		/// Fills a histogram with the row of every positive element
 		/// </summary>
-		/// <returns></returns>
+		/// <remarks>
+		/// HistT is anything with a Fill member behind a pointer, so ROOT isn't needed to use it. The rows are
+		/// gathered across the thread pool and handed over with FillN when HistT has it, like TH1
+		/// </remarks>
 		template<typename HistT>
 		void fillHistogram(HistT hist, int weight) {
-			for (int i = 0; i < inner_.size(); i++)
-				if (inner_[i] > 0)
-					hist->Fill(i / dimx_, weight);
+			detail::fillHistogram<false>(hist, inner_.data(), dimx_, dimy_, weight);
 		}
 
+		/// <summary>
+		/// Fills a 2D histogram with the row and column of every positive element
+		/// </summary>
+		/// <remarks>
+		/// HistT is anything with a Fill member behind a pointer, so ROOT isn't needed to use it. The positions
+		/// are gathered across the thread pool and handed over with FillN when HistT has it, like TH2
+		/// </remarks>
+		template<typename HistT>
+		void fill2DHistogram(HistT hist, int weight) {
+			detail::fillHistogram<true>(hist, inner_.data(), dimx_, dimy_, weight);
+		}
+
+#ifdef ROOT_TH1
+
 		/// <summary>
 		/// Converts a matrix to a TH1, it uses each row to fill the bin in the histogram
 		/// </summary>
@@ -448,17 +820,6 @@ namespace matrices {
 
 #ifdef ROOT_TH2
 
-		/// <summary>
-		/// Fills a histogram with each row of the matrix
-		/// </summary>
-		/// <returns></returns>
-		template<typename HistT>
-		void fill2DHistogram(HistT hist, int weight) {
-			for (int i = 0; i < inner_.size(); i++)
-				if (inner_[i] > 0)
-					hist->Fill(i / dimx_, i % dimy_, weight);
-		}
-
 		/// <summary>
 		/// Convets the matrix to a TH2, uses each element and fills the each bin with a weight that is equal to the element
 		/// </summary>
@@ -549,130 +910,150 @@ namespace matrices {
 
 #ifdef ROOT_TMatrixT
 
-#ifdef ROOT_TMatrix
+		/// <summary>
+		/// Copies a TMatrixT, it's row major as well so this is one straight copy
+		/// </summary>
+		/// <remarks>borrowMatrix(tMatrix) gives a matrix over the same elements without copying</remarks>
+		Matrix(const TMatrixT<T>& tMatrix)
+			: dimx_(tMatrix.GetNcols()), dimy_(tMatrix.GetNrows()) {
+			inner_.assign(tMatrix.GetMatrixArray(), tMatrix.GetMatrixArray() + tMatrix.GetNoElements());
+		}
 
 		/// <summary>
-		/// New copy constructor for copying the TMatrix class
+		/// Copies this matrix into a new TMatrixT
 		/// </summary>
-		/// <returns></returns>
-		Matrix(TMatrix tMatrix)
-			: dimx_(tMatrix.GetNrows()), dimy_(tMatrix.GetNcols()) {
-			if (!typeid(T).name() == "Float_T")
-				throw std::invalid_argument("Matrix is of wrong type");
-			inner_.resize(dimx_ * dimy_);
-			inner_ = tMatrix.GetMatrixArray();
+		TMatrixT<T> toTMatrixT() const {
+			return TMatrixT<T>(dimy_, dimx_, inner_.data());
 		}
 
 		/// <summary>
-		/// Overrides a cast to TMatrix
+		/// Points tMatrix at the elements of this matrix without copying them, see TMatrixT::Use
 		/// </summary>
-		/// <returns></returns>
-		operator TMatrix() const {
-			TMatrix temp(dimx_, dimy_);
-			for (int i = 0; i < inner_.size(); i++)
-				temp[i % dimx_][i / dimy_] = inner_[i];
-			return temp;
+		/// <remarks>tMatrix must not be used after this matrix is resized or destroyed</remarks>
+		void shareWith(TMatrixT<T>& tMatrix) {
+			invalidate();
+			tMatrix.Use(dimy_, dimx_, inner_.data());
 		}
 
 		/// <summary>
-		/// Overrides the = operator for making the Matrix<T> = root::TMatrix
+		/// Overrides a cast to TMatrixT
 		/// </summary>
-		/// <returns></returns>
-		Matrix<T>& operator=(TMatrix arg) {
-			return Matrix(arg);
+		operator TMatrixT<T>() const {
+			return toTMatrixT();
 		}
 
 		/// <summary>
-		/// Checks if the matrix is a char matrix then converts it to a TH2C
+		/// Overrides the = operator for making the Matrix<T> = TMatrixT<T>
 		/// </summary>
-		/// <returns></returns>
-		TMatrix toTMatrix() {
-			return static_cast<TMatrix>(*this);
+		Matrix& operator=(const TMatrixT<T>& arg) {
+			return *this = Matrix(arg);
 		}
 
 #endif
 
+#ifdef EIGEN_MATRIX_H
+
+		using EigenMap = Eigen::Map<Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>;
+		using ConstEigenMap = Eigen::Map<const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>;
+
 		/// <summary>
-		/// New copy constructor for copying the TMatrixT<T> class
+		/// Copies any Eigen matrix or expression, Eigen takes care of the layout
 		/// </summary>
-		/// <returns></returns>
-		Matrix(TMatrixT<T> tMatrix)
-			: dimx_(tMatrix.GetNrows()), dimy_(tMatrix.GetNcols()) {
-			inner_.resize(dimx_ * dimy_);
-			inner_ = tMatrix.GetMatrixArray();
+		/// <remarks>borrowMatrix or borrowView give a matrix over the same elements without copying</remarks>
+		template<class Derived>
+		Matrix(const Eigen::MatrixBase<Derived>& eigenMatrix)
+			: dimx_(static_cast<int>(eigenMatrix.cols())), dimy_(static_cast<int>(eigenMatrix.rows())) {
+			inner_.resize(static_cast<size_t>(dimx_) * dimy_);
+			eigenMap() = eigenMatrix.template cast<T>();
 		}
 
 		/// <summary>
-		/// Adds a new function to convert this Matrix<T> to a TMatrixT<T>
+		/// The elements of this matrix as an Eigen matrix, nothing is copied
 		/// </summary>
-		/// <returns></returns>
-		TMatrixT<T> toTMatrixT() {
-			TMatrixT<T> temp((Int_t)dimx_, (Int_t)dimy_);
-			for (int i = 0; i < inner_.size(); i++)
-				temp[i % dimx_][i / dimy_] = inner_[i];
-			return temp;
+		EigenMap eigenMap() {
+			invalidate();
+			return EigenMap(inner_.data(), dimy_, dimx_);
 		}
 
-		/// <summary>
-		/// Overrides a cast to TMatrixT
-		/// </summary>
-		/// <returns></returns>
-		operator TMatrixT<T>() const {
-			return this->toTMatrixT();
+		ConstEigenMap eigenMap() const {
+			return ConstEigenMap(inner_.data(), dimy_, dimx_);
 		}
 
 		/// <summary>
-		/// Overrides a cast to TMatrixT<T>
+		/// Copies this matrix into a new (column major) Eigen matrix
 		/// </summary>
-		/// <returns></returns>
-		Matrix<T>& operator=(TMatrixT<T> arg) {
-			return Matrix<T>(arg);
+		Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> toEigenMatrix() const {
+			return eigenMap();
 		}
 
-#endif
-
-#ifdef EIGEN_MATRIX_H 
-
 		/// <summary>
-		/// A new copy constructor for the 
+		/// Overrides a cast to the Eigen::Matrix class
 		/// </summary>
-		/// <returns></returns>
-		Matrix(Eigen::Matrix<T, int, int> eigenMatrix) {
-			// must already be the same size as this matrix
-			inner_.resize(eigenMatrix.rows() * eigenMatrix.cols());
-			for (int i = 0; i < inner_.size(); i++)
-				*this->add(temp[i % dimx_][i / dimy_], i % dimx_, i / dimy_);
+		operator Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>() const {
+			return toEigenMatrix();
 		}
 
 		/// <summary>
-		/// 
+		/// Overrides the = operator for making the Matrix<T> = any Eigen matrix
 		/// </summary>
-		/// <returns></returns>
-		Eigen::Matrix<T, dimy_, dimx_> toEigenMatrix() {
-			Eigen::Matrix<T, dimy_, dimx_> temp;
-			for (int i = 0; i < inner_.size(); i++)
-				temp[i % dimx_][i / dimy_] = inner_[i];
-			return temp;
+		template<class Derived>
+		Matrix& operator=(const Eigen::MatrixBase<Derived>& arg) {
+			return *this = Matrix(arg);
 		}
+#endif
 
+	private:
 		/// <summary>
-		/// Overrides a cast to the Eigen::Matrix class
+		/// The type LU factorisations are done in, floating point matrices use their own type and everything else double
 		/// </summary>
-		/// <returns></returns>
-		operator Eigen::Matrix<T, dimy_, dimx_>() const {
-			return *this->toEigenMatrix();
+		using factor_type = detail::FactorType<T>;
+		using factor_storage = std::vector<factor_type, AlignedAllocator<factor_type>>;
+
+		mutable detail::FactorCache<factor_type> cache_;
+
+		std::shared_ptr<const detail::MatrixSummary> summary() const {
+			return cache_.summary(dimx_, dimy_, inner_.data());
 		}
 
 		/// <summary>
-		/// Overrides a cast to TMatrixT<T>
+		/// Writes every element of an expression of the same shape into this matrix
 		/// </summary>
-		/// <returns></returns>
-		Matrix<T>& operator=(Eigen::Matrix<T, dimy_, dimx_> arg) {
-			return Matrix<T>(arg);
+		/// <param name="e">The expression, it may read from this matrix</param>
+		/// <remarks>
+		/// A plain sum or difference of two matrices goes to the vector kernels, anything else is one fused
+		/// loop. An expression that reads this matrix through a view at other positions, e.g. its transpose,
+		/// is evaluated into a temporary first so nothing is read after it has been overwritten
+		/// </remarks>
+		template<class E>
+		void assign(const E& e) {
+			if (detail::readsElsewhere(e, inner_.data(), dimx_, inner_.size())) {
+				Matrix temp(e, std::allocator_traits<alloc>::select_on_container_copy_construction(inner_.get_allocator()));
+				invalidate();
+				std::copy(temp.inner_.begin(), temp.inner_.end(), inner_.begin());
+				return;
+			}
+			detail::OperationScope scope(Operation::Arithmetic, static_cast<double>(inner_.size()));
+			invalidate();
+			if constexpr (detail::IsBinaryOfLeaves<E, Matrix, detail::AddOp>::value) {
+				detail::simd::add(e.left().inner_.data(), e.right().inner_.data(), inner_.data(), inner_.size());
+			}
+			else if constexpr (detail::IsBinaryOfLeaves<E, Matrix, detail::SubOp>::value) {
+				detail::simd::sub(e.left().inner_.data(), e.right().inner_.data(), inner_.data(), inner_.size());
+			}
+			else {
+				T* out = inner_.data();
+				int columns = dimx_;
+				std::ptrdiff_t grain = std::max<std::ptrdiff_t>(1, detail::simd::ParallelChunk / std::max(columns, 1));
+				detail::parallelFor(0, dimy_, grain, inner_.size(), [&](std::ptrdiff_t first, std::ptrdiff_t last) {
+					for (std::ptrdiff_t row = first; row < last; row++) {
+						T* dst = out + row * columns;
+						for (int col = 0; col < columns; col++)
+							dst[col] = static_cast<T>(e.elementAt(col, static_cast<int>(row)));
+					}
+				});
+			}
 		}
-#endif
 
-	private:
 		/// <summary>
 		/// Checks if the type of the matrix is an int32
 		/// </summary>
@@ -718,7 +1099,7 @@ namespace matrices {
 		/// </summary>
 		/// <param name="arg"></param>
 		/// <returns></returns>
-		bool isOutOfRange(Matrix<T> arg) {
+		bool isOutOfRange(const Matrix& arg) const {
 			return arg.dimx_ > dimx_ || arg.dimy_ > dimy_; // assumes the vector cannot have - indexs
 		}
 
@@ -728,125 +1109,658 @@ namespace matrices {
 		/// <param name="col">Columns to check</param>
 		/// <param name="row">Rows to check</param>
 		/// <returns></returns>
-		bool isOutOfRange(int col, int row) {
-			return col > dimx_ || row > dimy_ || col < 0 || row < 0;
-		}
-
-		/// <summary>
-		/// Gets a row at the specified index
-		/// </summary>
-		/// <param name="row"></param>
-		/// <returns></returns>
-		/// <remarks>returns a reference to a temp variable</remarks>
-		std::vector<T> getRow(int row) {
-			if (row > dimy_)
-				throw std::out_of_range("Index out of range");
-			std::vector<T> temp;
-			for (int i = 0; i < dimx_; i++)
-				temp.push_back(inner_[i * dimy_]);
-			return temp;
+		bool isOutOfRange(int col, int row) const {
+			return col >= dimx_ || row >= dimy_ || col < 0 || row < 0;
 		}
 
 		/// <summary>
-		/// Gets a whole column at the specified index
+		/// Multiplies two matricies and writes the product into out
 		/// </summary>
-		/// <param name="row"></param>
-		/// <returns></returns>
-		std::vector<T> getColumn(int column) {
-			if (column > dimx_)
-				throw std::out_of_range("Index out of range");
-			std::vector<T> temp;
-			for (int i = 0; i < dimx_; i++)
-				temp.push_back(inner_[i] + dimx_ * i);
-			return temp;
-		}
-
-		/// <summary>
-		/// Multiplies two matricies and sends creates a new on called out
-		/// </summary>
-		/// <param name="matrixOne"></param>
-		/// <param name="matrixTwo"></param>
-		/// <param name="out"></param>
-		/// TODO : Does not work, need to refactor
-		void multiply(Matrix<T> matrixOne, Matrix<T> matrixTwo, Matrix<T>& out) {
-			for (int x = 0; x < matrixOne.dimx_; x++) {
-				for (int y = 0; y < matrixTwo.dimx_; y++) {
-					int dotProduct = 0;
-					for (int i = 0; i < matrixOne.dimx_; i++) {
-						int matrixRow = matrixOne.getRow(x)[i];
-						dotProduct += matrixOne.getRow(x)[i] * matrixTwo.getRow(y)[i];
-					}
-					out.add(dotProduct, x, y);
-				}
-			}
+		/// <param name="matrixOne">Left hand matrix</param>
+		/// <param name="matrixTwo">Right hand matrix</param>
+		/// <param name="out">Has to be matrixTwo.dimx_ columns by matrixOne.dimy_ rows and must not be either operand</param>
+		/// <remarks>
+		/// Uses the packed, cache blocked kernel from Gemm.hpp and accumulates in T, or float and int32 for the 16 bit
+		/// floats and small integers. Floating point products past the Strassen threshold are split with Strassen-Winograd first
+		/// </remarks>
+		template<class B>
+		static void multiply(const Matrix& matrixOne, const Matrix<T, B>& matrixTwo, Matrix& out) {
+			detail::product<T>(matrixOne.dimy_, matrixTwo.dimx_, matrixOne.dimx_,
+				matrixOne.inner_.data(), matrixOne.dimx_,
+				matrixTwo.inner_.data(), matrixTwo.dimx_,
+				out.inner_.data(), out.dimx_);
+			out.invalidate();
 		}
 
 		/// <summary>
 		/// Multiplies the whole matrix by a single double
 		/// </summary>
 		/// <param name="product">The value to multiply with</param>
+		/// <remarks>Floating point matrices are scaled in T by the vector kernels, anything else keeps the double multiply</remarks>
 		void scalarMultiply(double product) {
-			for (int i = 0; i < inner_.size(); i++)
-				inner_[i] *= product;
+			if constexpr (std::is_floating_point<T>::value) {
+				detail::simd::scale(inner_.data(), static_cast<T>(product), inner_.data(), inner_.size());
+			}
+			else {
+				for (size_t i = 0; i < inner_.size(); i++)
+					inner_[i] *= product;
+			}
 		}
 
-		/// <summary>
-		/// Gets the determinant of the matrix
-		/// </summary>
-		/// <param name="matrix">The matrix to inverse</param>
-		/// <param name="matrixHeight">The height of the matrix, aka how many elements in the column</param>
-		/// <returns></returns>
-		double determinant(Matrix<T> matrix) {
-			if (matrix.dimx_ != matrix.dimy_)
-				throw std::out_of_range("Bro wot doing??");
-			double det = 0.0;
-			if (matrix.dimy_ == 2)
-				return (matrix.getAt(0, 0) * matrix.getAt(1, 1)) - (matrix.getAt(1, 0) * matrix.getAt(0, 1));
-			for (int rowElem = 0; rowElem < matrix.dimx_; rowElem++)
-				det += getCofactor(0, rowElem, matrix) * matrix.getAt(rowElem, 0);
-			return det;
+		// outputs the matrix in text format
+		friend std::ostream& operator<<(std::ostream& os, const Matrix& matrix) {
+			matrix.print(os);
+			return os;
 		}
+	};
 
-		/// <summary>
-		/// Gets the cofactor of the matrix
-		/// </summary>
-		/// <param name="elimCol">The column to eliminate when the submatrix is made</param>
-		/// <param name="elimRow">The row to eliminate when the submatrix is made</param>
-		double getCofactor(int elimRow, int elimCol, Matrix<T> matrix) {
-			if (dimx_ == 1 || dimy_ == 1)
-				throw std::out_of_range("Bro wot doing??");
-			return (determinant(createSubMatrix(matrix, elimRow, elimCol)) * pow(-1, elimCol + elimRow));
-		}
+	/// <summary>
+	/// A matrix whose elements live in memory it doesn't own, e.g. a mapped file or the array of a TMatrixT
+	/// </summary>
+	/// <remarks>
+	/// Everything Matrix does works on it in place. Copies are ordinary matrices on the heap, and moving
+	/// a whole matrix into it, e.g. m = a * b, replaces the borrowed memory with the other matrix's. To
+	/// write results into the memory assign an expression of the same shape, use multiply() or view()
+	/// </remarks>
+	template<class T>
+	using ExternalMatrix = Matrix<T, ExternalAllocator<T>>;
+
+	/// <summary>
+	/// Wraps columns x rows row major elements owned by someone else in a matrix, nothing is copied
+	/// </summary>
+	/// <param name="owner">Kept alive while the matrix uses the memory, can be empty when the caller keeps data alive</param>
+	template<class T>
+	ExternalMatrix<T> borrowMatrix(T* data, int columns, int rows, std::shared_ptr<void> owner = nullptr) {
+		size_t count = static_cast<size_t>(columns) * rows;
+		return ExternalMatrix<T>(columns, rows, ExternalAllocator<T>(data, count, std::move(owner)));
+	}
+
+	/// <summary>
+	/// Order of the elements in memory that belongs to someone else
+	/// </summary>
+	enum class Layout {
+		RowMajor,     // like Matrix, TMatrixT and C arrays
+		ColumnMajor   // like Eigen's default and Fortran
+	};
 
-		/// <summary>
-		/// Creates a sub matrix without the specified row and column 
-		/// </summary>
-		/// <param name="matrix"></param>
-		/// <param name="row"></param>
-		/// <param name="col"></param>
-		/// <returns></returns>
-		Matrix<T> createSubMatrix(Matrix<T> matrix, int elimRow, int elimCol) {
-			Matrix<T> temp(matrix.dimx_ - 1, matrix.dimx_ - 1);
-			for (int i = 0; i < matrix.vecSize(); i++) { //Copy only those elements which are not in given row r and column c: 
-				int row = i / matrix.dimy_;
-				int col = i % matrix.dimx_;
-				if (row != elimRow && col != elimCol) {
-					if (row > elimRow)
-						row -= 1;
-					if (col > elimCol)
-						col -= 1;
-
-					temp.add(matrix.inner_[i], col, row); //If row is filled increase r index and reset c index
-				}
+	/// <summary>
+	/// View of columns x rows elements owned by someone else in either layout, nothing is copied
+	/// </summary>
+	/// <remarks>Works with everything that takes a view, products read it in place through its strides</remarks>
+	template<class T>
+	MatrixView<T> borrowView(T* data, int columns, int rows, Layout layout = Layout::RowMajor) {
+		if (layout == Layout::RowMajor)
+			return MatrixView<T>(data, columns, rows, columns, 1);
+		return MatrixView<T>(data, columns, rows, 1, rows);
+	}
+
+#ifdef ROOT_TMatrixT
+	/// <summary>
+	/// A matrix over the elements of a TMatrixT, writes go straight into it
+	/// </summary>
+	/// <remarks>tMatrix has to outlive the matrix and must not be resized while it's borrowed</remarks>
+	template<class T>
+	ExternalMatrix<T> borrowMatrix(TMatrixT<T>& tMatrix) {
+		return borrowMatrix(tMatrix.GetMatrixArray(), tMatrix.GetNcols(), tMatrix.GetNrows());
+	}
+#endif
+
+#ifdef EIGEN_MATRIX_H
+	/// <summary>
+	/// A matrix over the elements of a row major Eigen matrix, writes go straight into it
+	/// </summary>
+	/// <remarks>Eigen matrices are column major unless asked otherwise, borrowView takes either</remarks>
+	template<class Derived>
+	ExternalMatrix<typename Derived::Scalar> borrowMatrix(Eigen::PlainObjectBase<Derived>& eigenMatrix) {
+		static_assert(Derived::IsRowMajor, "Only a row major Eigen matrix can be borrowed as a Matrix, use borrowView");
+		return borrowMatrix(eigenMatrix.data(), static_cast<int>(eigenMatrix.cols()), static_cast<int>(eigenMatrix.rows()));
+	}
+
+	/// <summary>
+	/// A view of the elements of an Eigen matrix in either layout
+	/// </summary>
+	template<class Derived>
+	MatrixView<typename Derived::Scalar> borrowView(Eigen::PlainObjectBase<Derived>& eigenMatrix) {
+		return borrowView(eigenMatrix.data(), static_cast<int>(eigenMatrix.cols()), static_cast<int>(eigenMatrix.rows()),
+			Derived::IsRowMajor ? Layout::RowMajor : Layout::ColumnMajor);
+	}
+
+	/// <summary>
+	/// A view of the elements of an Eigen::Map, Ref or block with its strides
+	/// </summary>
+	template<class Derived>
+	MatrixView<typename Derived::Scalar> borrowView(Eigen::MapBase<Derived, Eigen::WriteAccessors>& eigenMap) {
+		std::ptrdiff_t inner = eigenMap.innerStride(), outer = eigenMap.outerStride();
+		return MatrixView<typename Derived::Scalar>(eigenMap.data(), static_cast<int>(eigenMap.cols()), static_cast<int>(eigenMap.rows()),
+			Derived::IsRowMajor ? outer : inner, Derived::IsRowMajor ? inner : outer);
+	}
+#endif
+
+	namespace detail {
+
+		/// <summary>
+		/// Whether E already has its elements of type T in memory with fixed strides, so gemm can read it as it is
+		/// </summary>
+		template<class T, class E>
+		struct IsStrided : std::false_type {};
+
+		template<class T, class A>
+		struct IsStrided<T, Matrix<T, A>> : std::true_type {};
+
+		template<class T>
+		struct IsStrided<T, MatrixView<T>> : std::true_type {};
+
+		template<class T>
+		struct IsStrided<T, MatrixView<const T>> : std::true_type {};
+
+		/// <summary>
+		/// Gives back matrices and views of T as they are, anything else is evaluated into a new Matrix of T
+		/// </summary>
+		template<class T, class E>
+		decltype(auto) evaluateAs(const E& e) {
+			if constexpr (IsStrided<T, E>::value)
+				return (e);
+			else
+				return Matrix<T>(e);
+		}
+
+		template<class T, class A>
+		ConstMatrixView<T> stridedView(const Matrix<T, A>& m) {
+			return m.view();
+		}
+
+		template<class T>
+		ConstMatrixView<T> stridedView(const ConstMatrixView<T>& v) {
+			return v;
+		}
+	}
+
+	/// <summary>
+	/// Matrix multiplication where at least one side is a view or an unevaluated expression
+	/// </summary>
+	/// <returns>The product as a new matrix</returns>
+	/// <remarks>Views are read in place through their strides, other expressions are evaluated first</remarks>
+	template<class L, class R>
+	Matrix<typename std::common_type<typename L::value_type, typename R::value_type>::type>
+		operator*(const MatrixExpression<L>& l, const MatrixExpression<R>& r) {
+		using T = typename std::common_type<typename L::value_type, typename R::value_type>::type;
+		detail::OperationScope scope(Operation::Multiply, 2.0 * l.self().rows() * r.self().columns() * l.self().columns());
+		decltype(auto) left = detail::evaluateAs<T>(l.self());
+		decltype(auto) right = detail::evaluateAs<T>(r.self());
+		ConstMatrixView<T> a = detail::stridedView<T>(left);
+		ConstMatrixView<T> b = detail::stridedView<T>(right);
+		if (a.columns() != b.rows())
+			throw std::invalid_argument("Matrix dimensions do not match");
+		Matrix<T> result(b.columns(), a.rows());
+		if (a.columnStride() == 1 && b.columnStride() == 1)
+			detail::product<T>(a.rows(), b.columns(), a.columns(), a.data(), a.rowStride(), b.data(), b.rowStride(), result.inner_.data(), result.dimx_);
+		else
+			detail::gemm<T>(a.rows(), b.columns(), a.columns(), T(1),
+				a.data(), a.rowStride(), a.columnStride(),
+				b.data(), b.rowStride(), b.columnStride(), T(),
+				result.inner_.data(), result.dimx_, 1);
+		return result;
+	}
+
+	/// <summary>
+	/// Multiplies a by b into out, summing the products in Acc rather than T
+	/// </summary>
+	/// <param name="out">Has to be b's columns by a's rows and must not be either operand, it's overwritten</param>
+	/// <remarks>
+	/// Acc defaults to what operator* uses. multiply<double>(a, b, out) keeps float matrices in float in
+	/// memory but sums every dot product in double and rounds once at the end. Borrowed matrices can
+	/// be written this way without their memory being swapped out
+	/// </remarks>
+	template<class Acc = void, class T, class A, class B, class C>
+	void multiply(const Matrix<T, A>& a, const Matrix<T, B>& b, Matrix<T, C>& out) {
+		using Sum = typename std::conditional<std::is_void<Acc>::value, detail::AccumulatorType<T>, Acc>::type;
+		if (a.dimx_ != b.dimy_ || out.dimx_ != b.dimx_ || out.dimy_ != a.dimy_)
+			throw std::invalid_argument("Matrix dimensions do not match");
+		detail::OperationScope scope(Operation::Multiply, 2.0 * a.dimy_ * b.dimx_ * a.dimx_);
+		out.invalidate();
+		if constexpr (std::is_same<Sum, T>::value)
+			detail::product<T>(a.dimy_, b.dimx_, a.dimx_, a.inner_.data(), a.dimx_, b.inner_.data(), b.dimx_, out.inner_.data(), out.dimx_);
+		else
+			detail::gemm<T, Sum>(a.dimy_, b.dimx_, a.dimx_, Sum(1),
+				a.inner_.data(), a.dimx_, 1,
+				b.inner_.data(), b.dimx_, 1, Sum(),
+				out.inner_.data(), out.dimx_, 1);
+	}
+
+	/// <summary>
+	/// Multiplies a by b, summing the products in Acc rather than T
+	/// </summary>
+	/// <returns>A new matrix with the rows of a and the columns of b</returns>
+	template<class Acc = void, class T, class A, class B>
+	Matrix<T, A> multiply(const Matrix<T, A>& a, const Matrix<T, B>& b) {
+		Matrix<T, A> result(b.dimx_, a.dimy_, std::allocator_traits<A>::select_on_container_copy_construction(a.inner_.get_allocator()));
+		multiply<Acc>(a, b, result);
+		return result;
+	}
+
+	/// <summary>
+	/// y = a * x without allocating
+	/// </summary>
+	/// <param name="y">Needs as many elements as a has rows and must not be x, it's overwritten</param>
+	/// <remarks>
+	/// Every row of a is one vectorised dot product with x and the rows are split over the thread pool, so a
+	/// is streamed from memory once. The 16 bit floats and small integers sum in float and int32
+	/// </remarks>
+	template<class T, class A, class V, class W>
+	void multiply(const Matrix<T, A>& a, const Vector<T, V>& x, Vector<T, W>& y) {
+		if (a.dimx_ != x.size() || a.dimy_ != y.size())
+			throw std::invalid_argument("Matrix dimensions do not match");
+		detail::OperationScope scope(Operation::Multiply, 2.0 * a.dimy_ * a.dimx_);
+		detail::gemv<T>(a.dimy_, a.dimx_, T(1), a.inner_.data(), a.dimx_, 1, x.data(), T(), y.data());
+	}
+
+	/// <summary>
+	/// Matrix vector product
+	/// </summary>
+	/// <returns>A new vector with an element for every row of a</returns>
+	template<class T, class A, class V>
+	Vector<T, V> operator*(const Matrix<T, A>& a, const Vector<T, V>& x) {
+		Vector<T, V> y(a.dimy_, std::allocator_traits<V>::select_on_container_copy_construction(x.inner_.get_allocator()));
+		multiply(a, x, y);
+		return y;
+	}
+
+	/// <summary>
+	/// Vector product with a view or an unevaluated expression, e.g. a.view().transposed() * x
+	/// </summary>
+	/// <remarks>Views are read in place through their strides, other expressions are evaluated first</remarks>
+	template<class L, class T, class V>
+	Vector<T, V> operator*(const MatrixExpression<L>& l, const Vector<T, V>& x) {
+		decltype(auto) left = detail::evaluateAs<T>(l.self());
+		ConstMatrixView<T> a = detail::stridedView<T>(left);
+		if (a.columns() != x.size())
+			throw std::invalid_argument("Matrix dimensions do not match");
+		detail::OperationScope scope(Operation::Multiply, 2.0 * a.rows() * a.columns());
+		Vector<T, V> y(a.rows(), std::allocator_traits<V>::select_on_container_copy_construction(x.inner_.get_allocator()));
+		detail::gemv<T>(a.rows(), a.columns(), T(1), a.data(), a.rowStride(), a.columnStride(), x.data(), T(), y.data());
+		return y;
+	}
+
+	/// <summary>
+	/// y = transpose(a) * x without transposing a or allocating
+	/// </summary>
+	/// <param name="y">Needs as many elements as a has columns and must not be x, it's overwritten</param>
+	/// <remarks>
+	/// x[i] times row i of a is added to blocks of y that stay in cache, so a is still read once from
+	/// beginning to end. When y is too short to split over the pool the rows of a are split instead
+	/// </remarks>
+	template<class T, class A, class V, class W>
+	void multiplyTransposed(const Matrix<T, A>& a, const Vector<T, V>& x, Vector<T, W>& y) {
+		if (a.dimy_ != x.size() || a.dimx_ != y.size())
+			throw std::invalid_argument("Matrix dimensions do not match");
+		detail::OperationScope scope(Operation::Multiply, 2.0 * a.dimy_ * a.dimx_);
+		detail::gemv<T>(a.dimx_, a.dimy_, T(1), a.inner_.data(), 1, a.dimx_, x.data(), T(), y.data());
+	}
+
+	/// <summary>
+	/// transpose(a) * x
+	/// </summary>
+	/// <returns>A new vector with an element for every column of a</returns>
+	template<class T, class A, class V>
+	Vector<T, V> multiplyTransposed(const Matrix<T, A>& a, const Vector<T, V>& x) {
+		Vector<T, V> y(a.dimx_, std::allocator_traits<V>::select_on_container_copy_construction(x.inner_.get_allocator()));
+		multiplyTransposed(a, x, y);
+		return y;
+	}
+
+	namespace detail {
+
+		/// <summary>
+		/// a, or its transpose, times every vector of a batch
+		/// </summary>
+		/// <remarks>
+		/// The vectors are packed as the columns of one matrix so the whole batch is a single gemm, which
+		/// streams a from memory once for up to a column panel of vectors where separate products would
+		/// read all of it for every vector. A batch of one goes to gemv
+		/// </remarks>
+		template<class T, class A, class V>
+		std::vector<Vector<T, V>> multiplyBatch(const Matrix<T, A>& a, bool transposed, const std::vector<Vector<T, V>>& xs) {
+			int m = transposed ? a.dimx_ : a.dimy_;
+			int k = transposed ? a.dimy_ : a.dimx_;
+			std::ptrdiff_t rsa = transposed ? 1 : a.dimx_;
+			std::ptrdiff_t csa = transposed ? a.dimx_ : 1;
+			int count = static_cast<int>(xs.size());
+			for (const auto& x : xs) {
+				if (x.size() != k)
+					throw std::invalid_argument("Matrix dimensions do not match");
+			}
+			OperationScope scope(Operation::Multiply, 2.0 * m * k * count);
+			std::vector<Vector<T, V>> ys;
+			ys.reserve(xs.size());
+			for (const auto& x : xs)
+				ys.emplace_back(m, std::allocator_traits<V>::select_on_container_copy_construction(x.inner_.get_allocator()));
+			if (count == 1)
+				gemv<T>(m, k, T(1), a.inner_.data(), rsa, csa, xs[0].data(), T(), ys[0].data());
+			if (count <= 1)
+				return ys;
+
+			std::vector<T, AlignedAllocator<T>> x(static_cast<size_t>(k) * count);
+			std::vector<T, AlignedAllocator<T>> y(static_cast<size_t>(m) * count);
+			for (int v = 0; v < count; v++) {
+				for (int j = 0; j < k; j++)
+					x[static_cast<size_t>(j) * count + v] = xs[v][j];
+			}
+			gemm<T>(m, count, k, T(1), a.inner_.data(), rsa, csa, x.data(), count, 1, T(), y.data(), count, 1);
+			for (int v = 0; v < count; v++) {
+				for (int i = 0; i < m; i++)
+					ys[v][i] = y[static_cast<size_t>(i) * count + v];
+			}
+			return ys;
+		}
+	}
+
+	/// <summary>
+	/// Multiplies a with every vector of a batch, reading a from memory once rather than once per vector
+	/// </summary>
+	/// <returns>a * xs[i] for every i</returns>
+	template<class T, class A, class V>
+	std::vector<Vector<T, V>> multiply(const Matrix<T, A>& a, const std::vector<Vector<T, V>>& xs) {
+		return detail::multiplyBatch(a, false, xs);
+	}
+
+	/// <summary>
+	/// Multiplies transpose(a) with every vector of a batch, reading a from memory once rather than once per vector
+	/// </summary>
+	/// <returns>transpose(a) * xs[i] for every i</returns>
+	template<class T, class A, class V>
+	std::vector<Vector<T, V>> multiplyTransposed(const Matrix<T, A>& a, const std::vector<Vector<T, V>>& xs) {
+		return detail::multiplyBatch(a, true, xs);
+	}
+
+	namespace detail {
+
+		/// <summary>
+		/// Whether the result of combining a Matrix of T with E can be stored back into the Matrix of T
+		/// </summary>
+		template<class T, class E>
+		using ReusesBuffer = typename std::enable_if<
+			std::is_same<typename std::common_type<T, typename E::value_type>::type, T>::value, int>::type;
+	}
+
+	// Overloads for a matrix that is about to be destroyed, the result is written into its buffer
+	// instead of a new one so chains like f() + A - B never allocate
+
+	/// <summary>
+	/// Addition that reuses the buffer of a temporary left operand
+	/// </summary>
+	template<class T, class A, class R, detail::ReusesBuffer<T, R> = 0>
+	Matrix<T, A> operator+(Matrix<T, A>&& l, const MatrixExpression<R>& r) {
+		l += r;
+		return std::move(l);
+	}
+
+	/// <summary>
+	/// Addition that reuses the buffer of a temporary right operand
+	/// </summary>
+	template<class L, class T, class A, detail::ReusesBuffer<T, L> = 0>
+	Matrix<T, A> operator+(const MatrixExpression<L>& l, Matrix<T, A>&& r) {
+		r += l;
+		return std::move(r);
+	}
+
+	/// <summary>
+	/// Addition of two temporaries, the left one's buffer is reused
+	/// </summary>
+	template<class T, class A>
+	Matrix<T, A> operator+(Matrix<T, A>&& l, Matrix<T, A>&& r) {
+		l += r;
+		return std::move(l);
+	}
+
+	/// <summary>
+	/// Subtraction that reuses the buffer of a temporary left operand
+	/// </summary>
+	template<class T, class A, class R, detail::ReusesBuffer<T, R> = 0>
+	Matrix<T, A> operator-(Matrix<T, A>&& l, const MatrixExpression<R>& r) {
+		l -= r;
+		return std::move(l);
+	}
+
+	/// <summary>
+	/// Subtraction that reuses the buffer of a temporary right operand
+	/// </summary>
+	template<class L, class T, class A, detail::ReusesBuffer<T, L> = 0>
+	Matrix<T, A> operator-(const MatrixExpression<L>& l, Matrix<T, A>&& r) {
+		r = l.self() - r;
+		return std::move(r);
+	}
+
+	/// <summary>
+	/// Subtraction of two temporaries, the left one's buffer is reused
+	/// </summary>
+	template<class T, class A>
+	Matrix<T, A> operator-(Matrix<T, A>&& l, Matrix<T, A>&& r) {
+		l -= r;
+		return std::move(l);
+	}
+
+	/// <summary>
+	/// Scalar multiplication that reuses the buffer of a temporary matrix
+	/// </summary>
+	template<class T, class A, class S, typename std::enable_if<std::is_arithmetic<S>::value, int>::type = 0>
+	Matrix<T, A> operator*(Matrix<T, A>&& m, S scalar) {
+		m *= scalar;
+		return std::move(m);
+	}
+
+	/// <summary>
+	/// Scalar multiplication that reuses the buffer of a temporary matrix
+	/// </summary>
+	template<class T, class A, class S, typename std::enable_if<std::is_arithmetic<S>::value, int>::type = 0>
+	Matrix<T, A> operator*(S scalar, Matrix<T, A>&& m) {
+		m *= scalar;
+		return std::move(m);
+	}
+
+	namespace detail {
+		inline double solveFlops(int m, int n, int nrhs) {
+			return 2.0 * m * n * n / 3 + 2.0 * m * n * nrhs;
+		}
+
+		/// <summary>
+		/// Solves a * X = b against the LU or Cholesky factorisation a keeps, so only the first solve against an unchanged a is O(n^3)
+		/// </summary>
+		/// <param name="b">Row major n x nrhs, on exit X</param>
+		template<class T, class A, class F>
+		void solveFactored(const Matrix<T, A>& a, Solver solver, int nrhs, F* b, std::ptrdiff_t ldb) {
+			int n = a.dimx_;
+			if (solver == Solver::Cholesky) {
+				auto factors = a.choleskyFactors();
+				if (factors->info != 0)
+					throw std::invalid_argument("Matrix is not positive definite");
+				choleskySolve(n, nrhs, factors->l.data(), n, b, ldb);
+			}
+			else {
+				auto factors = a.luFactors();
+				if (factors->info != 0)
+					throw std::invalid_argument("Matrix is singular");
+				luSolve(n, nrhs, factors->lu.data(), n, factors->pivots.data(), b, ldb);
 			}
-			return temp;
 		}
+	}
+
+	/// <summary>
+	/// Solves a * X = b for every column of b without forming an inverse
+	/// </summary>
+	/// <param name="a">Square for LU and Cholesky, at least as many rows as columns for QR, it is left as it was</param>
+	/// <param name="b">The right hand sides, one per column, it needs as many rows as a</param>
+	/// <returns>X with as many rows as a has columns, the least squares solution for QR</returns>
+	/// <remarks>
+	/// Throws std::invalid_argument when the shapes don't fit, a is singular or, for Cholesky, not positive
+	/// definite. Integer matrices are solved in double and the solution is converted back. A square a keeps
+	/// its factorisation, so solving against it again only costs the triangular solves
+	/// </remarks>
+	template<class T, class A, class B>
+	Matrix<T, B> solve(const Matrix<T, A>& a, const Matrix<T, B>& b, Solver solver = Solver::Auto) {
+		if (a.dimy_ != b.dimy_)
+			throw std::invalid_argument("Matrix dimensions do not match");
+		detail::OperationScope scope(Operation::Solve, detail::solveFlops(a.dimy_, a.dimx_, b.dimx_));
+		using F = detail::FactorType<T>;
+		std::vector<F, AlignedAllocator<F>> x(b.inner_.begin(), b.inner_.end());
+		if (a.dimx_ == a.dimy_ && solver != Solver::QR) {
+			detail::solveFactored(a, solver, b.dimx_, x.data(), b.dimx_);
+		}
+		else {
+			std::vector<F, AlignedAllocator<F>> factors(a.inner_.begin(), a.inner_.end());
+			detail::solveSystem(solver, a.dimy_, a.dimx_, b.dimx_, factors.data(), a.dimx_, x.data(), b.dimx_);
+		}
+		Matrix<T, B> result(b.dimx_, a.dimx_, std::allocator_traits<B>::select_on_container_copy_construction(b.inner_.get_allocator()));
+		for (size_t i = 0; i < result.inner_.size(); i++)
+			result.inner_[i] = static_cast<T>(x[i]);
+		return result;
+	}
+
+	/// <summary>
+	/// Solves a * x = b for a single right hand side without forming an inverse
+	/// </summary>
+	template<class T, class A>
+	std::vector<T> solve(const Matrix<T, A>& a, const std::vector<T>& b, Solver solver = Solver::Auto) {
+		if (static_cast<size_t>(a.dimy_) != b.size())
+			throw std::invalid_argument("Matrix dimensions do not match");
+		detail::OperationScope scope(Operation::Solve, detail::solveFlops(a.dimy_, a.dimx_, 1));
+		using F = detail::FactorType<T>;
+		std::vector<F, AlignedAllocator<F>> x(b.begin(), b.end());
+		if (a.dimx_ == a.dimy_ && solver != Solver::QR) {
+			detail::solveFactored(a, solver, 1, x.data(), 1);
+		}
+		else {
+			std::vector<F, AlignedAllocator<F>> factors(a.inner_.begin(), a.inner_.end());
+			detail::solveSystem(solver, a.dimy_, a.dimx_, 1, factors.data(), a.dimx_, x.data(), 1);
+		}
+		return std::vector<T>(x.begin(), x.begin() + a.dimx_);
+	}
+
+	/// <summary>
+	/// Solves a * X = b without copying either of them, a is overwritten with its factorisation and b with X
+	/// </summary>
+	/// <remarks>
+	/// Nothing is allocated beyond the pivots, or for QR tau and one row of workspace.
+	/// Use it when a different a of the same shape is solved every time, solve keeps the factorisation
+	/// when a stays the same.
+	/// For QR b is cut down to X's rows afterwards.
+	/// If it throws b is left as it was, but a may already hold part of its factorisation
+	/// </remarks>
+	template<class T, class A, class B>
+	void solveInPlace(Matrix<T, A>& a, Matrix<T, B>& b, Solver solver = Solver::Auto) {
+		static_assert(std::is_floating_point<T>::value, "solveInPlace needs floating point matrices, use solve");
+		if (a.dimy_ != b.dimy_)
+			throw std::invalid_argument("Matrix dimensions do not match");
+		detail::OperationScope scope(Operation::Solve, detail::solveFlops(a.dimy_, a.dimx_, b.dimx_));
+		a.invalidate();
+		b.invalidate();
+		detail::solveSystem(solver, a.dimy_, a.dimx_, b.dimx_, a.inner_.data(), a.dimx_, b.inner_.data(), b.dimx_);
+		if (b.dimy_ != a.dimx_) {
+			b.inner_.resize(static_cast<size_t>(a.dimx_) * b.dimx_);
+			b.dimy_ = a.dimx_;
+		}
+	}
+
+	/// <summary>
+	/// Solves a * x = b for a single right hand side in place, a is overwritten with its factorisation and b with x
+	/// </summary>
+	template<class T, class A>
+	void solveInPlace(Matrix<T, A>& a, std::vector<T>& b, Solver solver = Solver::Auto) {
+		static_assert(std::is_floating_point<T>::value, "solveInPlace needs floating point matrices, use solve");
+		if (static_cast<size_t>(a.dimy_) != b.size())
+			throw std::invalid_argument("Matrix dimensions do not match");
+		detail::OperationScope scope(Operation::Solve, detail::solveFlops(a.dimy_, a.dimx_, 1));
+		a.invalidate();
+		detail::solveSystem(solver, a.dimy_, a.dimx_, 1, a.inner_.data(), a.dimx_, b.data(), 1);
+		b.resize(a.dimx_);
+	}
+
+	/// <summary>
+	/// The eigenvalues of a symmetric matrix in ascending order and the eigenvectors that go with them
+	/// </summary>
+	template<class T>
+	struct SymmetricEigenSystem {
+		std::vector<T> values;
+		Matrix<T> vectors;   // column i is the unit eigenvector of values[i], the columns are orthonormal
+	};
 
-		// TODO : refactor so it's much better code
-		// outputs the matrix in text format
-		friend std::ostream& operator<<(std::ostream& os, Matrix<T>& matrix) {
-			os << matrix.toString();
-			return os;
+	/// <summary>
+	/// Diagonalises a symmetric matrix, a = vectors * diag(values) * vectors^T
+	/// </summary>
+	/// <param name="method">Jacobi rotations for small matrices and a tridiagonal reduction for the rest unless told otherwise</param>
+	/// <remarks>
+	/// Only the lower triangle of a is read and symmetry isn't checked. The tridiagonal reduction and the
+	/// back transformation of the eigenvectors are blocked into gemm calls and the rest is split across the
+	/// pool. Integer matrices are diagonalised in double
+	/// </remarks>
+	template<class T, class A>
+	SymmetricEigenSystem<detail::FactorType<T>> eigenSystem(const Matrix<T, A>& a, EigenMethod method = EigenMethod::Auto) {
+		using F = detail::FactorType<T>;
+		if (a.dimx_ != a.dimy_)
+			throw std::invalid_argument("Matrix is not n by n");
+		int n = a.dimx_;
+		detail::OperationScope scope(Operation::Eigensystem, 9.0 * n * n * n);
+		auto work = detail::symmetricCopy<F>(n, a.inner_.data());
+		SymmetricEigenSystem<F> result{ std::vector<F>(n), Matrix<F>(n, n) };
+		detail::symmetricEigen(method, n, work.data(), n, result.values.data(), result.vectors.inner_.data(), n);
+		return result;
+	}
+
+	/// <summary>
+	/// A matrix kept as int8 with a single scale, the element at col, row stands for scale * values.getAt(col, row)
+	/// </summary>
+	struct QuantizedMatrix {
+		Matrix<std::int8_t> values;
+		float scale = 1;
+
+		int columns() const { return values.dimx_; }
+		int rows() const { return values.dimy_; }
+
+		/// <summary>
+		/// The float matrix the int8 values stand for
+		/// </summary>
+		Matrix<float> dequantize() const {
+			Matrix<float> result(values.dimx_, values.dimy_);
+			for (size_t i = 0; i < values.inner_.size(); i++)
+				result.inner_[i] = scale * values.inner_[i];
+			return result;
 		}
 	};
+
+	/// <summary>
+	/// Rounds every element of m to the nearest of 255 evenly spaced levels between -max|m| and max|m|
+	/// </summary>
+	/// <remarks>Symmetric per matrix quantisation, the error in each element is at most half a step, max|m| / 254</remarks>
+	template<class T, class A>
+	QuantizedMatrix quantize(const Matrix<T, A>& m) {
+		double largest = m.getNorm(Norm::Max);
+		double step = largest > 0 ? largest / 127 : 1;
+		QuantizedMatrix result{ Matrix<std::int8_t>(m.dimx_, m.dimy_), static_cast<float>(step) };
+		double inverse = 1 / step;
+		const T* in = m.inner_.data();
+		std::int8_t* out = result.values.inner_.data();
+		detail::parallelFor(0, static_cast<std::ptrdiff_t>(m.inner_.size()), detail::simd::ParallelChunk, m.inner_.size(),
+			[&](std::ptrdiff_t first, std::ptrdiff_t last) {
+				for (std::ptrdiff_t i = first; i < last; i++) {
+					double level = std::nearbyint(static_cast<double>(in[i]) * inverse);
+					out[i] = static_cast<std::int8_t>(std::min(127.0, std::max(-127.0, level)));
+				}
+			});
+		return result;
+	}
+
+	/// <summary>
+	/// Multiplies two quantized matrices, the int8 products are summed exactly in int32 and scaled to float on the way out
+	/// </summary>
+	/// <remarks>Exact as long as a has fewer than 2^31 / 127^2, about 133000, columns</remarks>
+	inline Matrix<float> operator*(const QuantizedMatrix& a, const QuantizedMatrix& b) {
+		if (a.columns() != b.rows())
+			throw std::invalid_argument("Matrix dimensions do not match");
+		detail::OperationScope scope(Operation::Multiply, 2.0 * a.rows() * b.columns() * a.columns());
+		Matrix<float> result(b.columns(), a.rows());
+		detail::gemm<std::int8_t, std::int32_t, float, float>(a.rows(), b.columns(), a.columns(), a.scale * b.scale,
+			a.values.inner_.data(), a.columns(), 1,
+			b.values.inner_.data(), b.columns(), 1, 0.0f,
+			result.inner_.data(), result.dimx_, 1);
+		return result;
+	}
 }
@@ -0,0 +1,628 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "Allocators.hpp"
+#include "FixedMatrix.hpp"
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+
+namespace matrices {
+	namespace detail {
+		namespace batch {
+
+			/// <summary>
+			/// A block holds one cache line of every element for Lanes matrices, element e of matrix l is at block[e * Lanes + l]
+			/// </summary>
+			template<class T>
+			struct Block {
+				static constexpr size_t Lanes = 64 / sizeof(T);
+			};
+
+			/// <summary>
+			/// Plain C++ stand-in for simd::Vec, used when the CPU has none of the instruction sets
+			/// </summary>
+			template<class T>
+			struct ScalarVec {
+				using Reg = T;
+				using Mask = bool;
+				static constexpr size_t width = 1;
+				static MATRICES_INLINE Reg load(const T* p) { return *p; }
+				static MATRICES_INLINE void store(T* p, Reg x) { *p = x; }
+				static MATRICES_INLINE Reg set1(T v) { return v; }
+				static MATRICES_INLINE Reg add(Reg x, Reg y) { return x + y; }
+				static MATRICES_INLINE Reg sub(Reg x, Reg y) { return x - y; }
+				static MATRICES_INLINE Reg mul(Reg x, Reg y) { return x * y; }
+				static MATRICES_INLINE Reg div(Reg x, Reg y) { return x / y; }
+				static MATRICES_INLINE Reg fmadd(Reg x, Reg y, Reg acc) { return acc + x * y; }
+				static MATRICES_INLINE Reg fnmadd(Reg x, Reg y, Reg acc) { return acc - x * y; }
+				static MATRICES_INLINE Reg abs(Reg x) { return std::abs(x); }
+				static MATRICES_INLINE Mask greater(Reg x, Reg y) { return x > y; }
+				static MATRICES_INLINE Mask equal(Reg x, Reg y) { return x == y; }
+				static MATRICES_INLINE Reg select(Mask m, Reg x, Reg y) { return m ? x : y; }
+			};
+
+			/// <summary>
+			/// Runs body(first block, last block) over the blocks, across the pool once there is enough work
+			/// </summary>
+			template<class F>
+			void forBlocks(size_t blocks, size_t workPerBlock, const F& body) {
+				parallelFor(0, static_cast<std::ptrdiff_t>(blocks), 64, blocks * workPerBlock,
+					[&](std::ptrdiff_t first, std::ptrdiff_t last) { body(static_cast<size_t>(first), static_cast<size_t>(last)); });
+			}
+
+// Asks for a loop over the compile time shape to be unrolled, so accumulators indexed by it stay in registers
+#if defined(__clang__)
+#define MATRICES_UNROLL _Pragma("unroll")
+#elif defined(__GNUC__)
+#define MATRICES_UNROLL _Pragma("GCC unroll 16")
+#else
+#define MATRICES_UNROLL
+#endif
+
+// Stamps out the block kernels for one instruction set. Vec<T> has to be declared in the enclosing
+// namespace, Pack<T> strings enough of its registers together to cover one element of a whole block
+// so every kernel works on Lanes matrices at once
+#define MATRICES_BATCH_KERNELS(target)                                                                                        \
+			template<class T>                                                                                                 \
+			struct Pack {                                                                                                     \
+				using V = Vec<T>;                                                                                             \
+				using Reg = typename V::Reg;                                                                                  \
+				static constexpr size_t count = Block<T>::Lanes / V::width;                                                   \
+				struct Mask { typename V::Mask m[count]; };                                                                   \
+				Reg r[count];                                                                                                 \
+                                                                                                                              \
+				target static MATRICES_INLINE Pack load(const T* p) {                                                         \
+					Pack x;                                                                                                   \
+					for (size_t i = 0; i < count; i++) x.r[i] = V::load(p + i * V::width);                                    \
+					return x;                                                                                                 \
+				}                                                                                                             \
+				target static MATRICES_INLINE void store(T* p, const Pack& x) {                                               \
+					for (size_t i = 0; i < count; i++) V::store(p + i * V::width, x.r[i]);                                    \
+				}                                                                                                             \
+				target static MATRICES_INLINE Pack set1(T v) {                                                                \
+					Pack x;                                                                                                   \
+					for (size_t i = 0; i < count; i++) x.r[i] = V::set1(v);                                                   \
+					return x;                                                                                                 \
+				}                                                                                                             \
+				target static MATRICES_INLINE Pack add(const Pack& x, const Pack& y) {                                        \
+					Pack z;                                                                                                   \
+					for (size_t i = 0; i < count; i++) z.r[i] = V::add(x.r[i], y.r[i]);                                       \
+					return z;                                                                                                 \
+				}                                                                                                             \
+				target static MATRICES_INLINE Pack sub(const Pack& x, const Pack& y) {                                        \
+					Pack z;                                                                                                   \
+					for (size_t i = 0; i < count; i++) z.r[i] = V::sub(x.r[i], y.r[i]);                                       \
+					return z;                                                                                                 \
+				}                                                                                                             \
+				target static MATRICES_INLINE Pack mul(const Pack& x, const Pack& y) {                                        \
+					Pack z;                                                                                                   \
+					for (size_t i = 0; i < count; i++) z.r[i] = V::mul(x.r[i], y.r[i]);                                       \
+					return z;                                                                                                 \
+				}                                                                                                             \
+				target static MATRICES_INLINE Pack div(const Pack& x, const Pack& y) {                                        \
+					Pack z;                                                                                                   \
+					for (size_t i = 0; i < count; i++) z.r[i] = V::div(x.r[i], y.r[i]);                                       \
+					return z;                                                                                                 \
+				}                                                                                                             \
+				target static MATRICES_INLINE Pack fmadd(const Pack& x, const Pack& y, const Pack& acc) {                     \
+					Pack z;                                                                                                   \
+					for (size_t i = 0; i < count; i++) z.r[i] = V::fmadd(x.r[i], y.r[i], acc.r[i]);                           \
+					return z;                                                                                                 \
+				}                                                                                                             \
+				target static MATRICES_INLINE Pack fnmadd(const Pack& x, const Pack& y, const Pack& acc) {                    \
+					Pack z;                                                                                                   \
+					for (size_t i = 0; i < count; i++) z.r[i] = V::fnmadd(x.r[i], y.r[i], acc.r[i]);                          \
+					return z;                                                                                                 \
+				}                                                                                                             \
+				target static MATRICES_INLINE Pack abs(const Pack& x) {                                                       \
+					Pack z;                                                                                                   \
+					for (size_t i = 0; i < count; i++) z.r[i] = V::abs(x.r[i]);                                               \
+					return z;                                                                                                 \
+				}                                                                                                             \
+				target static MATRICES_INLINE Mask greater(const Pack& x, const Pack& y) {                                    \
+					Mask z;                                                                                                   \
+					for (size_t i = 0; i < count; i++) z.m[i] = V::greater(x.r[i], y.r[i]);                                   \
+					return z;                                                                                                 \
+				}                                                                                                             \
+				target static MATRICES_INLINE Mask equal(const Pack& x, const Pack& y) {                                      \
+					Mask z;                                                                                                   \
+					for (size_t i = 0; i < count; i++) z.m[i] = V::equal(x.r[i], y.r[i]);                                     \
+					return z;                                                                                                 \
+				}                                                                                                             \
+				target static MATRICES_INLINE Pack select(const Mask& m, const Pack& x, const Pack& y) {                      \
+					Pack z;                                                                                                   \
+					for (size_t i = 0; i < count; i++) z.r[i] = V::select(m.m[i], x.r[i], y.r[i]);                            \
+					return z;                                                                                                 \
+				}                                                                                                             \
+			};                                                                                                                \
+                                                                                                                              \
+			template<class T, int Rows, int Inner, int Columns>                                                               \
+			target MATRICES_INLINE void multiply(const T* a, const T* b, T* out) {                                            \
+				using P = Pack<T>;                                                                                            \
+				constexpr size_t L = Block<T>::Lanes;                                                                         \
+				for (int r = 0; r < Rows; r++) {                                                                              \
+					P acc[Columns];                                                                                           \
+					MATRICES_UNROLL                                                                                           \
+					for (int c = 0; c < Columns; c++)                                                                         \
+						acc[c] = P::set1(T(0));                                                                               \
+					for (int k = 0; k < Inner; k++) {                                                                         \
+						P x = P::load(a + (r * Inner + k) * L);                                                               \
+						MATRICES_UNROLL                                                                                       \
+						for (int c = 0; c < Columns; c++)                                                                     \
+							acc[c] = P::fmadd(x, P::load(b + (k * Columns + c) * L), acc[c]);                                 \
+					}                                                                                                         \
+					MATRICES_UNROLL                                                                                           \
+					for (int c = 0; c < Columns; c++)                                                                         \
+						P::store(out + (r * Columns + c) * L, acc[c]);                                                        \
+				}                                                                                                             \
+			}                                                                                                                 \
+                                                                                                                              \
+			template<class T, int Rows, int Columns>                                                                          \
+			target MATRICES_INLINE void similarity(const T* a, const T* b, T* out) {                                          \
+				using P = Pack<T>;                                                                                            \
+				constexpr size_t L = Block<T>::Lanes;                                                                         \
+				alignas(64) T ab[Rows * Columns * L];                                                                         \
+				multiply<T, Rows, Columns, Columns>(a, b, ab);                                                                \
+				for (int r = 0; r < Rows; r++) {                                                                              \
+					P acc[Rows];                                                                                              \
+					MATRICES_UNROLL                                                                                           \
+					for (int c = 0; c < Rows; c++)                                                                            \
+						acc[c] = P::set1(T(0));                                                                               \
+					for (int k = 0; k < Columns; k++) {                                                                       \
+						P x = P::load(ab + (r * Columns + k) * L);                                                            \
+						MATRICES_UNROLL                                                                                       \
+						for (int c = 0; c < Rows; c++)                                                                        \
+							acc[c] = P::fmadd(x, P::load(a + (c * Columns + k) * L), acc[c]);                                 \
+					}                                                                                                         \
+					MATRICES_UNROLL                                                                                           \
+					for (int c = 0; c < Rows; c++)                                                                            \
+						P::store(out + (r * Rows + c) * L, acc[c]);                                                           \
+				}                                                                                                             \
+			}                                                                                                                 \
+                                                                                                                              \
+			template<class T, int N, bool Invert>                                                                             \
+			target MATRICES_INLINE void eliminate(Pack<T>* m, Pack<T>* inverse, Pack<T>& det) {                               \
+				using P = Pack<T>;                                                                                            \
+				if (Invert) {                                                                                                 \
+					for (int i = 0; i < N * N; i++)                                                                           \
+						inverse[i] = P::set1(i % (N + 1) == 0 ? T(1) : T(0));                                                 \
+				}                                                                                                             \
+				det = P::set1(T(1));                                                                                          \
+				for (int k = 0; k < N; k++) {                                                                                 \
+					P best = P::abs(m[k * N + k]), pivot = P::set1(T(k));                                                     \
+					for (int i = k + 1; i < N; i++) {                                                                         \
+						P v = P::abs(m[i * N + k]);                                                                           \
+						typename P::Mask larger = P::greater(v, best);                                                        \
+						best = P::select(larger, v, best);                                                                    \
+						pivot = P::select(larger, P::set1(T(i)), pivot);                                                      \
+					}                                                                                                         \
+					for (int i = k + 1; i < N; i++) {                                                                         \
+						typename P::Mask swap = P::equal(pivot, P::set1(T(i)));                                               \
+						det = P::select(swap, P::sub(P::set1(T(0)), det), det);                                               \
+						for (int j = k; j < N; j++) {                                                                         \
+							P x = m[k * N + j], y = m[i * N + j];                                                             \
+							m[k * N + j] = P::select(swap, y, x);                                                             \
+							m[i * N + j] = P::select(swap, x, y);                                                             \
+						}                                                                                                     \
+						for (int j = 0; Invert && j < N; j++) {                                                               \
+							P x = inverse[k * N + j], y = inverse[i * N + j];                                                 \
+							inverse[k * N + j] = P::select(swap, y, x);                                                       \
+							inverse[i * N + j] = P::select(swap, x, y);                                                       \
+						}                                                                                                     \
+					}                                                                                                         \
+					det = P::mul(det, m[k * N + k]);                                                                          \
+					P reciprocal = P::div(P::set1(T(1)), m[k * N + k]);                                                       \
+					if (Invert) {                                                                                             \
+						for (int j = k; j < N; j++)                                                                           \
+							m[k * N + j] = P::mul(m[k * N + j], reciprocal);                                                  \
+						for (int j = 0; j < N; j++)                                                                           \
+							inverse[k * N + j] = P::mul(inverse[k * N + j], reciprocal);                                      \
+						for (int i = 0; i < N; i++) {                                                                         \
+							if (i == k)                                                                                       \
+								continue;                                                                                     \
+							P factor = m[i * N + k];                                                                          \
+							for (int j = k; j < N; j++)                                                                       \
+								m[i * N + j] = P::fnmadd(factor, m[k * N + j], m[i * N + j]);                                 \
+							for (int j = 0; j < N; j++)                                                                       \
+								inverse[i * N + j] = P::fnmadd(factor, inverse[k * N + j], inverse[i * N + j]);               \
+						}                                                                                                     \
+					}                                                                                                         \
+					else {                                                                                                    \
+						/* a zero pivot has already made det 0, leave the rows alone rather than multiply 0 by inf */         \
+						P zero = P::set1(T(0));                                                                               \
+						P safe = P::select(P::equal(m[k * N + k], zero), zero, reciprocal);                                   \
+						for (int i = k + 1; i < N; i++) {                                                                     \
+							P factor = P::mul(m[i * N + k], safe);                                                            \
+							for (int j = k + 1; j < N; j++)                                                                   \
+								m[i * N + j] = P::fnmadd(factor, m[k * N + j], m[i * N + j]);                                 \
+						}                                                                                                     \
+					}                                                                                                         \
+				}                                                                                                             \
+			}                                                                                                                 \
+                                                                                                                              \
+			template<class T, int N>                                                                                          \
+			target MATRICES_INLINE Pack<T> determinant(const Pack<T>* e) {                                                    \
+				using P = Pack<T>;                                                                                            \
+				if constexpr (N == 1)                                                                                         \
+					return e[0];                                                                                              \
+				else if constexpr (N == 2)                                                                                    \
+					return P::fnmadd(e[1], e[2], P::mul(e[0], e[3]));                                                         \
+				else if constexpr (N == 3) {                                                                                  \
+					P d = P::mul(e[0], P::fnmadd(e[5], e[7], P::mul(e[4], e[8])));                                            \
+					d = P::fnmadd(e[1], P::fnmadd(e[5], e[6], P::mul(e[3], e[8])), d);                                        \
+					return P::fmadd(e[2], P::fnmadd(e[4], e[6], P::mul(e[3], e[7])), d);                                      \
+				}                                                                                                             \
+				else {                                                                                                        \
+					P m[N * N], det;                                                                                          \
+					for (int i = 0; i < N * N; i++)                                                                           \
+						m[i] = e[i];                                                                                          \
+					eliminate<T, N, false>(m, nullptr, det);                                                                  \
+					return det;                                                                                               \
+				}                                                                                                             \
+			}                                                                                                                 \
+                                                                                                                              \
+			template<class T, int N>                                                                                          \
+			target MATRICES_INLINE void invert(T* a, unsigned char* singular) {                                               \
+				using P = Pack<T>;                                                                                            \
+				constexpr size_t L = Block<T>::Lanes;                                                                         \
+				P e[N * N], inverse[N * N], det;                                                                              \
+				for (int i = 0; i < N * N; i++)                                                                               \
+					e[i] = P::load(a + i * L);                                                                                \
+				if constexpr (N <= 3) {                                                                                       \
+					det = determinant<T, N>(e);                                                                               \
+					P r = P::div(P::set1(T(1)), det);                                                                         \
+					if constexpr (N == 1)                                                                                     \
+						inverse[0] = r;                                                                                       \
+					else if constexpr (N == 2) {                                                                              \
+						inverse[0] = P::mul(e[3], r);                                                                         \
+						inverse[1] = P::mul(P::sub(P::set1(T(0)), e[1]), r);                                                  \
+						inverse[2] = P::mul(P::sub(P::set1(T(0)), e[2]), r);                                                  \
+						inverse[3] = P::mul(e[0], r);                                                                         \
+					}                                                                                                         \
+					else {                                                                                                    \
+						/* the adjugate is the transposed cofactor matrix */                                                  \
+						for (int row = 0; row < 3; row++)                                                                     \
+							for (int col = 0; col < 3; col++) {                                                               \
+								int r0 = (col + 1) % 3, r1 = (col + 2) % 3, c0 = (row + 1) % 3, c1 = (row + 2) % 3;           \
+								P minor = P::fnmadd(e[r0 * 3 + c1], e[r1 * 3 + c0], P::mul(e[r0 * 3 + c0], e[r1 * 3 + c1]));  \
+							inverse[row * 3 + col] = P::mul(minor, r);                                                        \
+							}                                                                                                 \
+					}                                                                                                         \
+				}                                                                                                             \
+				else                                                                                                          \
+					eliminate<T, N, true>(e, inverse, det);                                                                   \
+				for (int i = 0; i < N * N; i++)                                                                               \
+					P::store(a + i * L, inverse[i]);                                                                          \
+				alignas(64) T d[L];                                                                                           \
+				P::store(d, det);                                                                                             \
+				for (size_t l = 0; l < L; l++)                                                                                \
+					singular[l] = d[l] == T(0) || !std::isfinite(d[l]);                                                       \
+			}                                                                                                                 \
+                                                                                                                              \
+			template<class T, int Rows, int Inner, int Columns>                                                               \
+			target void multiplyBlocks(const T* a, const T* b, T* out, size_t first, size_t last) {                           \
+				for (size_t i = first; i < last; i++)                                                                         \
+					multiply<T, Rows, Inner, Columns>(a + i * Rows * Inner * Block<T>::Lanes,                                 \
+						b + i * Inner * Columns * Block<T>::Lanes, out + i * Rows * Columns * Block<T>::Lanes);               \
+			}                                                                                                                 \
+                                                                                                                              \
+			template<class T, int Rows, int Columns>                                                                          \
+			target void similarityBlocks(const T* a, const T* b, T* out, size_t first, size_t last) {                         \
+				for (size_t i = first; i < last; i++)                                                                         \
+					similarity<T, Rows, Columns>(a + i * Rows * Columns * Block<T>::Lanes,                                    \
+						b + i * Columns * Columns * Block<T>::Lanes, out + i * Rows * Rows * Block<T>::Lanes);                \
+			}                                                                                                                 \
+                                                                                                                              \
+			template<class T, int Rows, int Columns>                                                                          \
+			target void transposeBlocks(const T* a, T* out, size_t first, size_t last) {                                      \
+				constexpr size_t L = Block<T>::Lanes;                                                                         \
+				for (size_t i = first; i < last; i++)                                                                         \
+					for (int r = 0; r < Rows; r++)                                                                            \
+						for (int c = 0; c < Columns; c++)                                                                     \
+							Pack<T>::store(out + ((i * Columns + c) * Rows + r) * L,                                          \
+							Pack<T>::load(a + ((i * Rows + r) * Columns + c) * L));                                           \
+			}                                                                                                                 \
+                                                                                                                              \
+			template<class T, int N>                                                                                          \
+			target void determinantBlocks(const T* a, T* det, size_t first, size_t last) {                                    \
+				constexpr size_t L = Block<T>::Lanes;                                                                         \
+				for (size_t i = first; i < last; i++) {                                                                       \
+					Pack<T> e[N * N];                                                                                         \
+					for (int j = 0; j < N * N; j++)                                                                           \
+						e[j] = Pack<T>::load(a + (i * N * N + j) * L);                                                        \
+					Pack<T>::store(det + i * L, determinant<T, N>(e));                                                        \
+				}                                                                                                             \
+			}                                                                                                                 \
+                                                                                                                              \
+			template<class T, int N>                                                                                          \
+			target void invertBlocks(T* a, unsigned char* singular, size_t first, size_t last) {                              \
+				for (size_t i = first; i < last; i++)                                                                         \
+					invert<T, N>(a + i * N * N * Block<T>::Lanes, singular + i * Block<T>::Lanes);                            \
+			}
+
+#ifdef MATRICES_X86
+			namespace avx512 {
+				using simd::avx512::Vec;
+				MATRICES_BATCH_KERNELS(MATRICES_TARGET("avx512f,avx512dq"))
+			}
+			namespace avx2 {
+				using simd::avx2::Vec;
+				MATRICES_BATCH_KERNELS(MATRICES_TARGET("avx2,fma"))
+			}
+			namespace sse2 {
+				using simd::sse2::Vec;
+				MATRICES_BATCH_KERNELS(MATRICES_TARGET("sse2"))
+			}
+#endif
+			namespace generic {
+				template<class T>
+				using Vec = ScalarVec<T>;
+				MATRICES_BATCH_KERNELS()
+			}
+
+#undef MATRICES_BATCH_KERNELS
+#undef MATRICES_UNROLL
+
+// Calls the kernel compiled for the widest instruction set the CPU has
+#ifdef MATRICES_X86
+#define MATRICES_BATCH_DISPATCH(...)                                                                    \
+			switch (simd::level()) {                                                                    \
+			case simd::Level::AVX512: return avx512::__VA_ARGS__;                                       \
+			case simd::Level::AVX2: return avx2::__VA_ARGS__;                                           \
+			case simd::Level::SSE2: return sse2::__VA_ARGS__;                                           \
+			default: return generic::__VA_ARGS__;                                                       \
+			}
+#else
+#define MATRICES_BATCH_DISPATCH(...) return generic::__VA_ARGS__;
+#endif
+
+			template<class T, int Rows, int Inner, int Columns>
+			void multiplyBlocks(const T* a, const T* b, T* out, size_t first, size_t last) {
+				MATRICES_BATCH_DISPATCH(multiplyBlocks<T, Rows, Inner, Columns>(a, b, out, first, last))
+			}
+
+			template<class T, int Rows, int Columns>
+			void similarityBlocks(const T* a, const T* b, T* out, size_t first, size_t last) {
+				MATRICES_BATCH_DISPATCH(similarityBlocks<T, Rows, Columns>(a, b, out, first, last))
+			}
+
+			template<class T, int Rows, int Columns>
+			void transposeBlocks(const T* a, T* out, size_t first, size_t last) {
+				MATRICES_BATCH_DISPATCH(transposeBlocks<T, Rows, Columns>(a, out, first, last))
+			}
+
+			template<class T, int N>
+			void determinantBlocks(const T* a, T* det, size_t first, size_t last) {
+				MATRICES_BATCH_DISPATCH(determinantBlocks<T, N>(a, det, first, last))
+			}
+
+			template<class T, int N>
+			void invertBlocks(T* a, unsigned char* singular, size_t first, size_t last) {
+				MATRICES_BATCH_DISPATCH(invertBlocks<T, N>(a, singular, first, last))
+			}
+
+#undef MATRICES_BATCH_DISPATCH
+		}
+	}
+
+	/// <summary>
+	/// Many matrices of the same small shape, e.g. a million 5x5 covariances, stored interleaved so that one SIMD lane works on one matrix
+	/// </summary>
+	/// <remarks>
+	/// The matrices are kept in blocks of Lanes (a cache line's worth, 8 doubles or 16 floats). Inside a block
+	/// the same element of every matrix sits next to the others, element col, row of matrix i is at
+	/// data()[(i / Lanes * Rows * Columns + row * Columns + col) * Lanes + i % Lanes]. Every operation runs the
+	/// same instructions on all the matrices of a block at once, so there is no per matrix call overhead,
+	/// and blocks are split across the thread pool. Inverses and determinants up to 3x3 are closed form,
+	/// larger ones use Gaussian elimination with partial pivoting done lane by lane without branches
+	/// </remarks>
+	template<class T, int Rows, int Columns>
+	class MatrixBatch {
+		static_assert(std::is_floating_point<T>::value, "Batches are for floating point matrices");
+		static_assert(Rows > 0 && Columns > 0, "A batch needs at least one row and one column");
+
+	public:
+		using value_type = T;
+		using matrix_type = FixedMatrix<T, Rows, Columns>;
+		static constexpr size_t Lanes = detail::batch::Block<T>::Lanes;
+		static constexpr int rowCount = Rows;
+		static constexpr int columnCount = Columns;
+		static constexpr int elementCount = Rows * Columns;
+
+		/// <summary>
+		/// Creates size matrices filled with 0
+		/// </summary>
+		explicit MatrixBatch(size_t size = 0)
+			: inner_(blockCount(size) * elementCount * Lanes), size_(size) {}
+
+		/// <summary>
+		/// Number of matrices in the batch
+		/// </summary>
+		size_t size() const {
+			return size_;
+		}
+
+		/// <summary>
+		/// Changes the number of matrices, the ones that are kept don't move and new ones are 0
+		/// </summary>
+		/// <remarks>fill writes the unused lanes of the last block too, so they are cleared before they can become matrices</remarks>
+		void resize(size_t size) {
+			size_t kept = std::min(size, size_);
+			for (size_t index = kept; index < blockCount(kept) * Lanes; index++)
+				for (int element = 0; element < elementCount; element++)
+					inner_[(index / Lanes * elementCount + element) * Lanes + index % Lanes] = T();
+			inner_.resize(blockCount(size) * elementCount * Lanes);
+			size_ = size;
+		}
+
+		/// <summary>
+		/// The interleaved elements, see the remarks on the class for the layout
+		/// </summary>
+		T* data() { return inner_.data(); }
+		const T* data() const { return inner_.data(); }
+
+		/// <summary>
+		/// Unchecked access to the element at col, row of matrix index
+		/// </summary>
+		T& elementAt(size_t index, int col, int row) {
+			return inner_[offset(index, col, row)];
+		}
+
+		const T& elementAt(size_t index, int col, int row) const {
+			return inner_[offset(index, col, row)];
+		}
+
+		/// <summary>
+		/// Returns the element at col, row of matrix index
+		/// </summary>
+		/// <remarks>Will throw an error if out of range</remarks>
+		T& getAt(size_t index, int col, int row) {
+			checkRange(index, col, row);
+			return elementAt(index, col, row);
+		}
+
+		const T& getAt(size_t index, int col, int row) const {
+			checkRange(index, col, row);
+			return elementAt(index, col, row);
+		}
+
+		/// <summary>
+		/// Copies matrix index out of the batch
+		/// </summary>
+		matrix_type get(size_t index) const {
+			if (index >= size_)
+				throw std::out_of_range("Index out of range");
+			matrix_type result;
+			for (int row = 0; row < Rows; row++)
+				for (int col = 0; col < Columns; col++)
+					result.inner_[row * Columns + col] = elementAt(index, col, row);
+			return result;
+		}
+
+		/// <summary>
+		/// Copies a matrix into position index of the batch
+		/// </summary>
+		void set(size_t index, const matrix_type& matrix) {
+			if (index >= size_)
+				throw std::out_of_range("Index out of range");
+			for (int row = 0; row < Rows; row++)
+				for (int col = 0; col < Columns; col++)
+					elementAt(index, col, row) = matrix.inner_[row * Columns + col];
+		}
+
+		/// <summary>
+		/// Sets every element of every matrix to value
+		/// </summary>
+		void fill(T value) {
+			detail::simd::fill(inner_.data(), value, inner_.size());
+		}
+
+		/// <summary>
+		/// Multiplies every matrix by the matrix at the same position in arg
+		/// </summary>
+		/// <remarks>Throws std::invalid_argument if the batches are different sizes</remarks>
+		template<int Other>
+		MatrixBatch<T, Rows, Other> operator*(const MatrixBatch<T, Columns, Other>& arg) const {
+			checkSameSize(arg.size());
+			MatrixBatch<T, Rows, Other> result(size_);
+			const T* a = data();
+			const T* b = arg.data();
+			T* out = result.data();
+			detail::batch::forBlocks(blockCount(size_), static_cast<size_t>(Rows) * Columns * Other * Lanes, [&](size_t first, size_t last) {
+				detail::batch::multiplyBlocks<T, Rows, Columns, Other>(a, b, out, first, last);
+			});
+			return result;
+		}
+
+		/// <summary>
+		/// Returns A * B * A^T for every matrix A of this batch and B at the same position in arg, e.g. propagating a covariance B through a Jacobian A
+		/// </summary>
+		/// <remarks>Throws std::invalid_argument if the batches are different sizes</remarks>
+		MatrixBatch<T, Rows, Rows> similarity(const MatrixBatch<T, Columns, Columns>& arg) const {
+			checkSameSize(arg.size());
+			MatrixBatch<T, Rows, Rows> result(size_);
+			const T* a = data();
+			const T* b = arg.data();
+			T* out = result.data();
+			detail::batch::forBlocks(blockCount(size_), static_cast<size_t>(Rows) * Columns * (Columns + Rows) * Lanes, [&](size_t first, size_t last) {
+				detail::batch::similarityBlocks<T, Rows, Columns>(a, b, out, first, last);
+			});
+			return result;
+		}
+
+		/// <summary>
+		/// Returns every matrix transposed
+		/// </summary>
+		MatrixBatch<T, Columns, Rows> transposed() const {
+			MatrixBatch<T, Columns, Rows> result(size_);
+			const T* a = data();
+			T* out = result.data();
+			detail::batch::forBlocks(blockCount(size_), static_cast<size_t>(elementCount) * Lanes, [&](size_t first, size_t last) {
+				detail::batch::transposeBlocks<T, Rows, Columns>(a, out, first, last);
+			});
+			return result;
+		}
+
+		/// <summary>
+		/// Returns the determinant of every matrix, in the same order as the batch
+		/// </summary>
+		std::vector<T> determinants() const {
+			static_assert(Rows == Columns, "Only a square matrix has a determinant");
+			std::vector<T> result(blockCount(size_) * Lanes);
+			const T* a = data();
+			T* out = result.data();
+			detail::batch::forBlocks(blockCount(size_), static_cast<size_t>(Rows) * Rows * Rows * Lanes, [&](size_t first, size_t last) {
+				detail::batch::determinantBlocks<T, Rows>(a, out, first, last);
+			});
+			result.resize(size_);
+			return result;
+		}
+
+		/// <summary>
+		/// Inverts every matrix in place
+		/// </summary>
+		/// <returns>How many of the matrices were singular, those are left with infinite or NaN elements</returns>
+		/// <remarks>Unlike Matrix::invert nothing is thrown, one bad matrix shouldn't stop the other million</remarks>
+		size_t invert() {
+			static_assert(Rows == Columns, "Only a square matrix has an inverse");
+			size_t blocks = blockCount(size_);
+			std::vector<unsigned char> singular(blocks * Lanes);
+			T* a = data();
+			unsigned char* flags = singular.data();
+			detail::batch::forBlocks(blocks, static_cast<size_t>(2) * Rows * Rows * Rows * Lanes, [&](size_t first, size_t last) {
+				detail::batch::invertBlocks<T, Rows>(a, flags, first, last);
+			});
+			size_t count = 0;
+			for (size_t i = 0; i < size_; i++)
+				count += singular[i];
+			return count;
+		}
+
+	private:
+		static size_t blockCount(size_t size) {
+			return (size + Lanes - 1) / Lanes;
+		}
+
+		static size_t offset(size_t index, int col, int row) {
+			return (index / Lanes * elementCount + static_cast<size_t>(row) * Columns + col) * Lanes + index % Lanes;
+		}
+
+		void checkRange(size_t index, int col, int row) const {
+			if (index >= size_ || col < 0 || row < 0 || col >= Columns || row >= Rows)
+				throw std::out_of_range("Index out of range");
+		}
+
+		void checkSameSize(size_t size) const {
+			if (size != size_)
+				throw std::invalid_argument("Matrix dimensions do not match");
+		}
+
+		std::vector<T, AlignedAllocator<T>> inner_;
+		size_t size_;
+	};
+}
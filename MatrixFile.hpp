@@ -0,0 +1,428 @@
+#pragma once
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "Matrix.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MATRICES_HAS_MMAP
+#endif
+
+namespace matrices {
+
+	/// <summary>
+	/// How the elements of a matrix file follow each other
+	/// </summary>
+	enum class FileLayout : std::uint8_t {
+		RowMajor = 0,    // what saveMatrix writes, the same as Matrix keeps in memory
+		ColumnMajor = 1  // written by column major code, loadMatrix transposes it
+	};
+
+	/// <summary>
+	/// What a mapped matrix is allowed to do with the file
+	/// </summary>
+	enum class Mapping {
+		ReadOnly,    // pages are shared with every process mapping the file, writing to the matrix crashes
+		CopyOnWrite  // the matrix can be written to, changed pages become private and never reach the file
+	};
+
+	/// <summary>
+	/// The first 64 bytes of a matrix file, the elements start at dataOffset
+	/// </summary>
+	struct FileHeader {
+		char magic[8];               // "MATRICES"
+		std::uint32_t version;
+		std::uint32_t byteOrder;     // ByteOrderMark as the writing machine stores it
+		std::uint8_t elementKind;    // 1 signed integer, 2 unsigned integer, 3 floating point
+		std::uint8_t elementSize;    // sizeof the element type
+		std::uint8_t layout;         // FileLayout
+		std::uint8_t reserved[5];
+		std::uint64_t columns;
+		std::uint64_t rows;
+		std::uint64_t dataOffset;    // from the start of the file, a multiple of alignment
+		std::uint64_t alignment;
+		std::uint8_t padding[8];
+
+		static constexpr char Magic[8] = { 'M', 'A', 'T', 'R', 'I', 'C', 'E', 'S' };
+		static constexpr std::uint32_t Version = 1;
+		static constexpr std::uint32_t ByteOrderMark = 0x01020304;
+		static constexpr std::uint64_t DataAlignment = 64;
+	};
+	static_assert(sizeof(FileHeader) == 64, "The file header has to stay 64 bytes");
+
+	namespace detail {
+		template<class T>
+		constexpr std::uint8_t elementKind() {
+			static_assert(std::is_arithmetic<T>::value, "Only arithmetic elements can be written to a file");
+			return std::is_floating_point<T>::value ? 3 : std::is_signed<T>::value ? 1 : 2;
+		}
+
+		template<class T>
+		FileHeader makeHeader(int columns, int rows) {
+			FileHeader header = {};
+			std::memcpy(header.magic, FileHeader::Magic, sizeof(header.magic));
+			header.version = FileHeader::Version;
+			header.byteOrder = FileHeader::ByteOrderMark;
+			header.elementKind = elementKind<T>();
+			header.elementSize = sizeof(T);
+			header.layout = static_cast<std::uint8_t>(FileLayout::RowMajor);
+			header.columns = static_cast<std::uint64_t>(columns);
+			header.rows = static_cast<std::uint64_t>(rows);
+			header.dataOffset = sizeof(FileHeader);
+			header.alignment = FileHeader::DataAlignment;
+			return header;
+		}
+
+		/// <summary>
+		/// Checks that a header describes a matrix of T that fits in a file of fileSize bytes
+		/// </summary>
+		template<class T>
+		void checkHeader(const FileHeader& header, std::uint64_t fileSize) {
+			if (std::memcmp(header.magic, FileHeader::Magic, sizeof(header.magic)) != 0 || header.version != FileHeader::Version)
+				throw std::invalid_argument("Not a matrix file");
+			if (header.byteOrder != FileHeader::ByteOrderMark)
+				throw std::invalid_argument("Matrix file was written with a different byte order");
+			if (header.elementKind != elementKind<T>() || header.elementSize != sizeof(T))
+				throw std::invalid_argument("Matrix file holds a different element type");
+			if (header.layout > static_cast<std::uint8_t>(FileLayout::ColumnMajor))
+				throw std::invalid_argument("Matrix file has an unknown layout");
+			if (header.columns > static_cast<std::uint64_t>(std::numeric_limits<int>::max())
+				|| header.rows > static_cast<std::uint64_t>(std::numeric_limits<int>::max()))
+				throw std::invalid_argument("Matrix file is too large");
+			// the alignment field is only what the writer claims, a mapped T* needs the offset aligned for T whatever it says
+			if (header.alignment == 0 || header.dataOffset % header.alignment != 0 || header.dataOffset % alignof(T) != 0
+				|| header.dataOffset < sizeof(FileHeader))
+				throw std::invalid_argument("Matrix file has a misaligned data offset");
+			if (header.dataOffset > fileSize)
+				throw std::invalid_argument("Matrix file is truncated");
+			// divided rather than multiplied, columns * rows * sizeof(T) can wrap around
+			std::uint64_t elements = (fileSize - header.dataOffset) / sizeof(T);
+			if (header.rows != 0 && header.columns > elements / header.rows)
+				throw std::invalid_argument("Matrix file is truncated");
+		}
+
+#ifdef MATRICES_HAS_MMAP
+		/// <summary>
+		/// Maps the whole of path into memory, it is unmapped when the last copy of the returned pointer goes
+		/// </summary>
+		/// <remarks>An empty file gives an empty pointer</remarks>
+		inline std::shared_ptr<void> mapFile(const std::string& path, Mapping mapping, size_t& size) {
+			int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+			if (fd < 0)
+				throw std::runtime_error("Could not open " + path);
+			struct stat status;
+			if (::fstat(fd, &status) != 0) {
+				::close(fd);
+				throw std::runtime_error("Could not open " + path);
+			}
+			size = static_cast<size_t>(status.st_size);
+			if (size == 0) {
+				::close(fd);
+				return nullptr;
+			}
+			void* base = ::mmap(nullptr, size,
+				mapping == Mapping::ReadOnly ? PROT_READ : PROT_READ | PROT_WRITE,
+				mapping == Mapping::ReadOnly ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+			::close(fd);
+			if (base == MAP_FAILED)
+				throw std::runtime_error("Could not map " + path);
+			size_t length = size;
+			return std::shared_ptr<void>(base, [length](void* pointer) { ::munmap(pointer, length); });
+		}
+#endif
+
+		/// <summary>
+		/// Characters that can sit between the elements of a row, brackets included so operator<< output reads back
+		/// </summary>
+		inline bool isSeparator(char c) {
+			return c == ' ' || c == '\t' || c == ',' || c == ';' || c == '(' || c == ')' || c == '\r';
+		}
+
+		inline const char* skipSeparators(const char* first, const char* last) {
+			while (first != last && isSeparator(*first))
+				first++;
+			return first;
+		}
+
+		inline const char* lineEnd(const char* first, const char* last) {
+			const char* end = static_cast<const char*>(std::memchr(first, '\n', static_cast<size_t>(last - first)));
+			return end ? end : last;
+		}
+
+		/// <summary>
+		/// Number of elements on the line [first, last)
+		/// </summary>
+		inline int countFields(const char* first, const char* last) {
+			int fields = 0;
+			for (first = skipSeparators(first, last); first != last; first = skipSeparators(first, last)) {
+				fields++;
+				while (first != last && !isSeparator(*first))
+					first++;
+			}
+			return fields;
+		}
+
+		/// <summary>
+		/// A run of whole lines parsed by one thread, rows are the lines that hold elements
+		/// </summary>
+		struct TextChunk {
+			const char* first;
+			const char* last;
+			size_t lines;
+			size_t rows;
+			size_t firstLine;
+			size_t firstRow;
+		};
+
+		/// <summary>
+		/// Cuts [first, last) at line breaks into pieces of at least a megabyte, a few per thread
+		/// </summary>
+		inline std::vector<TextChunk> splitText(const char* first, const char* last) {
+			constexpr size_t MinimumChunk = size_t(1) << 20;
+			size_t size = static_cast<size_t>(last - first);
+			size_t count = shouldParallelize(size) ? std::min<size_t>(threadPool().size() * 4, size / MinimumChunk + 1) : 1;
+			std::vector<TextChunk> chunks;
+			chunks.reserve(count);
+			const char* start = first;
+			for (size_t i = 1; i < count && first != last; i++) {
+				// cuts are measured from the start, an earlier chunk stretched over a long line can already be past this one
+				const char* cut = start + size * i / count;
+				if (cut <= first)
+					continue;
+				const char* end = lineEnd(cut, last);
+				if (end != last)
+					end++;
+				chunks.push_back({ first, end, 0, 0, 0, 0 });
+				first = end;
+			}
+			if (first != last)
+				chunks.push_back({ first, last, 0, 0, 0, 0 });
+			return chunks;
+		}
+
+		inline void countRows(TextChunk& chunk) {
+			for (const char* line = chunk.first; line != chunk.last; chunk.lines++) {
+				const char* end = lineEnd(line, chunk.last);
+				if (skipSeparators(line, end) != end)
+					chunk.rows++;
+				line = end == chunk.last ? end : end + 1;
+			}
+		}
+
+		template<class T>
+		const char* parseValue(const char* first, const char* last, T& value) {
+			if (first != last && *first == '+')
+				first++;
+			std::from_chars_result result;
+			if constexpr (std::is_same<T, bool>::value) {
+				int number = 0;
+				result = std::from_chars(first, last, number);
+				value = number != 0;
+			}
+			else {
+				result = std::from_chars(first, last, value);
+			}
+			if (result.ec != std::errc() || (result.ptr != last && !isSeparator(*result.ptr)))
+				return nullptr;
+			return result.ptr;
+		}
+
+		/// <summary>
+		/// Parses every row of the chunk into out, which has room for chunk.rows * columns elements
+		/// </summary>
+		template<class T>
+		void parseRows(const TextChunk& chunk, int columns, T* out) {
+			size_t lineNumber = chunk.firstLine;
+			for (const char* line = chunk.first; line != chunk.last; lineNumber++) {
+				const char* end = lineEnd(line, chunk.last);
+				const char* next = skipSeparators(line, end);
+				if (next != end) {
+					for (int col = 0; col < columns; col++, out++) {
+						if (next == end)
+							throw std::invalid_argument("Matrix rows have different lengths, line " + std::to_string(lineNumber));
+						next = parseValue(next, end, *out);
+						if (!next)
+							throw std::invalid_argument("Matrix text holds something that isn't a number, line " + std::to_string(lineNumber));
+						next = skipSeparators(next, end);
+					}
+					if (next != end)
+						throw std::invalid_argument("Matrix rows have different lengths, line " + std::to_string(lineNumber));
+				}
+				line = end == chunk.last ? end : end + 1;
+			}
+		}
+	}
+
+	/// <summary>
+	/// Writes the matrix to path as a 64 byte header followed by the raw elements, row after row
+	/// </summary>
+	/// <remarks>The file can be read back by loadMatrix or mapped by mapMatrix on a machine with the same byte order</remarks>
+	template<class T, class A>
+	void saveMatrix(const Matrix<T, A>& matrix, const std::string& path) {
+		FileHeader header = detail::makeHeader<T>(matrix.dimx_, matrix.dimy_);
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file)
+			throw std::runtime_error("Could not open " + path);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(matrix.inner_.data()), static_cast<std::streamsize>(matrix.inner_.size() * sizeof(T)));
+		if (!file.flush())
+			throw std::runtime_error("Could not write " + path);
+	}
+
+	/// <summary>
+	/// Reads a matrix file into a matrix that owns its elements, no text is parsed
+	/// </summary>
+	/// <remarks>Column major files are transposed on the way in. Throws std::invalid_argument if the file doesn't hold a matrix of T</remarks>
+	template<class T, class A = AlignedAllocator<T>>
+	Matrix<T, A> loadMatrix(const std::string& path, const A& allocator = A()) {
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file)
+			throw std::runtime_error("Could not open " + path);
+		std::uint64_t fileSize = static_cast<std::uint64_t>(file.tellg());
+		FileHeader header;
+		if (fileSize < sizeof(header))
+			throw std::invalid_argument("Not a matrix file");
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+		detail::checkHeader<T>(header, fileSize);
+
+		bool columnMajor = header.layout == static_cast<std::uint8_t>(FileLayout::ColumnMajor);
+		int columns = static_cast<int>(header.columns), rows = static_cast<int>(header.rows);
+		Matrix<T, A> result(columnMajor ? rows : columns, columnMajor ? columns : rows, allocator);
+		file.seekg(static_cast<std::streamoff>(header.dataOffset));
+		file.read(reinterpret_cast<char*>(result.inner_.data()), static_cast<std::streamsize>(result.inner_.size() * sizeof(T)));
+		if (!file)
+			throw std::runtime_error("Could not read " + path);
+		if (columnMajor)
+			result.transpose();
+		return result;
+	}
+
+	/// <summary>
+	/// A matrix over a mapped file
+	/// </summary>
+	template<class T>
+	using MappedMatrix = ExternalMatrix<T>;
+
+	/// <summary>
+	/// Maps a matrix file straight into memory, nothing is copied or parsed and pages are only read when they're touched
+	/// </summary>
+	/// <remarks>
+	/// Opening is the same speed whatever the size of the matrix, and read only mappings of the same file
+	/// share their pages between processes. The mapping stays alive until the matrix and everything
+	/// moved out of it are gone, copies of the matrix are ordinary matrices on the heap. Keep a read
+	/// only matrix const, writing to it crashes. Only row major files can be mapped. Where mmap isn't
+	/// available the file is read into memory instead
+	/// </remarks>
+	template<class T>
+	MappedMatrix<T> mapMatrix(const std::string& path, Mapping mapping = Mapping::ReadOnly) {
+#ifdef MATRICES_HAS_MMAP
+		size_t fileSize;
+		std::shared_ptr<void> owner = detail::mapFile(path, mapping, fileSize);
+		if (fileSize < sizeof(FileHeader))
+			throw std::invalid_argument("Not a matrix file");
+
+		const FileHeader& header = *static_cast<const FileHeader*>(owner.get());
+		detail::checkHeader<T>(header, fileSize);
+		if (header.layout != static_cast<std::uint8_t>(FileLayout::RowMajor))
+			throw std::invalid_argument("Only row major matrix files can be mapped");
+
+		size_t count = static_cast<size_t>(header.columns * header.rows);
+		T* data = reinterpret_cast<T*>(static_cast<char*>(owner.get()) + header.dataOffset);
+		return MappedMatrix<T>(static_cast<int>(header.columns), static_cast<int>(header.rows),
+			ExternalAllocator<T>(data, count, std::move(owner)));
+#else
+		(void)mapping;
+		return loadMatrix<T, ExternalAllocator<T>>(path);
+#endif
+	}
+
+	/// <summary>
+	/// Reads a matrix written as text, one row per line, the dimensions come from the text
+	/// </summary>
+	/// <remarks>
+	/// Elements can be separated by spaces, tabs, commas or semicolons and may be wrapped in brackets,
+	/// so CSV files and the output of operator<< both read back. Blank lines are skipped. Numbers are
+	/// read with std::from_chars straight into the matrix, large texts are split at line breaks and
+	/// parsed across the thread pool. Throws std::invalid_argument if an element isn't a number of T
+	/// or the rows have different lengths
+	/// </remarks>
+	template<class T, class A = AlignedAllocator<T>>
+	Matrix<T, A> parseMatrix(std::string_view text, const A& allocator = A()) {
+		const char* first = text.data();
+		const char* last = first + text.size();
+
+		// the first row decides the number of columns
+		const char* line = first;
+		size_t lineNumber = 1;
+		int columns = 0;
+		while (line != last) {
+			const char* end = detail::lineEnd(line, last);
+			columns = detail::countFields(line, end);
+			if (columns != 0)
+				break;
+			line = end == last ? last : end + 1;
+			lineNumber++;
+		}
+		if (columns == 0)
+			return Matrix<T, A>(0, 0, allocator);
+
+		// every chunk starts at the beginning of a line, the rows in it are counted first so all of them can be parsed in place at once
+		std::vector<detail::TextChunk> chunks = detail::splitText(line, last);
+		std::ptrdiff_t chunkCount = static_cast<std::ptrdiff_t>(chunks.size());
+		detail::parallelFor(0, chunkCount, 1, static_cast<size_t>(last - line), [&](std::ptrdiff_t begin, std::ptrdiff_t end) {
+			for (std::ptrdiff_t chunk = begin; chunk < end; chunk++)
+				detail::countRows(chunks[chunk]);
+		});
+		size_t rows = 0;
+		for (auto& chunk : chunks) {
+			chunk.firstRow = rows;
+			chunk.firstLine = lineNumber;
+			rows += chunk.rows;
+			lineNumber += chunk.lines;
+		}
+		if (rows > static_cast<size_t>(std::numeric_limits<int>::max()))
+			throw std::invalid_argument("Matrix text is too large");
+
+		Matrix<T, A> result(columns, static_cast<int>(rows), allocator);
+		T* data = result.inner_.data();
+		detail::parallelFor(0, chunkCount, 1, static_cast<size_t>(last - line), [&](std::ptrdiff_t begin, std::ptrdiff_t end) {
+			for (std::ptrdiff_t chunk = begin; chunk < end; chunk++)
+				detail::parseRows(chunks[chunk], columns, data + chunks[chunk].firstRow * columns);
+		});
+		return result;
+	}
+
+	/// <summary>
+	/// Reads a text or CSV file with parseMatrix, the file is mapped rather than copied into memory first
+	/// </summary>
+	template<class T, class A = AlignedAllocator<T>>
+	Matrix<T, A> loadTextMatrix(const std::string& path, const A& allocator = A()) {
+#ifdef MATRICES_HAS_MMAP
+		size_t fileSize;
+		std::shared_ptr<void> owner = detail::mapFile(path, Mapping::ReadOnly, fileSize);
+		return parseMatrix<T, A>(std::string_view(static_cast<const char*>(owner.get()), fileSize), allocator);
+#else
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+			throw std::runtime_error("Could not open " + path);
+		std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		return parseMatrix<T, A>(text, allocator);
+#endif
+	}
+}
@@ -0,0 +1,244 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "Expression.hpp"
+#include "TextFormat.hpp"
+
+namespace matrices {
+
+	/// <summary>
+	/// Non owning window onto the elements of another matrix, a row, a column, a block or a diagonal
+	/// </summary>
+	/// <remarks>
+	/// A view is a pointer to its first element and the distance between neighbouring rows and columns,
+	/// so making one costs nothing and writing through it changes the parent straight away. It can be
+	/// used anywhere a matrix expression can. Assigning an expression to a view writes element by
+	/// element, so the expression must not read elements of the view at other positions, e.g. two
+	/// overlapping blocks of the same matrix. A view must not outlive the matrix it looks at, and
+	/// resizing that matrix invalidates it. MatrixView<const T> (ConstMatrixView<T>) is read only
+	/// </remarks>
+	template<class T>
+	class MatrixView : public MatrixExpression<MatrixView<T>> {
+	public:
+		using value_type = typename std::remove_const<T>::type;
+		using pointer = T*;
+		using reference = T&;
+		static constexpr bool isExpressionLeaf = false;
+
+		/// <summary>
+		/// Creates a view of columns x rows elements
+		/// </summary>
+		/// <param name="data">The element at column 0, row 0 of the view</param>
+		/// <param name="rowStride">Distance in elements between two rows</param>
+		/// <param name="columnStride">Distance in elements between two columns</param>
+		MatrixView(T* data, int columns, int rows, std::ptrdiff_t rowStride, std::ptrdiff_t columnStride)
+			: data_(data), columns_(columns), rows_(rows), rowStride_(rowStride), columnStride_(columnStride) {}
+
+		/// <summary>
+		/// A writable view can always be read only
+		/// </summary>
+		template<class U, typename std::enable_if<std::is_same<const U, T>::value && !std::is_same<U, T>::value, int>::type = 0>
+		MatrixView(const MatrixView<U>& other)
+			: MatrixView(other.data(), other.columns(), other.rows(), other.rowStride(), other.columnStride()) {}
+
+		MatrixView(const MatrixView&) = default;
+
+		/// <summary>
+		/// Copies the elements of another view into the elements of this one, it doesn't rebind the view
+		/// </summary>
+		MatrixView& operator=(const MatrixView& other) {
+			return assign(other);
+		}
+
+		/// <summary>
+		/// Evaluates an expression straight into the parent matrix
+		/// </summary>
+		/// <remarks>Throws std::invalid_argument if the shapes differ</remarks>
+		template<class E>
+		MatrixView& operator=(const MatrixExpression<E>& expression) {
+			return assign(expression.self());
+		}
+
+		template<class E>
+		MatrixView& operator+=(const MatrixExpression<E>& expression) {
+			return assign(*this + expression.self());
+		}
+
+		template<class E>
+		MatrixView& operator-=(const MatrixExpression<E>& expression) {
+			return assign(*this - expression.self());
+		}
+
+		template<class S, typename std::enable_if<std::is_arithmetic<S>::value, int>::type = 0>
+		MatrixView& operator*=(S scalar) {
+			return assign(*this * scalar);
+		}
+
+		int columns() const { return columns_; }
+		int rows() const { return rows_; }
+		std::ptrdiff_t rowStride() const { return rowStride_; }
+		std::ptrdiff_t columnStride() const { return columnStride_; }
+		T* data() const { return data_; }
+
+		/// <summary>
+		/// Unchecked access to the element at col, row, used when the view is part of an expression
+		/// </summary>
+		T& elementAt(int col, int row) const {
+			return data_[row * rowStride_ + col * columnStride_];
+		}
+
+		/// <summary>
+		/// Returns a value at the specified position within the view
+		/// </summary>
+		/// <remarks>Will throw an error if out of range</remarks>
+		T& getAt(int col, int row) const {
+			if (col >= columns_ || row >= rows_ || col < 0 || row < 0)
+				throw std::out_of_range("Index out of range");
+			return elementAt(col, row);
+		}
+
+		/// <summary>
+		/// Element index of a single row or column, so Matrix[col][row] works through a column view
+		/// </summary>
+		T& operator[](int index) const {
+			return columns_ == 1 ? data_[index * rowStride_] : data_[index * columnStride_];
+		}
+
+		/// <summary>
+		/// Fills every element of the view with the passed object
+		/// </summary>
+		void fill(const value_type& objToFill) const {
+			for (int row = 0; row < rows_; row++)
+				for (int col = 0; col < columns_; col++)
+					elementAt(col, row) = objToFill;
+		}
+
+		/// <summary>
+		/// View of a single row of this view
+		/// </summary>
+		MatrixView row(int row) const {
+			if (row < 0 || row >= rows_)
+				throw std::out_of_range("Index out of range");
+			return MatrixView(data_ + row * rowStride_, columns_, 1, rowStride_, columnStride_);
+		}
+
+		/// <summary>
+		/// View of a single column of this view
+		/// </summary>
+		MatrixView column(int column) const {
+			if (column < 0 || column >= columns_)
+				throw std::out_of_range("Index out of range");
+			return MatrixView(data_ + column * columnStride_, 1, rows_, rowStride_, columnStride_);
+		}
+
+		/// <summary>
+		/// View of columns x rows elements starting at col, row
+		/// </summary>
+		MatrixView block(int col, int row, int columns, int rows) const {
+			if (col < 0 || row < 0 || columns < 0 || rows < 0 || col + columns > columns_ || row + rows > rows_)
+				throw std::out_of_range("Index out of range");
+			return MatrixView(data_ + row * rowStride_ + col * columnStride_, columns, rows, rowStride_, columnStride_);
+		}
+
+		/// <summary>
+		/// The same elements with rows and columns swapped, nothing is moved
+		/// </summary>
+		MatrixView transposed() const {
+			return MatrixView(data_, rows_, columns_, columnStride_, rowStride_);
+		}
+
+		/// <summary>
+		/// The main diagonal as a single column
+		/// </summary>
+		MatrixView diagonal() const {
+			return MatrixView(data_, 1, columns_ < rows_ ? columns_ : rows_, rowStride_ + columnStride_, columnStride_);
+		}
+
+		/// <summary>
+		/// Writes the viewed elements in the same format as Matrix
+		/// </summary>
+		std::string toString(const TextFormat& format = TextFormat()) const {
+			return detail::toText(data_, columns_, rows_, rowStride_, columnStride_, format);
+		}
+
+		void print(std::ostream& os, const TextFormat& format = TextFormat()) const {
+			detail::writeText(os, data_, columns_, rows_, rowStride_, columnStride_, format);
+		}
+
+		friend std::ostream& operator<<(std::ostream& os, const MatrixView& view) {
+			view.print(os);
+			return os;
+		}
+
+	private:
+		template<class E>
+		MatrixView& assign(const E& e) {
+			static_assert(!std::is_const<T>::value, "Can't write through a read only view");
+			detail::checkSameShape(*this, e);
+			for (int row = 0; row < rows_; row++) {
+				T* dst = data_ + row * rowStride_;
+				for (int col = 0; col < columns_; col++)
+					dst[col * columnStride_] = static_cast<value_type>(e.elementAt(col, row));
+			}
+			return *this;
+		}
+
+		T* data_;
+		int columns_, rows_;
+		std::ptrdiff_t rowStride_, columnStride_;
+	};
+
+	/// <summary>
+	/// Read only view onto the elements of another matrix
+	/// </summary>
+	template<class T>
+	using ConstMatrixView = MatrixView<const T>;
+
+	namespace detail {
+
+		template<class L, class R, class Op, class T>
+		bool readsElsewhere(const BinaryExpression<L, R, Op>& e, const T* data, int columns, size_t count);
+
+		template<class E, class S, class T>
+		bool readsElsewhere(const ScalarExpression<E, S>& e, const T* data, int columns, size_t count);
+
+		/// <summary>
+		/// Whether writing e element by element into the row major columns wide buffer of count elements
+		/// at data could overwrite an element e still has to read, because e looks at the buffer through
+		/// a view at other positions, e.g. its transpose or a shifted block
+		/// </summary>
+		/// <remarks>Matrices and other leaves hold their own elements, so they only ever read their own position</remarks>
+		template<class E, class T>
+		bool readsElsewhere(const E&, const T*, int, size_t) {
+			return false;
+		}
+
+		template<class U, class T>
+		bool readsElsewhere(const MatrixView<U>& view, const T* data, int columns, size_t count) {
+			if (!std::is_same<typename std::remove_const<U>::type, T>::value || count == 0 || view.columns() == 0 || view.rows() == 0)
+				return false;
+			const T* first = reinterpret_cast<const T*>(view.data());
+			const T* last = first + (view.rows() - 1) * view.rowStride() + (view.columns() - 1) * view.columnStride();
+			std::less<const T*> before;
+			if (before(last, data) || before(data + (count - 1), first))
+				return false;
+			// a view of the whole buffer in its own layout reads every element where it is written
+			return !(first == data && view.rowStride() == columns && view.columnStride() == 1);
+		}
+
+		template<class L, class R, class Op, class T>
+		bool readsElsewhere(const BinaryExpression<L, R, Op>& e, const T* data, int columns, size_t count) {
+			return readsElsewhere(e.left(), data, columns, count) || readsElsewhere(e.right(), data, columns, count);
+		}
+
+		template<class E, class S, class T>
+		bool readsElsewhere(const ScalarExpression<E, S>& e, const T* data, int columns, size_t count) {
+			return readsElsewhere(e.expression(), data, columns, count);
+		}
+	}
+}
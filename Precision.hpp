@@ -0,0 +1,137 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+namespace matrices {
+
+	/// <summary>
+	/// 16 bit brain float, the top half of a float, so it has float's range with 8 bits of precision
+	/// </summary>
+	/// <remarks>
+	/// Only a storage type, anything done with it happens in float and is rounded back to the nearest
+	/// even bfloat16 when it's stored. Matrices of it take half the memory of float
+	/// </remarks>
+	struct bfloat16 {
+		bfloat16() = default;
+
+		bfloat16(float value) {
+			std::uint32_t u;
+			std::memcpy(&u, &value, sizeof(u));
+			if ((u & 0x7fffffffu) > 0x7f800000u)
+				bits = static_cast<std::uint16_t>((u >> 16) | 0x40u); // keep NaNs quiet
+			else
+				bits = static_cast<std::uint16_t>((u + 0x7fffu + ((u >> 16) & 1u)) >> 16);
+		}
+
+		operator float() const {
+			std::uint32_t u = static_cast<std::uint32_t>(bits) << 16;
+			float value;
+			std::memcpy(&value, &u, sizeof(value));
+			return value;
+		}
+
+		template<class S> bfloat16& operator+=(const S& arg) { return *this = static_cast<float>(*this) + arg; }
+		template<class S> bfloat16& operator-=(const S& arg) { return *this = static_cast<float>(*this) - arg; }
+		template<class S> bfloat16& operator*=(const S& arg) { return *this = static_cast<float>(*this) * arg; }
+		template<class S> bfloat16& operator/=(const S& arg) { return *this = static_cast<float>(*this) / arg; }
+
+		std::uint16_t bits;
+	};
+
+	/// <summary>
+	/// IEEE 754 half precision, 11 bits of precision but nothing bigger than 65504
+	/// </summary>
+	/// <remarks>Like bfloat16 it's only stored, conversions use F16C when the compiler is allowed to</remarks>
+	struct half {
+		half() = default;
+
+		half(float value) {
+#if defined(__F16C__)
+			bits = static_cast<std::uint16_t>(_cvtss_sh(value, 0));
+#else
+			std::uint32_t u;
+			std::memcpy(&u, &value, sizeof(u));
+			std::uint32_t sign = (u >> 16) & 0x8000u;
+			u &= 0x7fffffffu;
+			if (u >= 0x47800000u) {
+				// too big for a half, or already infinite or NaN
+				bits = static_cast<std::uint16_t>(sign | (u > 0x7f800000u ? 0x7e00u : 0x7c00u));
+			}
+			else if (u < 0x38800000u) {
+				// subnormal, adding the magic number lets the FPU do the rounding
+				const std::uint32_t magic = 0x3f000000u;
+				float f, m;
+				std::memcpy(&f, &u, sizeof(f));
+				std::memcpy(&m, &magic, sizeof(m));
+				f += m;
+				std::memcpy(&u, &f, sizeof(u));
+				bits = static_cast<std::uint16_t>(sign | (u - magic));
+			}
+			else {
+				u += 0xc8000fffu + ((u >> 13) & 1u);
+				bits = static_cast<std::uint16_t>(sign | (u >> 13));
+			}
+#endif
+		}
+
+		operator float() const {
+#if defined(__F16C__)
+			return _cvtsh_ss(bits);
+#else
+			std::uint32_t u = (static_cast<std::uint32_t>(bits) & 0x7fffu) << 13;
+			std::uint32_t exponent = u & 0x0f800000u;
+			u += 0x38000000u;
+			float value;
+			if (exponent == 0x0f800000u) {
+				u += 0x38000000u; // infinity or NaN
+				std::memcpy(&value, &u, sizeof(value));
+			}
+			else if (exponent == 0) {
+				u += 0x00800000u; // zero or subnormal
+				std::memcpy(&value, &u, sizeof(value));
+				value -= 6.103515625e-05f;
+			}
+			else {
+				std::memcpy(&value, &u, sizeof(value));
+			}
+			return (bits & 0x8000u) ? -value : value;
+#endif
+		}
+
+		template<class S> half& operator+=(const S& arg) { return *this = static_cast<float>(*this) + arg; }
+		template<class S> half& operator-=(const S& arg) { return *this = static_cast<float>(*this) - arg; }
+		template<class S> half& operator*=(const S& arg) { return *this = static_cast<float>(*this) * arg; }
+		template<class S> half& operator/=(const S& arg) { return *this = static_cast<float>(*this) / arg; }
+
+		std::uint16_t bits;
+	};
+
+	namespace detail {
+
+		/// <summary>
+		/// Whether T is one of the 16 bit floating point storage types
+		/// </summary>
+		template<class T>
+		struct IsReducedFloat : std::integral_constant<bool,
+			std::is_same<T, bfloat16>::value || std::is_same<T, half>::value> {};
+
+		/// <summary>
+		/// The type sums of products of T are kept in, float for the 16 bit floats and int32 for 8 and 16 bit integers
+		/// </summary>
+		/// <remarks>Anything else accumulates in its own type, a float matrix can still ask for double explicitly</remarks>
+		template<class T>
+		struct Accumulator {
+			using type = typename std::conditional<IsReducedFloat<T>::value, float,
+				typename std::conditional<std::is_integral<T>::value && sizeof(T) < sizeof(std::int32_t) && !std::is_same<T, bool>::value,
+					std::int32_t, T>::type>::type;
+		};
+
+		template<class T>
+		using AccumulatorType = typename Accumulator<T>::type;
+	}
+}
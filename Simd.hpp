@@ -0,0 +1,630 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MATRICES_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and clang need every function that uses wider instructions than the translation unit was
+// compiled for to be tagged with a target, MSVC allows the intrinsics anywhere
+#if defined(_MSC_VER) && !defined(__clang__)
+#define MATRICES_TARGET(isa)
+#define MATRICES_INLINE __forceinline
+#else
+#define MATRICES_TARGET(isa) __attribute__((target(isa)))
+#define MATRICES_INLINE inline __attribute__((always_inline))
+#endif
+
+namespace matrices {
+	namespace detail {
+		namespace simd {
+
+			/// <summary>
+			/// Instruction sets the element-wise kernels are compiled for, in increasing order
+			/// </summary>
+			enum class Level { Scalar, SSE2, AVX2, AVX512 };
+
+			/// <summary>
+			/// Asks the CPU (and on MSVC the OS) which instruction sets are usable
+			/// </summary>
+			/// <returns>The widest level that has kernels</returns>
+			inline Level detectLevel() {
+#if defined(MATRICES_X86) && defined(_MSC_VER) && !defined(__clang__)
+				int info[4];
+				__cpuid(info, 0);
+				int maxLeaf = info[0];
+				__cpuid(info, 1);
+				bool sse2 = (info[3] & (1 << 26)) != 0;
+				bool osxsave = (info[2] & (1 << 27)) != 0;
+				bool fma = (info[2] & (1 << 12)) != 0;
+				unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+				bool avx2 = false, avx512 = false;
+				if (maxLeaf >= 7) {
+					__cpuidex(info, 7, 0);
+					avx2 = fma && (info[1] & (1 << 5)) != 0 && (xcr0 & 0x6) == 0x6;
+					avx512 = avx2 && (info[1] & (1 << 16)) != 0 && (info[1] & (1 << 17)) != 0 && (xcr0 & 0xe6) == 0xe6;
+				}
+				if (avx512) return Level::AVX512;
+				if (avx2) return Level::AVX2;
+				if (sse2) return Level::SSE2;
+				return Level::Scalar;
+#elif defined(MATRICES_X86)
+				__builtin_cpu_init();
+				if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq"))
+					return Level::AVX512;
+				if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+					return Level::AVX2;
+				if (__builtin_cpu_supports("sse2"))
+					return Level::SSE2;
+				return Level::Scalar;
+#else
+				return Level::Scalar;
+#endif
+			}
+
+			/// <summary>
+			/// The instruction set picked for this process, detected the first time it is asked for
+			/// </summary>
+			inline Level level() {
+				static const Level detected = detectLevel();
+				return detected;
+			}
+
+			/// <summary>
+			/// Function table of the element-wise kernels for one element type
+			/// </summary>
+			/// <remarks>scale, sumSquares, dot and axpy are only vectorised for float and double</remarks>
+			template<class T>
+			struct Kernels {
+				void (*add)(const T* a, const T* b, T* out, size_t n);
+				void (*sub)(const T* a, const T* b, T* out, size_t n);
+				void (*scale)(const T* a, T factor, T* out, size_t n);
+				void (*fill)(T* out, T value, size_t n);
+				double (*sumSquares)(const T* a, size_t n);
+				T (*dot)(const T* a, const T* b, size_t n);
+				void (*axpy)(T alpha, const T* x, T* y, size_t n);
+			};
+
+			// portable fallbacks, also used for the tails of the vector loops
+
+			template<class T>
+			void addScalar(const T* a, const T* b, T* out, size_t n) {
+				for (size_t i = 0; i < n; i++)
+					out[i] = a[i] + b[i];
+			}
+
+			template<class T>
+			void subScalar(const T* a, const T* b, T* out, size_t n) {
+				for (size_t i = 0; i < n; i++)
+					out[i] = a[i] - b[i];
+			}
+
+			template<class T>
+			void scaleScalar(const T* a, T factor, T* out, size_t n) {
+				for (size_t i = 0; i < n; i++)
+					out[i] = a[i] * factor;
+			}
+
+			template<class T>
+			void fillScalar(T* out, T value, size_t n) {
+				for (size_t i = 0; i < n; i++)
+					out[i] = value;
+			}
+
+			template<class T>
+			double sumSquaresScalar(const T* a, size_t n) {
+				double sum = 0.0;
+				for (size_t i = 0; i < n; i++)
+					sum += static_cast<double>(a[i]) * static_cast<double>(a[i]);
+				return sum;
+			}
+
+			template<class T>
+			T dotScalar(const T* a, const T* b, size_t n) {
+				T sum = T();
+				for (size_t i = 0; i < n; i++)
+					sum += a[i] * b[i];
+				return sum;
+			}
+
+			template<class T>
+			void axpyScalar(T alpha, const T* x, T* y, size_t n) {
+				for (size_t i = 0; i < n; i++)
+					y[i] += alpha * x[i];
+			}
+
+#ifdef MATRICES_X86
+
+// Stamps out the vector kernels for one instruction set. Vec<T> has to be declared in the
+// enclosing namespace and supply load, store, set1, add, sub, mul and for the floating point
+// types fmadd and an accumulator for the sum of squares
+#define MATRICES_SIMD_KERNELS(isa)                                                         \
+			template<class T>                                                                  \
+			MATRICES_TARGET(isa) void add(const T* a, const T* b, T* out, size_t n) {          \
+				using V = Vec<T>;                                                              \
+				size_t i = 0;                                                                  \
+				for (; i + 2 * V::width <= n; i += 2 * V::width) {                             \
+					auto x0 = V::add(V::load(a + i), V::load(b + i));                          \
+					auto x1 = V::add(V::load(a + i + V::width), V::load(b + i + V::width));    \
+					V::store(out + i, x0);                                                     \
+					V::store(out + i + V::width, x1);                                          \
+				}                                                                              \
+				for (; i + V::width <= n; i += V::width)                                       \
+					V::store(out + i, V::add(V::load(a + i), V::load(b + i)));                 \
+				addScalar(a + i, b + i, out + i, n - i);                                       \
+			}                                                                                  \
+                                                                                               \
+			template<class T>                                                                  \
+			MATRICES_TARGET(isa) void sub(const T* a, const T* b, T* out, size_t n) {          \
+				using V = Vec<T>;                                                              \
+				size_t i = 0;                                                                  \
+				for (; i + 2 * V::width <= n; i += 2 * V::width) {                             \
+					auto x0 = V::sub(V::load(a + i), V::load(b + i));                          \
+					auto x1 = V::sub(V::load(a + i + V::width), V::load(b + i + V::width));    \
+					V::store(out + i, x0);                                                     \
+					V::store(out + i + V::width, x1);                                          \
+				}                                                                              \
+				for (; i + V::width <= n; i += V::width)                                       \
+					V::store(out + i, V::sub(V::load(a + i), V::load(b + i)));                 \
+				subScalar(a + i, b + i, out + i, n - i);                                       \
+			}                                                                                  \
+                                                                                               \
+			template<class T>                                                                  \
+			MATRICES_TARGET(isa) void scale(const T* a, T factor, T* out, size_t n) {          \
+				using V = Vec<T>;                                                              \
+				auto f = V::set1(factor);                                                      \
+				size_t i = 0;                                                                  \
+				for (; i + V::width <= n; i += V::width)                                       \
+					V::store(out + i, V::mul(V::load(a + i), f));                              \
+				scaleScalar(a + i, factor, out + i, n - i);                                    \
+			}                                                                                  \
+                                                                                               \
+			template<class T>                                                                  \
+			MATRICES_TARGET(isa) void fill(T* out, T value, size_t n) {                        \
+				using V = Vec<T>;                                                              \
+				auto v = V::set1(value);                                                       \
+				size_t i = 0;                                                                  \
+				for (; i + V::width <= n; i += V::width)                                       \
+					V::store(out + i, v);                                                      \
+				fillScalar(out + i, value, n - i);                                             \
+			}                                                                                  \
+                                                                                               \
+			template<class T>                                                                  \
+			MATRICES_TARGET(isa) double sumSquares(const T* a, size_t n) {                     \
+				using V = Vec<T>;                                                              \
+				typename V::Acc acc0 = V::zeroAcc(), acc1 = V::zeroAcc();                      \
+				size_t i = 0;                                                                  \
+				for (; i + 2 * V::width <= n; i += 2 * V::width) {                             \
+					V::addSquares(acc0, V::load(a + i));                                       \
+					V::addSquares(acc1, V::load(a + i + V::width));                            \
+				}                                                                              \
+				for (; i + V::width <= n; i += V::width)                                       \
+					V::addSquares(acc0, V::load(a + i));                                       \
+				return V::reduce(acc0) + V::reduce(acc1) + sumSquaresScalar(a + i, n - i);     \
+			}                                                                                  \
+                                                                                               \
+			template<class T>                                                                  \
+			MATRICES_TARGET(isa) T dot(const T* a, const T* b, size_t n) {                     \
+				using V = Vec<T>;                                                              \
+				constexpr size_t w = V::width;                                                 \
+				auto acc0 = V::set1(T()), acc1 = acc0, acc2 = acc0, acc3 = acc0;               \
+				size_t i = 0;                                                                  \
+				for (; i + 4 * w <= n; i += 4 * w) {                                           \
+					acc0 = V::fmadd(V::load(a + i), V::load(b + i), acc0);                     \
+					acc1 = V::fmadd(V::load(a + i + w), V::load(b + i + w), acc1);             \
+					acc2 = V::fmadd(V::load(a + i + 2 * w), V::load(b + i + 2 * w), acc2);     \
+					acc3 = V::fmadd(V::load(a + i + 3 * w), V::load(b + i + 3 * w), acc3);     \
+				}                                                                              \
+				for (; i + w <= n; i += w)                                                     \
+					acc0 = V::fmadd(V::load(a + i), V::load(b + i), acc0);                     \
+				T lanes[w];                                                                    \
+				V::store(lanes, V::add(V::add(acc0, acc1), V::add(acc2, acc3)));               \
+				T sum = dotScalar(a + i, b + i, n - i);                                        \
+				for (size_t lane = 0; lane < w; lane++)                                        \
+					sum += lanes[lane];                                                        \
+				return sum;                                                                    \
+			}                                                                                  \
+                                                                                               \
+			template<class T>                                                                  \
+			MATRICES_TARGET(isa) void axpy(T alpha, const T* x, T* y, size_t n) {              \
+				using V = Vec<T>;                                                              \
+				constexpr size_t w = V::width;                                                 \
+				auto f = V::set1(alpha);                                                       \
+				size_t i = 0;                                                                  \
+				for (; i + 2 * w <= n; i += 2 * w) {                                           \
+					auto y0 = V::fmadd(f, V::load(x + i), V::load(y + i));                     \
+					auto y1 = V::fmadd(f, V::load(x + i + w), V::load(y + i + w));             \
+					V::store(y + i, y0);                                                       \
+					V::store(y + i + w, y1);                                                   \
+				}                                                                              \
+				for (; i + w <= n; i += w)                                                     \
+					V::store(y + i, V::fmadd(f, V::load(x + i), V::load(y + i)));              \
+				axpyScalar(alpha, x + i, y + i, n - i);                                        \
+			}
+
+			namespace sse2 {
+				template<class T>
+				struct Vec;
+
+				template<>
+				struct Vec<double> {
+					using Reg = __m128d;
+					using Mask = __m128d;
+					using Acc = __m128d;
+					static constexpr size_t width = 2;
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Reg load(const double* p) { return _mm_loadu_pd(p); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE void store(double* p, Reg x) { _mm_storeu_pd(p, x); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Reg set1(double v) { return _mm_set1_pd(v); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Reg add(Reg x, Reg y) { return _mm_add_pd(x, y); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Reg sub(Reg x, Reg y) { return _mm_sub_pd(x, y); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Reg mul(Reg x, Reg y) { return _mm_mul_pd(x, y); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Reg div(Reg x, Reg y) { return _mm_div_pd(x, y); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Reg fmadd(Reg x, Reg y, Reg acc) { return _mm_add_pd(acc, _mm_mul_pd(x, y)); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Reg fnmadd(Reg x, Reg y, Reg acc) { return _mm_sub_pd(acc, _mm_mul_pd(x, y)); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Reg abs(Reg x) { return _mm_andnot_pd(_mm_set1_pd(-0.0), x); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Mask greater(Reg x, Reg y) { return _mm_cmpgt_pd(x, y); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Mask equal(Reg x, Reg y) { return _mm_cmpeq_pd(x, y); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Reg select(Mask m, Reg x, Reg y) { return _mm_or_pd(_mm_and_pd(m, x), _mm_andnot_pd(m, y)); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Acc zeroAcc() { return _mm_setzero_pd(); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE void addSquares(Acc& acc, Reg x) { acc = _mm_add_pd(acc, _mm_mul_pd(x, x)); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE double reduce(Acc acc) {
+						return _mm_cvtsd_f64(_mm_add_sd(acc, _mm_unpackhi_pd(acc, acc)));
+					}
+				};
+
+				template<>
+				struct Vec<float> {
+					using Reg = __m128;
+					using Mask = __m128;
+					struct Acc { __m128d lo, hi; };
+					static constexpr size_t width = 4;
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Reg load(const float* p) { return _mm_loadu_ps(p); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE void store(float* p, Reg x) { _mm_storeu_ps(p, x); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Reg set1(float v) { return _mm_set1_ps(v); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Reg add(Reg x, Reg y) { return _mm_add_ps(x, y); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Reg sub(Reg x, Reg y) { return _mm_sub_ps(x, y); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Reg mul(Reg x, Reg y) { return _mm_mul_ps(x, y); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Reg div(Reg x, Reg y) { return _mm_div_ps(x, y); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Reg fmadd(Reg x, Reg y, Reg acc) { return _mm_add_ps(acc, _mm_mul_ps(x, y)); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Reg fnmadd(Reg x, Reg y, Reg acc) { return _mm_sub_ps(acc, _mm_mul_ps(x, y)); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Reg abs(Reg x) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), x); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Mask greater(Reg x, Reg y) { return _mm_cmpgt_ps(x, y); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Mask equal(Reg x, Reg y) { return _mm_cmpeq_ps(x, y); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Reg select(Mask m, Reg x, Reg y) { return _mm_or_ps(_mm_and_ps(m, x), _mm_andnot_ps(m, y)); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Acc zeroAcc() { return { _mm_setzero_pd(), _mm_setzero_pd() }; }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE void addSquares(Acc& acc, Reg x) {
+						__m128d lo = _mm_cvtps_pd(x);
+						__m128d hi = _mm_cvtps_pd(_mm_movehl_ps(x, x));
+						acc.lo = _mm_add_pd(acc.lo, _mm_mul_pd(lo, lo));
+						acc.hi = _mm_add_pd(acc.hi, _mm_mul_pd(hi, hi));
+					}
+					MATRICES_TARGET("sse2") static MATRICES_INLINE double reduce(Acc acc) {
+						return Vec<double>::reduce(_mm_add_pd(acc.lo, acc.hi));
+					}
+				};
+
+				template<>
+				struct Vec<std::int32_t> {
+					using Reg = __m128i;
+					static constexpr size_t width = 4;
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Reg load(const std::int32_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE void store(std::int32_t* p, Reg x) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), x); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Reg set1(std::int32_t v) { return _mm_set1_epi32(v); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Reg add(Reg x, Reg y) { return _mm_add_epi32(x, y); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Reg sub(Reg x, Reg y) { return _mm_sub_epi32(x, y); }
+				};
+
+				template<>
+				struct Vec<std::int64_t> {
+					using Reg = __m128i;
+					static constexpr size_t width = 2;
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Reg load(const std::int64_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE void store(std::int64_t* p, Reg x) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), x); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Reg set1(std::int64_t v) { return _mm_set1_epi64x(v); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Reg add(Reg x, Reg y) { return _mm_add_epi64(x, y); }
+					MATRICES_TARGET("sse2") static MATRICES_INLINE Reg sub(Reg x, Reg y) { return _mm_sub_epi64(x, y); }
+				};
+
+				MATRICES_SIMD_KERNELS("sse2")
+			}
+
+			namespace avx2 {
+				template<class T>
+				struct Vec;
+
+				template<>
+				struct Vec<double> {
+					using Reg = __m256d;
+					using Mask = __m256d;
+					using Acc = __m256d;
+					static constexpr size_t width = 4;
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Reg load(const double* p) { return _mm256_loadu_pd(p); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE void store(double* p, Reg x) { _mm256_storeu_pd(p, x); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Reg set1(double v) { return _mm256_set1_pd(v); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Reg add(Reg x, Reg y) { return _mm256_add_pd(x, y); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Reg sub(Reg x, Reg y) { return _mm256_sub_pd(x, y); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Reg mul(Reg x, Reg y) { return _mm256_mul_pd(x, y); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Reg div(Reg x, Reg y) { return _mm256_div_pd(x, y); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Reg fmadd(Reg x, Reg y, Reg acc) { return _mm256_fmadd_pd(x, y, acc); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Reg fnmadd(Reg x, Reg y, Reg acc) { return _mm256_fnmadd_pd(x, y, acc); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Reg abs(Reg x) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), x); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Mask greater(Reg x, Reg y) { return _mm256_cmp_pd(x, y, _CMP_GT_OQ); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Mask equal(Reg x, Reg y) { return _mm256_cmp_pd(x, y, _CMP_EQ_OQ); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Reg select(Mask m, Reg x, Reg y) { return _mm256_blendv_pd(y, x, m); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Acc zeroAcc() { return _mm256_setzero_pd(); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE void addSquares(Acc& acc, Reg x) { acc = _mm256_fmadd_pd(x, x, acc); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE double reduce(Acc acc) {
+						__m128d sum = _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+						return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+					}
+				};
+
+				template<>
+				struct Vec<float> {
+					using Reg = __m256;
+					using Mask = __m256;
+					struct Acc { __m256d lo, hi; };
+					static constexpr size_t width = 8;
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Reg load(const float* p) { return _mm256_loadu_ps(p); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE void store(float* p, Reg x) { _mm256_storeu_ps(p, x); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Reg set1(float v) { return _mm256_set1_ps(v); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Reg add(Reg x, Reg y) { return _mm256_add_ps(x, y); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Reg sub(Reg x, Reg y) { return _mm256_sub_ps(x, y); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Reg mul(Reg x, Reg y) { return _mm256_mul_ps(x, y); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Reg div(Reg x, Reg y) { return _mm256_div_ps(x, y); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Reg fmadd(Reg x, Reg y, Reg acc) { return _mm256_fmadd_ps(x, y, acc); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Reg fnmadd(Reg x, Reg y, Reg acc) { return _mm256_fnmadd_ps(x, y, acc); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Reg abs(Reg x) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Mask greater(Reg x, Reg y) { return _mm256_cmp_ps(x, y, _CMP_GT_OQ); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Mask equal(Reg x, Reg y) { return _mm256_cmp_ps(x, y, _CMP_EQ_OQ); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Reg select(Mask m, Reg x, Reg y) { return _mm256_blendv_ps(y, x, m); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Acc zeroAcc() { return { _mm256_setzero_pd(), _mm256_setzero_pd() }; }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE void addSquares(Acc& acc, Reg x) {
+						__m256d lo = _mm256_cvtps_pd(_mm256_castps256_ps128(x));
+						__m256d hi = _mm256_cvtps_pd(_mm256_extractf128_ps(x, 1));
+						acc.lo = _mm256_fmadd_pd(lo, lo, acc.lo);
+						acc.hi = _mm256_fmadd_pd(hi, hi, acc.hi);
+					}
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE double reduce(Acc acc) {
+						return Vec<double>::reduce(_mm256_add_pd(acc.lo, acc.hi));
+					}
+				};
+
+				template<>
+				struct Vec<std::int32_t> {
+					using Reg = __m256i;
+					static constexpr size_t width = 8;
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Reg load(const std::int32_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE void store(std::int32_t* p, Reg x) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), x); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Reg set1(std::int32_t v) { return _mm256_set1_epi32(v); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Reg add(Reg x, Reg y) { return _mm256_add_epi32(x, y); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Reg sub(Reg x, Reg y) { return _mm256_sub_epi32(x, y); }
+				};
+
+				template<>
+				struct Vec<std::int64_t> {
+					using Reg = __m256i;
+					static constexpr size_t width = 4;
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Reg load(const std::int64_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE void store(std::int64_t* p, Reg x) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), x); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Reg set1(std::int64_t v) { return _mm256_set1_epi64x(v); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Reg add(Reg x, Reg y) { return _mm256_add_epi64(x, y); }
+					MATRICES_TARGET("avx2,fma") static MATRICES_INLINE Reg sub(Reg x, Reg y) { return _mm256_sub_epi64(x, y); }
+				};
+
+				MATRICES_SIMD_KERNELS("avx2,fma")
+			}
+
+			namespace avx512 {
+				template<class T>
+				struct Vec;
+
+				template<>
+				struct Vec<double> {
+					using Reg = __m512d;
+					using Mask = __mmask8;
+					using Acc = __m512d;
+					static constexpr size_t width = 8;
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Reg load(const double* p) { return _mm512_loadu_pd(p); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE void store(double* p, Reg x) { _mm512_storeu_pd(p, x); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Reg set1(double v) { return _mm512_set1_pd(v); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Reg add(Reg x, Reg y) { return _mm512_add_pd(x, y); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Reg sub(Reg x, Reg y) { return _mm512_sub_pd(x, y); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Reg mul(Reg x, Reg y) { return _mm512_mul_pd(x, y); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Reg div(Reg x, Reg y) { return _mm512_div_pd(x, y); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Reg fmadd(Reg x, Reg y, Reg acc) { return _mm512_fmadd_pd(x, y, acc); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Reg fnmadd(Reg x, Reg y, Reg acc) { return _mm512_fnmadd_pd(x, y, acc); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Reg abs(Reg x) { return _mm512_abs_pd(x); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Mask greater(Reg x, Reg y) { return _mm512_cmp_pd_mask(x, y, _CMP_GT_OQ); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Mask equal(Reg x, Reg y) { return _mm512_cmp_pd_mask(x, y, _CMP_EQ_OQ); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Reg select(Mask m, Reg x, Reg y) { return _mm512_mask_blend_pd(m, y, x); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Acc zeroAcc() { return _mm512_setzero_pd(); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE void addSquares(Acc& acc, Reg x) { acc = _mm512_fmadd_pd(x, x, acc); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE double reduce(Acc acc) {
+						// through memory rather than _mm512_reduce_add_pd, which warns like the extracts in Vec<float>::addSquares
+						alignas(64) double lanes[8];
+						_mm512_store_pd(lanes, acc);
+						return ((lanes[0] + lanes[4]) + (lanes[2] + lanes[6])) + ((lanes[1] + lanes[5]) + (lanes[3] + lanes[7]));
+					}
+				};
+
+				template<>
+				struct Vec<float> {
+					using Reg = __m512;
+					using Mask = __mmask16;
+					struct Acc { __m512d lo, hi; };
+					static constexpr size_t width = 16;
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Reg load(const float* p) { return _mm512_loadu_ps(p); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE void store(float* p, Reg x) { _mm512_storeu_ps(p, x); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Reg set1(float v) { return _mm512_set1_ps(v); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Reg add(Reg x, Reg y) { return _mm512_add_ps(x, y); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Reg sub(Reg x, Reg y) { return _mm512_sub_ps(x, y); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Reg mul(Reg x, Reg y) { return _mm512_mul_ps(x, y); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Reg div(Reg x, Reg y) { return _mm512_div_ps(x, y); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Reg fmadd(Reg x, Reg y, Reg acc) { return _mm512_fmadd_ps(x, y, acc); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Reg fnmadd(Reg x, Reg y, Reg acc) { return _mm512_fnmadd_ps(x, y, acc); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Reg abs(Reg x) { return _mm512_abs_ps(x); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Mask greater(Reg x, Reg y) { return _mm512_cmp_ps_mask(x, y, _CMP_GT_OQ); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Mask equal(Reg x, Reg y) { return _mm512_cmp_ps_mask(x, y, _CMP_EQ_OQ); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Reg select(Mask m, Reg x, Reg y) { return _mm512_mask_blend_ps(m, y, x); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Acc zeroAcc() { return { _mm512_setzero_pd(), _mm512_setzero_pd() }; }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE void addSquares(Acc& acc, Reg x) {
+						// the zero masked forms, the plain ones start from _mm512_undefined and GCC warns about an uninitialized __Y
+						__m512d lo = _mm512_maskz_cvtps_pd(0xff, _mm512_maskz_extractf32x8_ps(0xff, x, 0));
+						__m512d hi = _mm512_maskz_cvtps_pd(0xff, _mm512_maskz_extractf32x8_ps(0xff, x, 1));
+						acc.lo = _mm512_fmadd_pd(lo, lo, acc.lo);
+						acc.hi = _mm512_fmadd_pd(hi, hi, acc.hi);
+					}
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE double reduce(Acc acc) {
+						return Vec<double>::reduce(_mm512_add_pd(acc.lo, acc.hi));
+					}
+				};
+
+				template<>
+				struct Vec<std::int32_t> {
+					using Reg = __m512i;
+					static constexpr size_t width = 16;
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Reg load(const std::int32_t* p) { return _mm512_loadu_si512(p); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE void store(std::int32_t* p, Reg x) { _mm512_storeu_si512(p, x); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Reg set1(std::int32_t v) { return _mm512_set1_epi32(v); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Reg add(Reg x, Reg y) { return _mm512_add_epi32(x, y); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Reg sub(Reg x, Reg y) { return _mm512_sub_epi32(x, y); }
+				};
+
+				template<>
+				struct Vec<std::int64_t> {
+					using Reg = __m512i;
+					static constexpr size_t width = 8;
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Reg load(const std::int64_t* p) { return _mm512_loadu_si512(p); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE void store(std::int64_t* p, Reg x) { _mm512_storeu_si512(p, x); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Reg set1(std::int64_t v) { return _mm512_set1_epi64(v); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Reg add(Reg x, Reg y) { return _mm512_add_epi64(x, y); }
+					MATRICES_TARGET("avx512f,avx512dq") static MATRICES_INLINE Reg sub(Reg x, Reg y) { return _mm512_sub_epi64(x, y); }
+				};
+
+				MATRICES_SIMD_KERNELS("avx512f,avx512dq")
+			}
+
+#undef MATRICES_SIMD_KERNELS
+
+#endif
+
+			/// <summary>
+			/// Element types with hand written vector kernels
+			/// </summary>
+			template<class T>
+			struct HasKernels : std::integral_constant<bool,
+				std::is_same<T, float>::value || std::is_same<T, double>::value ||
+				std::is_same<T, std::int32_t>::value || std::is_same<T, std::int64_t>::value> {};
+
+			/// <summary>
+			/// Picks the kernel table for T that matches the CPU
+			/// </summary>
+			template<class T>
+			Kernels<T> selectKernels() {
+#ifdef MATRICES_X86
+				if constexpr (HasKernels<T>::value) {
+					switch (level()) {
+					case Level::AVX512:
+						if constexpr (std::is_floating_point<T>::value)
+							return { avx512::add<T>, avx512::sub<T>, avx512::scale<T>, avx512::fill<T>, avx512::sumSquares<T>, avx512::dot<T>, avx512::axpy<T> };
+						else
+							return { avx512::add<T>, avx512::sub<T>, scaleScalar<T>, avx512::fill<T>, sumSquaresScalar<T>, dotScalar<T>, axpyScalar<T> };
+					case Level::AVX2:
+						if constexpr (std::is_floating_point<T>::value)
+							return { avx2::add<T>, avx2::sub<T>, avx2::scale<T>, avx2::fill<T>, avx2::sumSquares<T>, avx2::dot<T>, avx2::axpy<T> };
+						else
+							return { avx2::add<T>, avx2::sub<T>, scaleScalar<T>, avx2::fill<T>, sumSquaresScalar<T>, dotScalar<T>, axpyScalar<T> };
+					case Level::SSE2:
+						if constexpr (std::is_floating_point<T>::value)
+							return { sse2::add<T>, sse2::sub<T>, sse2::scale<T>, sse2::fill<T>, sse2::sumSquares<T>, sse2::dot<T>, sse2::axpy<T> };
+						else
+							return { sse2::add<T>, sse2::sub<T>, scaleScalar<T>, sse2::fill<T>, sumSquaresScalar<T>, dotScalar<T>, axpyScalar<T> };
+					default:
+						break;
+					}
+				}
+#endif
+				return { addScalar<T>, subScalar<T>, scaleScalar<T>, fillScalar<T>, sumSquaresScalar<T>, dotScalar<T>, axpyScalar<T> };
+			}
+
+			/// <summary>
+			/// The kernel table for T, chosen once on first use
+			/// </summary>
+			template<class T>
+			const Kernels<T>& kernels() {
+				static const Kernels<T> table = selectKernels<T>();
+				return table;
+			}
+
+			/// <summary>
+			/// Elements each thread gets at least when an element-wise pass is split across the pool
+			/// </summary>
+			constexpr std::ptrdiff_t ParallelChunk = std::ptrdiff_t(1) << 15;
+
+			/// <summary>
+			/// Runs body(begin, end) over [0, n), across the pool if n is over the parallel threshold
+			/// </summary>
+			template<class F>
+			void forChunks(size_t n, const F& body) {
+				parallelFor(0, static_cast<std::ptrdiff_t>(n), ParallelChunk, n,
+					[&](std::ptrdiff_t begin, std::ptrdiff_t end) { body(static_cast<size_t>(begin), static_cast<size_t>(end - begin)); });
+			}
+
+			// front ends used by Matrix, types without vector kernels get the table of scalar loops
+
+			template<class T>
+			void add(const T* a, const T* b, T* out, size_t n) {
+				auto kernel = kernels<T>().add;
+				forChunks(n, [&](size_t i, size_t count) { kernel(a + i, b + i, out + i, count); });
+			}
+
+			template<class T>
+			void sub(const T* a, const T* b, T* out, size_t n) {
+				auto kernel = kernels<T>().sub;
+				forChunks(n, [&](size_t i, size_t count) { kernel(a + i, b + i, out + i, count); });
+			}
+
+			template<class T>
+			void scale(const T* a, T factor, T* out, size_t n) {
+				auto kernel = kernels<T>().scale;
+				forChunks(n, [&](size_t i, size_t count) { kernel(a + i, factor, out + i, count); });
+			}
+
+			template<class T>
+			void fill(T* out, T value, size_t n) {
+				auto kernel = kernels<T>().fill;
+				forChunks(n, [&](size_t i, size_t count) { kernel(out + i, value, count); });
+			}
+
+			/// <remarks>In parallel every chunk is summed on its own and the partial sums are added in order</remarks>
+			template<class T>
+			double sumSquares(const T* a, size_t n) {
+				auto kernel = kernels<T>().sumSquares;
+				size_t chunk = static_cast<size_t>(ParallelChunk);
+				size_t chunks = (n + chunk - 1) / chunk;
+				if (chunks <= 1 || !shouldParallelize(n))
+					return kernel(a, n);
+				std::vector<double> partial(chunks);
+				threadPool().parallelFor(0, static_cast<std::ptrdiff_t>(chunks), 1, [&](std::ptrdiff_t first, std::ptrdiff_t last) {
+					for (std::ptrdiff_t c = first; c < last; c++)
+						partial[c] = kernel(a + c * chunk, std::min(chunk, n - c * chunk));
+				});
+				double sum = 0.0;
+				for (double p : partial)
+					sum += p;
+				return sum;
+			}
+		}
+	}
+}
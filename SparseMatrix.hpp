@@ -0,0 +1,444 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include "Matrix.hpp"
+#include "ThreadPool.hpp"
+
+namespace matrices {
+
+	/// <summary>
+	/// How a SparseMatrix compresses its elements
+	/// </summary>
+	enum class SparseFormat {
+		/// Compressed sparse rows, rows are stored one after the other with the columns of their elements
+		CSR,
+		/// Compressed sparse columns, columns are stored one after the other with the rows of their elements
+		CSC
+	};
+
+	/// <summary>
+	/// One element of a sparse matrix, used to build one
+	/// </summary>
+	template<class T>
+	struct SparseEntry {
+		int col;
+		int row;
+		T value;
+	};
+
+	namespace detail {
+
+		/// <summary>
+		/// The three arrays of a compressed sparse matrix, indexed by its major dimension (rows for CSR, columns for CSC)
+		/// </summary>
+		/// <remarks>The elements of major i are offsets[i] to offsets[i + 1], sorted by their minor index</remarks>
+		template<class T>
+		struct Compressed {
+			std::vector<size_t> offsets;
+			std::vector<int> indices;
+			std::vector<T> values;
+		};
+
+		/// <summary>
+		/// Builds the compressed arrays from (major, minor, value) triplets, duplicates are added together
+		/// </summary>
+		template<class T>
+		Compressed<T> compress(int majors, std::vector<int>& major, std::vector<int>& minor, std::vector<T>& value) {
+			Compressed<T> out;
+			out.offsets.assign(static_cast<size_t>(majors) + 1, 0);
+			for (int m : major)
+				out.offsets[m + 1]++;
+			std::partial_sum(out.offsets.begin(), out.offsets.end(), out.offsets.begin());
+			std::vector<size_t> next(out.offsets.begin(), out.offsets.end() - 1);
+			std::vector<int> indices(major.size());
+			std::vector<T> values(major.size());
+			for (size_t e = 0; e < major.size(); e++) {
+				size_t slot = next[major[e]]++;
+				indices[slot] = minor[e];
+				values[slot] = value[e];
+			}
+
+			std::vector<size_t> order;
+			out.indices.reserve(indices.size());
+			out.values.reserve(values.size());
+			size_t begin = 0;
+			for (int m = 0; m < majors; m++) {
+				size_t end = out.offsets[m + 1];
+				order.resize(end - begin);
+				std::iota(order.begin(), order.end(), begin);
+				std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return indices[a] < indices[b]; });
+				out.offsets[m] = out.indices.size();
+				for (size_t o : order) {
+					if (out.indices.size() > out.offsets[m] && out.indices.back() == indices[o]) {
+						out.values.back() += values[o];
+					}
+					else {
+						out.indices.push_back(indices[o]);
+						out.values.push_back(values[o]);
+					}
+				}
+				begin = end;
+			}
+			out.offsets[majors] = out.indices.size();
+			return out;
+		}
+
+		/// <summary>
+		/// Swaps the major and minor dimensions, which turns CSR into CSC of the same matrix or CSR into CSR of the transpose
+		/// </summary>
+		template<class T>
+		Compressed<T> swapCompression(int majors, int minors, const Compressed<T>& in) {
+			Compressed<T> out;
+			out.offsets.assign(static_cast<size_t>(minors) + 1, 0);
+			for (int i : in.indices)
+				out.offsets[i + 1]++;
+			std::partial_sum(out.offsets.begin(), out.offsets.end(), out.offsets.begin());
+			out.indices.resize(in.indices.size());
+			out.values.resize(in.values.size());
+			std::vector<size_t> next(out.offsets.begin(), out.offsets.end() - 1);
+			// going through the old majors in order leaves every new major sorted
+			for (int m = 0; m < majors; m++)
+				for (size_t e = in.offsets[m]; e < in.offsets[m + 1]; e++) {
+					size_t slot = next[in.indices[e]]++;
+					out.indices[slot] = m;
+					out.values[slot] = in.values[e];
+				}
+			return out;
+		}
+
+		/// <summary>
+		/// C = A * B with every operand compressed by rows, Gustavson's algorithm
+		/// </summary>
+		/// <param name="m">Rows of A and C</param>
+		/// <param name="n">Columns of B and C</param>
+		/// <remarks>
+		/// Done in two passes over the rows, the first counts the elements of every row of C so the second
+		/// can write them straight into place. Both passes are split across the thread pool, every task
+		/// keeps a dense accumulator of n elements
+		/// </remarks>
+		template<class T>
+		Compressed<T> sparseMultiply(int m, int n, const Compressed<T>& a, const Compressed<T>& b) {
+			Compressed<T> c;
+			c.offsets.assign(static_cast<size_t>(m) + 1, 0);
+			size_t work = a.indices.size() + b.indices.size();
+			parallelFor(0, m, 64, work, [&](std::ptrdiff_t first, std::ptrdiff_t last) {
+				std::vector<std::ptrdiff_t> marker(n, -1);
+				for (std::ptrdiff_t row = first; row < last; row++) {
+					size_t count = 0;
+					for (size_t ea = a.offsets[row]; ea < a.offsets[row + 1]; ea++) {
+						int k = a.indices[ea];
+						for (size_t eb = b.offsets[k]; eb < b.offsets[k + 1]; eb++) {
+							int col = b.indices[eb];
+							if (marker[col] != row) {
+								marker[col] = row;
+								count++;
+							}
+						}
+					}
+					c.offsets[row + 1] = count;
+				}
+			});
+			std::partial_sum(c.offsets.begin(), c.offsets.end(), c.offsets.begin());
+			c.indices.resize(c.offsets[m]);
+			c.values.resize(c.offsets[m]);
+
+			parallelFor(0, m, 64, work, [&](std::ptrdiff_t first, std::ptrdiff_t last) {
+				std::vector<std::ptrdiff_t> marker(n, -1);
+				std::vector<T> accumulator(n);
+				for (std::ptrdiff_t row = first; row < last; row++) {
+					int* indices = c.indices.data() + c.offsets[row];
+					size_t count = 0;
+					for (size_t ea = a.offsets[row]; ea < a.offsets[row + 1]; ea++) {
+						int k = a.indices[ea];
+						T value = a.values[ea];
+						for (size_t eb = b.offsets[k]; eb < b.offsets[k + 1]; eb++) {
+							int col = b.indices[eb];
+							if (marker[col] != row) {
+								marker[col] = row;
+								indices[count++] = col;
+								accumulator[col] = value * b.values[eb];
+							}
+							else {
+								accumulator[col] += value * b.values[eb];
+							}
+						}
+					}
+					std::sort(indices, indices + count);
+					T* values = c.values.data() + c.offsets[row];
+					for (size_t e = 0; e < count; e++)
+						values[e] = accumulator[indices[e]];
+				}
+			});
+			return c;
+		}
+	}
+
+	/// <summary>
+	/// Matrix that only stores its non zero elements, compressed by rows (CSR) or by columns (CSC)
+	/// </summary>
+	/// <remarks>
+	/// Meant for matrices that are mostly zeros, e.g. detector responses, where it needs a fraction of
+	/// the memory of a Matrix and the products skip the zeros. Elements are addressed col, row like
+	/// Matrix. Products with dense matrices and vectors and with other sparse matrices are split across
+	/// the thread pool, CSR is the faster format for both
+	/// </remarks>
+	template<class T, SparseFormat Format = SparseFormat::CSR>
+	class SparseMatrix {
+	public:
+		using value_type = T;
+		static constexpr SparseFormat format = Format;
+
+		/// <summary>
+		/// Creates an empty, all zero, matrix
+		/// </summary>
+		/// <param name="dimx">Amount of columns</param>
+		/// <param name="dimy">Amount of rows</param>
+		SparseMatrix(int dimx, int dimy)
+			: dimx_(dimx), dimy_(dimy) {
+			data_.offsets.assign(static_cast<size_t>(majors()) + 1, 0);
+		}
+
+		/// <summary>
+		/// Creates a sparse matrix from a list of elements, elements at the same position are added together
+		/// </summary>
+		/// <remarks>Throws std::out_of_range if an element is outside the matrix</remarks>
+		SparseMatrix(int dimx, int dimy, const std::vector<SparseEntry<T>>& entries)
+			: dimx_(dimx), dimy_(dimy) {
+			std::vector<int> major, minor;
+			std::vector<T> value;
+			major.reserve(entries.size());
+			minor.reserve(entries.size());
+			value.reserve(entries.size());
+			for (auto& entry : entries) {
+				if (entry.col < 0 || entry.row < 0 || entry.col >= dimx_ || entry.row >= dimy_)
+					throw std::out_of_range("Index out of range");
+				major.push_back(isCSR ? entry.row : entry.col);
+				minor.push_back(isCSR ? entry.col : entry.row);
+				value.push_back(entry.value);
+			}
+			data_ = detail::compress(majors(), major, minor, value);
+		}
+
+		/// <summary>
+		/// Keeps the elements of a dense matrix that are not equal to T()
+		/// </summary>
+		template<class A>
+		explicit SparseMatrix(const Matrix<T, A>& dense)
+			: dimx_(dense.columns()), dimy_(dense.rows()) {
+			Compressed rows;
+			rows.offsets.assign(static_cast<size_t>(dimy_) + 1, 0);
+			for (int row = 0; row < dimy_; row++) {
+				const T* src = dense.inner_.data() + static_cast<size_t>(row) * dimx_;
+				for (int col = 0; col < dimx_; col++)
+					if (src[col] != T()) {
+						rows.indices.push_back(col);
+						rows.values.push_back(src[col]);
+					}
+				rows.offsets[row + 1] = rows.indices.size();
+			}
+			data_ = isCSR ? std::move(rows) : detail::swapCompression(dimy_, dimx_, rows);
+		}
+
+		/// <summary>
+		/// Converts between CSR and CSC
+		/// </summary>
+		template<SparseFormat Other, typename std::enable_if<Other != Format, int>::type = 0>
+		explicit SparseMatrix(const SparseMatrix<T, Other>& other)
+			: dimx_(other.columns()), dimy_(other.rows()) {
+			int otherMajors = isCSR ? dimx_ : dimy_;
+			data_ = detail::swapCompression(otherMajors, majors(), other.compressed());
+		}
+
+		int columns() const { return dimx_; }
+		int rows() const { return dimy_; }
+
+		/// <summary>
+		/// Number of elements that are stored
+		/// </summary>
+		size_t nonZeros() const {
+			return data_.values.size();
+		}
+
+		/// <summary>
+		/// Bytes used by the elements and indices, to compare with columns() * rows() * sizeof(T) for a Matrix
+		/// </summary>
+		size_t memoryUsage() const {
+			return data_.offsets.size() * sizeof(size_t) + data_.indices.size() * sizeof(int) + data_.values.size() * sizeof(T);
+		}
+
+		/// <summary>
+		/// Returns the value at col, row, T() if it isn't stored
+		/// </summary>
+		/// <remarks>Binary search within the row or column, throws std::out_of_range if outside the matrix</remarks>
+		T getAt(int col, int row) const {
+			if (col < 0 || row < 0 || col >= dimx_ || row >= dimy_)
+				throw std::out_of_range("Index out of range");
+			int major = isCSR ? row : col;
+			int minor = isCSR ? col : row;
+			auto begin = data_.indices.begin() + data_.offsets[major];
+			auto end = data_.indices.begin() + data_.offsets[major + 1];
+			auto found = std::lower_bound(begin, end, minor);
+			if (found == end || *found != minor)
+				return T();
+			return data_.values[found - data_.indices.begin()];
+		}
+
+		/// <summary>
+		/// The compressed offsets, indices and values, indexed by rows for CSR and by columns for CSC
+		/// </summary>
+		const detail::Compressed<T>& compressed() const {
+			return data_;
+		}
+
+		/// <summary>
+		/// Expands the matrix back into a dense Matrix
+		/// </summary>
+		Matrix<T> toDense() const {
+			Matrix<T> dense(dimx_, dimy_);
+			for (int m = 0; m < majors(); m++)
+				for (size_t e = data_.offsets[m]; e < data_.offsets[m + 1]; e++) {
+					int row = isCSR ? m : data_.indices[e];
+					int col = isCSR ? data_.indices[e] : m;
+					dense.inner_[static_cast<size_t>(row) * dimx_ + col] = data_.values[e];
+				}
+			return dense;
+		}
+
+		/// <summary>
+		/// Sparse times dense, a vector being a dense matrix of one column
+		/// </summary>
+		/// <param name="dense">Needs as many rows as this matrix has columns</param>
+		/// <returns>A dense matrix with the rows of this one and the columns of dense</returns>
+		template<class A>
+		Matrix<T> operator*(const Matrix<T, A>& dense) const {
+			if (dimx_ != dense.rows())
+				throw std::invalid_argument("Matrix dimensions do not match");
+			Matrix<T> result(dense.columns(), dimy_);
+			multiplyDense(dense.inner_.data(), dense.columns(), result.inner_.data());
+			return result;
+		}
+
+		/// <summary>
+		/// Sparse matrix times dense vector
+		/// </summary>
+		std::vector<T> operator*(const std::vector<T>& x) const {
+			if (static_cast<size_t>(dimx_) != x.size())
+				throw std::invalid_argument("Matrix dimensions do not match");
+			std::vector<T> y(dimy_);
+			multiplyDense(x.data(), 1, y.data());
+			return y;
+		}
+
+		/// <summary>
+		/// Sparse times sparse, only the products of stored elements are ever computed
+		/// </summary>
+		/// <returns>A sparse matrix in the same format, elements that cancel to zero are kept</returns>
+		SparseMatrix operator*(const SparseMatrix& other) const {
+			if (dimx_ != other.dimy_)
+				throw std::invalid_argument("Matrix dimensions do not match");
+			SparseMatrix result(other.dimx_, dimy_);
+			// a CSC matrix is the CSR of its transpose and (A * B)' = B' * A'
+			if (isCSR)
+				result.data_ = detail::sparseMultiply(dimy_, other.dimx_, data_, other.data_);
+			else
+				result.data_ = detail::sparseMultiply(other.dimx_, dimy_, other.data_, data_);
+			return result;
+		}
+
+		/// <summary>
+		/// Fills a histogram with the row of every stored element that is above zero, the same as Matrix::fillHistogram but skipping the zeros
+		/// </summary>
+		/// <remarks>HistT is anything with a Fill(x, weight) function, e.g. a pointer to a ROOT TH1</remarks>
+		template<typename HistT>
+		void fillHistogram(HistT hist, int weight) const {
+			for (int m = 0; m < majors(); m++)
+				for (size_t e = data_.offsets[m]; e < data_.offsets[m + 1]; e++)
+					if (data_.values[e] > 0)
+						hist->Fill(isCSR ? m : data_.indices[e], weight);
+		}
+
+	private:
+		using Compressed = detail::Compressed<T>;
+		static constexpr bool isCSR = Format == SparseFormat::CSR;
+
+		int majors() const {
+			return isCSR ? dimy_ : dimx_;
+		}
+
+		/// <summary>
+		/// out = this * x, where x is row major with width columns and has as many rows as this has columns
+		/// </summary>
+		void multiplyDense(const T* x, int width, T* out) const {
+			size_t work = nonZeros() * static_cast<size_t>(width);
+			if constexpr (isCSR) {
+				// every row of the result is independent
+				detail::parallelFor(0, dimy_, 64, work, [&](std::ptrdiff_t first, std::ptrdiff_t last) {
+					for (std::ptrdiff_t row = first; row < last; row++) {
+						if (width == 1) {
+							T sum = T();
+							for (size_t e = data_.offsets[row]; e < data_.offsets[row + 1]; e++)
+								sum += data_.values[e] * x[data_.indices[e]];
+							out[row] = sum;
+							continue;
+						}
+						T* y = out + row * width;
+						std::fill(y, y + width, T());
+						for (size_t e = data_.offsets[row]; e < data_.offsets[row + 1]; e++) {
+							T value = data_.values[e];
+							const T* xRow = x + static_cast<size_t>(data_.indices[e]) * width;
+							for (int c = 0; c < width; c++)
+								y[c] += value * xRow[c];
+						}
+					}
+				});
+			}
+			else {
+				// columns scatter into every row, so each chunk of columns adds into its own copy of the
+				// result and the copies are summed in a fixed order afterwards
+				size_t size = static_cast<size_t>(dimy_) * width;
+				int chunks = detail::shouldParallelize(work) ? static_cast<int>(detail::threadPool().size()) : 1;
+				std::vector<T> partials(static_cast<size_t>(chunks - 1) * size);
+				std::fill(out, out + size, T());
+				detail::parallelFor(0, chunks, 1, work, [&](std::ptrdiff_t first, std::ptrdiff_t last) {
+					for (std::ptrdiff_t chunk = first; chunk < last; chunk++) {
+						T* y = chunk == 0 ? out : partials.data() + (chunk - 1) * size;
+						int begin = static_cast<int>(static_cast<long long>(dimx_) * chunk / chunks);
+						int end = static_cast<int>(static_cast<long long>(dimx_) * (chunk + 1) / chunks);
+						for (int col = begin; col < end; col++) {
+							const T* xRow = x + static_cast<size_t>(col) * width;
+							for (size_t e = data_.offsets[col]; e < data_.offsets[col + 1]; e++) {
+								T value = data_.values[e];
+								T* yRow = y + static_cast<size_t>(data_.indices[e]) * width;
+								for (int c = 0; c < width; c++)
+									yRow[c] += value * xRow[c];
+							}
+						}
+					}
+				});
+				detail::parallelFor(0, static_cast<std::ptrdiff_t>(size), detail::simd::ParallelChunk, size * chunks, [&](std::ptrdiff_t first, std::ptrdiff_t last) {
+					for (int chunk = 1; chunk < chunks; chunk++) {
+						const T* partial = partials.data() + (chunk - 1) * size;
+						for (std::ptrdiff_t i = first; i < last; i++)
+							out[i] += partial[i];
+					}
+				});
+			}
+		}
+
+		int dimx_, dimy_;
+		Compressed data_;
+
+		template<class U, SparseFormat F>
+		friend class SparseMatrix;
+	};
+
+	template<class T>
+	using CsrMatrix = SparseMatrix<T, SparseFormat::CSR>;
+
+	template<class T>
+	using CscMatrix = SparseMatrix<T, SparseFormat::CSC>;
+}
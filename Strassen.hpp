@@ -0,0 +1,165 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+#include "Allocators.hpp"
+#include "Gemm.hpp"
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+
+namespace matrices {
+
+	namespace detail {
+
+		inline std::atomic<int>& globalStrassenThreshold() {
+			static std::atomic<int> threshold(4096);
+			return threshold;
+		}
+	}
+
+	/// <summary>
+	/// Sets how big every dimension of a floating point product has to be before it's split with
+	/// Strassen-Winograd instead of going straight to the blocked kernel, 0 turns it off
+	/// </summary>
+	inline void setStrassenThreshold(int size) {
+		detail::globalStrassenThreshold().store(std::max(size, 0));
+	}
+
+	/// <summary>
+	/// Gets the size every dimension of a product needs before Strassen-Winograd is used, 0 when it's off
+	/// </summary>
+	inline int getStrassenThreshold() {
+		return detail::globalStrassenThreshold().load();
+	}
+
+	namespace detail {
+
+		/// <summary>
+		/// Whether an m x k times k x n product is split again rather than handed to gemm
+		/// </summary>
+		inline bool splitsProduct(int m, int n, int k, int threshold) {
+			return threshold > 0 && std::min(m, std::min(n, k)) >= threshold;
+		}
+
+		/// <summary>
+		/// Elements of workspace the whole recursion below an m x k times k x n product needs
+		/// </summary>
+		/// <remarks>
+		/// Every level keeps two temporaries, X of m/2 x max(n/2, k/2) and Y of k/2 x n/2. The products of
+		/// a level are worked out one after the other, so the levels below can all share what's left
+		/// </remarks>
+		inline size_t winogradWorkspace(int m, int n, int k, int threshold) {
+			size_t total = 0;
+			while (splitsProduct(m, n, k, threshold)) {
+				m /= 2;
+				n /= 2;
+				k /= 2;
+				total += static_cast<size_t>(m) * std::max(n, k) + static_cast<size_t>(k) * n;
+			}
+			return total;
+		}
+
+		/// <summary>
+		/// out = x + y, or x - y, for rows x columns blocks that each have their own distance between rows
+		/// </summary>
+		/// <remarks>out may be x or y</remarks>
+		template<class T>
+		void addBlocks(bool subtract, int rows, int columns, const T* x, std::ptrdiff_t ldx,
+			const T* y, std::ptrdiff_t ldy, T* out, std::ptrdiff_t ldo) {
+			auto kernel = subtract ? simd::kernels<T>().sub : simd::kernels<T>().add;
+			std::ptrdiff_t grain = std::max<std::ptrdiff_t>(1, simd::ParallelChunk / std::max(columns, 1));
+			parallelFor(0, rows, grain, static_cast<size_t>(rows) * columns, [&](std::ptrdiff_t first, std::ptrdiff_t last) {
+				for (std::ptrdiff_t row = first; row < last; row++)
+					kernel(x + row * ldx, y + row * ldy, out + row * ldo, static_cast<size_t>(columns));
+			});
+		}
+
+		/// <summary>
+		/// C = A * B for row major operands with Strassen-Winograd, 7 half size products and 15 additions per level
+		/// </summary>
+		/// <param name="work">winogradWorkspace(m, n, k, threshold) elements</param>
+		/// <remarks>
+		/// Uses the schedule of Boyer, Dumas, Pernet and Zhou that keeps the intermediate sums in the
+		/// quadrants of C and two temporaries. Odd dimensions are split on their even part and the last
+		/// row, column or rank one update is done by gemm. Products below the threshold go to gemm
+		/// </remarks>
+		template<class T>
+		void winograd(int m, int n, int k, const T* a, std::ptrdiff_t lda, const T* b, std::ptrdiff_t ldb,
+			T* c, std::ptrdiff_t ldc, T* work, int threshold) {
+			if (!splitsProduct(m, n, k, threshold)) {
+				gemm<T>(m, n, k, T(1), a, lda, 1, b, ldb, 1, T(), c, ldc, 1);
+				return;
+			}
+			int mh = m / 2, nh = n / 2, kh = k / 2;
+			const T* a11 = a;
+			const T* a12 = a + kh;
+			const T* a21 = a + mh * lda;
+			const T* a22 = a21 + kh;
+			const T* b11 = b;
+			const T* b12 = b + nh;
+			const T* b21 = b + kh * ldb;
+			const T* b22 = b21 + nh;
+			T* c11 = c;
+			T* c12 = c + nh;
+			T* c21 = c + mh * ldc;
+			T* c22 = c21 + nh;
+			std::ptrdiff_t ldx = std::max(nh, kh), ldy = nh;
+			T* x = work;
+			T* y = x + static_cast<size_t>(mh) * ldx;
+			T* rest = y + static_cast<size_t>(kh) * nh;
+			auto multiplyHalves = [&](const T* l, std::ptrdiff_t ldl, const T* r, std::ptrdiff_t ldr, T* out, std::ptrdiff_t ldo) {
+				winograd(mh, nh, kh, l, ldl, r, ldr, out, ldo, rest, threshold);
+			};
+
+			addBlocks(true, mh, kh, a11, lda, a21, lda, x, ldx);     // S3 = A11 - A21
+			addBlocks(true, kh, nh, b22, ldb, b12, ldb, y, ldy);     // T3 = B22 - B12
+			multiplyHalves(x, ldx, y, ldy, c21, ldc);                // P7 = S3 T3
+			addBlocks(false, mh, kh, a21, lda, a22, lda, x, ldx);    // S1 = A21 + A22
+			addBlocks(true, kh, nh, b12, ldb, b11, ldb, y, ldy);     // T1 = B12 - B11
+			multiplyHalves(x, ldx, y, ldy, c22, ldc);                // P5 = S1 T1
+			addBlocks(true, kh, nh, b22, ldb, y, ldy, y, ldy);       // T2 = B22 - T1
+			addBlocks(true, mh, kh, x, ldx, a11, lda, x, ldx);       // S2 = S1 - A11
+			multiplyHalves(x, ldx, y, ldy, c12, ldc);                // P6 = S2 T2
+			addBlocks(true, mh, kh, a12, lda, x, ldx, x, ldx);       // S4 = A12 - S2
+			multiplyHalves(x, ldx, b22, ldb, c11, ldc);              // P3 = S4 B22
+			multiplyHalves(a11, lda, b11, ldb, x, ldx);              // P1 = A11 B11
+			addBlocks(false, mh, nh, x, ldx, c12, ldc, c12, ldc);    // U2 = P1 + P6
+			addBlocks(false, mh, nh, c12, ldc, c21, ldc, c21, ldc);  // U3 = U2 + P7
+			addBlocks(false, mh, nh, c12, ldc, c22, ldc, c12, ldc);  // U4 = U2 + P5
+			addBlocks(false, mh, nh, c21, ldc, c22, ldc, c22, ldc);  // U7 = U3 + P5, C22 is done
+			addBlocks(false, mh, nh, c12, ldc, c11, ldc, c12, ldc);  // U5 = U4 + P3, C12 is done
+			addBlocks(true, kh, nh, y, ldy, b21, ldb, y, ldy);       // T4 = T2 - B21
+			multiplyHalves(a22, lda, y, ldy, c11, ldc);              // P4 = A22 T4
+			addBlocks(true, mh, nh, c21, ldc, c11, ldc, c21, ldc);   // U6 = U3 - P4, C21 is done
+			multiplyHalves(a12, lda, b21, ldb, c11, ldc);            // P2 = A12 B21
+			addBlocks(false, mh, nh, x, ldx, c11, ldc, c11, ldc);    // U1 = P1 + P2, C11 is done
+
+			if (k % 2 != 0)
+				gemm<T>(2 * mh, 2 * nh, 1, T(1), a + 2 * kh, lda, 1, b + 2 * kh * ldb, ldb, 1, T(1), c, ldc, 1);
+			if (n % 2 != 0)
+				gemm<T>(2 * mh, 1, k, T(1), a, lda, 1, b + 2 * nh, ldb, 1, T(), c + 2 * nh, ldc, 1);
+			if (m % 2 != 0)
+				gemm<T>(1, n, k, T(1), a + 2 * mh * lda, lda, 1, b, ldb, 1, T(), c + 2 * mh * ldc, ldc, 1);
+		}
+
+		/// <summary>
+		/// C = A * B for row major operands, big floating point products go through Strassen-Winograd and the rest to gemm
+		/// </summary>
+		/// <remarks>The workspace for the whole recursion is allocated once up front</remarks>
+		template<class T>
+		void product(int m, int n, int k, const T* a, std::ptrdiff_t lda, const T* b, std::ptrdiff_t ldb, T* c, std::ptrdiff_t ldc) {
+			if constexpr (std::is_floating_point<T>::value) {
+				int threshold = getStrassenThreshold();
+				if (splitsProduct(m, n, k, threshold)) {
+					std::vector<T, AlignedAllocator<T>> work(winogradWorkspace(m, n, k, threshold));
+					winograd(m, n, k, a, lda, b, ldb, c, ldc, work.data(), threshold);
+					return;
+				}
+			}
+			gemm<T>(m, n, k, T(1), a, lda, 1, b, ldb, 1, T(), c, ldc, 1);
+		}
+	}
+}
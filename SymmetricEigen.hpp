@@ -0,0 +1,378 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include "Allocators.hpp"
+#include "Factorizations.hpp"
+#include "Gemm.hpp"
+#include "ThreadPool.hpp"
+
+namespace matrices {
+
+	/// <summary>
+	/// How the eigenvalues of a symmetric matrix are worked out
+	/// </summary>
+	enum class EigenMethod {
+		Auto,          // Jacobi up to JacobiLimit rows, Tridiagonal above that
+		Tridiagonal,   // blocked Householder reduction to tridiagonal form then implicit QL, O(n^3) with small constants
+		Jacobi         // cyclic Jacobi rotations on the whole matrix, slower but very accurate for small matrices
+	};
+
+	namespace detail {
+
+		/// <summary>
+		/// Largest matrix EigenMethod::Auto diagonalises with Jacobi rotations
+		/// </summary>
+		constexpr int JacobiLimit = 8;
+
+		/// <summary>
+		/// The lower triangle of a row major n x n matrix copied into both triangles of a new buffer, which is what the solvers work on
+		/// </summary>
+		template<class F, class T>
+		std::vector<F, AlignedAllocator<F>> symmetricCopy(int n, const T* a) {
+			std::vector<F, AlignedAllocator<F>> work(static_cast<size_t>(n) * n);
+			for (int row = 0; row < n; row++)
+				for (int col = 0; col <= row; col++)
+					work[static_cast<size_t>(row) * n + col] = work[static_cast<size_t>(col) * n + row] =
+						static_cast<F>(a[static_cast<size_t>(row) * n + col]);
+			return work;
+		}
+
+		/// <summary>
+		/// Reduces a symmetric matrix to tridiagonal form Q^T * A * Q = T with Householder reflectors, blocked like LAPACK's sytrd
+		/// </summary>
+		/// <param name="a">Row major with both triangles filled in, overwritten. Reflector j is left below the subdiagonal of column j</param>
+		/// <param name="d">n entries, the diagonal of T</param>
+		/// <param name="e">n entries, e[i] is T[i + 1][i] and e[n - 1] is 0</param>
+		/// <param name="tau">n entries, H_j = I - tau[j] * v_j * v_j^T where v_j is 1 at row j + 1</param>
+		/// <remarks>
+		/// Each panel of FactorizationBlock columns keeps its reflectors in V and W so that the trailing matrix is
+		/// A - V * W^T - W * V^T, and only brings it up to date at the end with two gemm calls. Half the work
+		/// is the product of the trailing matrix with each reflector, which is spread across the pool by rows
+		/// </remarks>
+		template<class T>
+		void tridiagonalize(int n, T* a, std::ptrdiff_t lda, T* d, T* e, T* tau) {
+			int nb = FactorizationBlock;
+			std::vector<T> v(static_cast<size_t>(n) * nb), w(static_cast<size_t>(n) * nb), y(n), reflector(n), vw(nb), ww(nb);
+			for (int k = 0; k < n - 1; k += nb) {
+				int kb = std::min(nb, n - 1 - k);
+				std::fill(v.begin() + static_cast<size_t>(k) * nb, v.end(), T());
+				std::fill(w.begin() + static_cast<size_t>(k) * nb, w.end(), T());
+				for (int jj = 0; jj < kb; jj++) {
+					int j = k + jj;
+					// bring column j up to date with the reflectors of this panel so far
+					const T* vj = v.data() + static_cast<size_t>(j) * nb;
+					const T* wj = w.data() + static_cast<size_t>(j) * nb;
+					for (int i = j; i < n; i++) {
+						const T* vi = v.data() + static_cast<size_t>(i) * nb;
+						const T* wi = w.data() + static_cast<size_t>(i) * nb;
+						T sum = T();
+						for (int p = 0; p < jj; p++)
+							sum += vi[p] * wj[p] + wi[p] * vj[p];
+						a[i * lda + j] -= sum;
+					}
+					d[j] = a[j * lda + j];
+					T* x = a + (j + 1) * lda + j;
+					T t = tau[j] = householder(n - j - 1, x, lda);
+					e[j] = x[0];
+					for (int i = j + 1; i < n; i++)
+						reflector[i] = v[static_cast<size_t>(i) * nb + jj] = i == j + 1 ? T(1) : a[i * lda + j];
+
+					// y = tau * (A - V * W^T - W * V^T) * v over the trailing rows and columns
+					std::fill(ww.begin(), ww.end(), T());
+					std::fill(vw.begin(), vw.end(), T());
+					for (int i = j + 1; i < n; i++) {
+						const T* vi = v.data() + static_cast<size_t>(i) * nb;
+						const T* wi = w.data() + static_cast<size_t>(i) * nb;
+						T r = reflector[i];
+						for (int p = 0; p < jj; p++) {
+							ww[p] += wi[p] * r;
+							vw[p] += vi[p] * r;
+						}
+					}
+					// A is symmetric, so A * v is a sum of its rows, which vectorises where a dot product per row wouldn't
+					parallelFor(j + 1, n, 256, static_cast<size_t>(n - j) * (n - j), [&](std::ptrdiff_t first, std::ptrdiff_t last) {
+						std::fill(y.begin() + first, y.begin() + last, T());
+						for (int c = j + 1; c < n; c++) {
+							T factor = reflector[c];
+							const T* row = a + c * lda;
+							for (std::ptrdiff_t i = first; i < last; i++)
+								y[i] += factor * row[i];
+						}
+						for (std::ptrdiff_t i = first; i < last; i++) {
+							const T* vi = v.data() + static_cast<size_t>(i) * nb;
+							const T* wi = w.data() + static_cast<size_t>(i) * nb;
+							T sum = y[i];
+							for (int p = 0; p < jj; p++)
+								sum -= vi[p] * ww[p] + wi[p] * vw[p];
+							y[i] = t * sum;
+						}
+					});
+					// w = y - tau / 2 * (y^T * v) * v
+					T dot = T();
+					for (int i = j + 1; i < n; i++)
+						dot += y[i] * reflector[i];
+					T alpha = -t / 2 * dot;
+					for (int i = j + 1; i < n; i++)
+						w[static_cast<size_t>(i) * nb + jj] = y[i] + alpha * reflector[i];
+				}
+
+				// A22 -= V * W^T + W * V^T
+				int rest = n - k - kb;
+				const T* v2 = v.data() + static_cast<size_t>(k + kb) * nb;
+				const T* w2 = w.data() + static_cast<size_t>(k + kb) * nb;
+				T* a22 = a + (k + kb) * lda + k + kb;
+				gemm<T>(rest, rest, kb, T(-1), v2, nb, 1, w2, 1, nb, T(1), a22, lda, 1);
+				gemm<T>(rest, rest, kb, T(-1), w2, nb, 1, v2, 1, nb, T(1), a22, lda, 1);
+			}
+			d[n - 1] = a[(n - 1) * lda + n - 1];
+			e[n - 1] = T();
+			tau[n - 1] = T();
+		}
+
+		/// <summary>
+		/// Overwrites z with Q * z, Q being the product of the reflectors tridiagonalize left in a
+		/// </summary>
+		/// <remarks>Blocks of reflectors are applied together as I - V * T * V^T, so all the work is in gemm</remarks>
+		template<class T>
+		void applyTridiagonalQ(int n, const T* a, std::ptrdiff_t lda, const T* tau, T* z, std::ptrdiff_t ldz) {
+			int nb = FactorizationBlock;
+			int reflectors = n - 1;
+			std::vector<T> vb(static_cast<size_t>(n) * nb), t(static_cast<size_t>(nb) * nb), work(static_cast<size_t>(nb) * n), u(nb);
+			for (int j0 = (reflectors - 1) / nb * nb; j0 >= 0; j0 -= nb) {
+				int kb = std::min(nb, reflectors - j0);
+				int r0 = j0 + 1, m = n - r0;
+				// the reflectors of the block as dense columns with their leading 1 and the zeros above it
+				for (int i = 0; i < m; i++)
+					for (int p = 0; p < kb; p++) {
+						int row = r0 + i, top = j0 + p + 1;
+						vb[static_cast<size_t>(i) * kb + p] = row < top ? T() : row == top ? T(1) : a[row * lda + j0 + p];
+					}
+				// T, upper triangular, with H_j0 * ... * H_(j0 + kb - 1) = I - V * T * V^T
+				for (int i = 0; i < kb; i++) {
+					for (int p = 0; p < i; p++) {
+						T sum = T();
+						for (int r = 0; r < m; r++)
+							sum += vb[static_cast<size_t>(r) * kb + p] * vb[static_cast<size_t>(r) * kb + i];
+						u[p] = sum;
+					}
+					for (int p = 0; p < i; p++) {
+						T sum = T();
+						for (int q = p; q < i; q++)
+							sum += t[static_cast<size_t>(p) * nb + q] * u[q];
+						t[static_cast<size_t>(p) * nb + i] = -tau[j0 + i] * sum;
+					}
+					t[static_cast<size_t>(i) * nb + i] = tau[j0 + i];
+				}
+
+				T* zb = z + r0 * ldz;
+				// work = T * V^T * z, T applied in place from the top as row p only needs the rows below it
+				gemm<T>(kb, n, m, T(1), vb.data(), 1, kb, zb, ldz, 1, T(), work.data(), n, 1);
+				parallelFor(0, n, 256, static_cast<size_t>(kb) * kb * n, [&](std::ptrdiff_t first, std::ptrdiff_t last) {
+					for (int p = 0; p < kb; p++) {
+						T* out = work.data() + static_cast<size_t>(p) * n;
+						T diagonal = t[static_cast<size_t>(p) * nb + p];
+						for (std::ptrdiff_t c = first; c < last; c++)
+							out[c] *= diagonal;
+						for (int q = p + 1; q < kb; q++) {
+							T factor = t[static_cast<size_t>(p) * nb + q];
+							const T* src = work.data() + static_cast<size_t>(q) * n;
+							for (std::ptrdiff_t c = first; c < last; c++)
+								out[c] += factor * src[c];
+						}
+					}
+				});
+				// z -= V * work
+				gemm<T>(m, n, kb, T(-1), vb.data(), kb, 1, work.data(), n, 1, T(1), zb, ldz, 1);
+			}
+		}
+
+		/// <summary>
+		/// Eigenvalues of a symmetric tridiagonal matrix by implicit QL with Wilkinson shifts, after EISPACK's tql2
+		/// </summary>
+		/// <param name="d">The diagonal, overwritten with the eigenvalues in no particular order</param>
+		/// <param name="e">The subdiagonal with e[n - 1] = 0, destroyed</param>
+		/// <param name="zt">If not null, n x n row major, every rotation is applied to its rows so eigenvector i ends up in row i</param>
+		/// <remarks>The rotations of each sweep are recorded first and then applied to the columns of zt in parallel</remarks>
+		template<class T>
+		void tridiagonalQL(int n, T* d, T* e, T* zt, std::ptrdiff_t ldz) {
+			using std::abs;
+			using std::hypot;
+			const T eps = std::numeric_limits<T>::epsilon();
+			std::vector<T> cs, ss;
+			if (zt) {
+				cs.resize(n);
+				ss.resize(n);
+			}
+			T f = T(), norm = T();
+			for (int l = 0; l < n; l++) {
+				norm = std::max(norm, abs(d[l]) + abs(e[l]));
+				int m = l;
+				while (m < n - 1 && abs(e[m]) > eps * norm)
+					m++;
+				int iterations = 0;
+				while (m > l) {
+					if (++iterations > 60)
+						throw std::runtime_error("Eigenvalues did not converge");
+					T g = d[l];
+					T p = (d[l + 1] - g) / (2 * e[l]);
+					T r = hypot(p, T(1));
+					if (p < 0)
+						r = -r;
+					d[l] = e[l] / (p + r);
+					d[l + 1] = e[l] * (p + r);
+					T dl1 = d[l + 1];
+					T h = g - d[l];
+					for (int i = l + 2; i < n; i++)
+						d[i] -= h;
+					f += h;
+
+					p = d[m];
+					T c = 1, c2 = 1, c3 = 1, s = 0, s2 = 0;
+					T el1 = e[l + 1];
+					for (int i = m - 1; i >= l; i--) {
+						c3 = c2;
+						c2 = c;
+						s2 = s;
+						g = c * e[i];
+						h = c * p;
+						r = hypot(p, e[i]);
+						e[i + 1] = s * r;
+						s = e[i] / r;
+						c = p / r;
+						p = c * d[i] - s * g;
+						d[i + 1] = h + s * (c * g + s * d[i]);
+						if (zt) {
+							cs[i] = c;
+							ss[i] = s;
+						}
+					}
+					if (zt) {
+						parallelFor(0, n, 256, static_cast<size_t>(m - l) * n * 6, [&](std::ptrdiff_t first, std::ptrdiff_t last) {
+							for (int i = m - 1; i >= l; i--) {
+								T ci = cs[i], si = ss[i];
+								T* upper = zt + i * ldz;
+								T* lower = zt + (i + 1) * ldz;
+								for (std::ptrdiff_t k = first; k < last; k++) {
+									T below = lower[k];
+									lower[k] = si * upper[k] + ci * below;
+									upper[k] = ci * upper[k] - si * below;
+								}
+							}
+						});
+					}
+					p = -s * s2 * c3 * el1 * e[l] / dl1;
+					e[l] = s * p;
+					d[l] = c * p;
+					if (abs(e[l]) <= eps * norm)
+						break;
+				}
+				d[l] += f;
+				e[l] = T();
+			}
+		}
+
+		/// <summary>
+		/// Eigenvalues, and if vt isn't null eigenvectors, of a small symmetric matrix by cyclic Jacobi rotations
+		/// </summary>
+		/// <param name="a">Row major with both triangles filled in, destroyed</param>
+		/// <param name="values">n entries, in no particular order</param>
+		/// <param name="vt">n x n row major, eigenvector i ends up in row i</param>
+		/// <remarks>An off diagonal element is only rotated away while it is large next to its two diagonal elements, which keeps small eigenvalues accurate to full relative precision</remarks>
+		template<class T>
+		void jacobiEigen(int n, T* a, std::ptrdiff_t lda, T* values, T* vt, std::ptrdiff_t ldv) {
+			using std::abs;
+			using std::sqrt;
+			const T eps = std::numeric_limits<T>::epsilon();
+			if (vt)
+				for (int i = 0; i < n; i++)
+					for (int j = 0; j < n; j++)
+						vt[i * ldv + j] = i == j ? T(1) : T();
+			for (int sweep = 0; sweep < 64; sweep++) {
+				bool rotated = false;
+				for (int p = 0; p < n - 1; p++)
+					for (int q = p + 1; q < n; q++) {
+						T apq = a[p * lda + q];
+						T app = a[p * lda + p], aqq = a[q * lda + q];
+						if (apq == T() || abs(apq) <= eps * sqrt(abs(app) * abs(aqq)))
+							continue;
+						rotated = true;
+						T theta = (aqq - app) / (2 * apq);
+						T t = T(1) / (abs(theta) + sqrt(theta * theta + 1));
+						if (theta < 0)
+							t = -t;
+						T c = T(1) / sqrt(t * t + 1), s = t * c, tau = s / (1 + c);
+						a[p * lda + p] = app - t * apq;
+						a[q * lda + q] = aqq + t * apq;
+						a[p * lda + q] = a[q * lda + p] = T();
+						for (int r = 0; r < n; r++) {
+							if (r == p || r == q)
+								continue;
+							T g = a[r * lda + p], h = a[r * lda + q];
+							a[r * lda + p] = a[p * lda + r] = g - s * (h + g * tau);
+							a[r * lda + q] = a[q * lda + r] = h + s * (g - h * tau);
+						}
+						if (vt) {
+							T* rowP = vt + p * ldv;
+							T* rowQ = vt + q * ldv;
+							for (int r = 0; r < n; r++) {
+								T g = rowP[r], h = rowQ[r];
+								rowP[r] = g - s * (h + g * tau);
+								rowQ[r] = h + s * (g - h * tau);
+							}
+						}
+					}
+				if (!rotated)
+					break;
+			}
+			for (int i = 0; i < n; i++)
+				values[i] = a[i * lda + i];
+		}
+
+		/// <summary>
+		/// Eigenvalues in ascending order of the symmetric n x n matrix a, and its eigenvectors if vectors isn't null
+		/// </summary>
+		/// <param name="a">Row major with both triangles filled in, destroyed</param>
+		/// <param name="vectors">n x n row major, column i is the eigenvector of values[i]</param>
+		template<class T>
+		void symmetricEigen(EigenMethod method, int n, T* a, std::ptrdiff_t lda, T* values, T* vectors, std::ptrdiff_t ldv) {
+			if (n == 0)
+				return;
+			if (method == EigenMethod::Auto)
+				method = n <= JacobiLimit ? EigenMethod::Jacobi : EigenMethod::Tridiagonal;
+
+			std::vector<T> unsorted(n), rows(vectors ? static_cast<size_t>(n) * n : 0), tau;
+			if (method == EigenMethod::Jacobi) {
+				jacobiEigen(n, a, lda, unsorted.data(), vectors ? rows.data() : nullptr, n);
+			}
+			else {
+				std::vector<T> e(n);
+				tau.resize(n);
+				tridiagonalize(n, a, lda, unsorted.data(), e.data(), tau.data());
+				if (vectors)
+					for (int i = 0; i < n; i++)
+						rows[static_cast<size_t>(i) * n + i] = T(1);
+				tridiagonalQL(n, unsorted.data(), e.data(), vectors ? rows.data() : nullptr, n);
+			}
+
+			std::vector<int> order(n);
+			std::iota(order.begin(), order.end(), 0);
+			std::sort(order.begin(), order.end(), [&](int l, int r) { return unsorted[l] < unsorted[r]; });
+			for (int i = 0; i < n; i++)
+				values[i] = unsorted[order[i]];
+			if (!vectors)
+				return;
+			// rows hold the eigenvectors, they become the sorted columns of vectors
+			for (int r = 0; r < n; r++)
+				for (int c = 0; c < n; c++)
+					vectors[r * ldv + c] = rows[static_cast<size_t>(order[c]) * n + r];
+			if (method == EigenMethod::Tridiagonal)
+				applyTridiagonalQ(n, a, lda, tau.data(), vectors, ldv);
+		}
+	}
+}
@@ -0,0 +1,166 @@
+#pragma once
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "Precision.hpp"
+
+namespace matrices {
+
+	/// <summary>
+	/// How a matrix is written out as text
+	/// </summary>
+	/// <remarks>
+	/// Every element is written as prefix, value, suffix, elements in a row are separated by delimiter and
+	/// rows by rowSeparator. The default gives the "(1.000000) (2.000000) " output operator<< has always
+	/// had. The strings aren't copied, so they have to outlive the format, literals always do
+	/// </remarks>
+	struct TextFormat {
+		std::string_view prefix = "(";
+		std::string_view suffix = ") ";
+		std::string_view delimiter = "";
+		std::string_view rowSeparator = "\n";
+		/// <summary>
+		/// Digits after the decimal point for floating point elements, below 0 writes the shortest text that reads back to the same value
+		/// </summary>
+		int precision = 6;
+		std::chars_format floatFormat = std::chars_format::fixed;
+
+		/// <summary>
+		/// Comma separated values that read back exactly, one row per line
+		/// </summary>
+		static TextFormat csv() {
+			TextFormat format;
+			format.prefix = "";
+			format.suffix = "";
+			format.delimiter = ",";
+			format.precision = -1;
+			format.floatFormat = std::chars_format::general;
+			return format;
+		}
+	};
+
+	namespace detail {
+
+		/// <summary>
+		/// Formats elements into a fixed buffer that is handed to sink whenever it fills up, so nothing is allocated per element
+		/// </summary>
+		template<class Sink>
+		class TextWriter {
+		public:
+			explicit TextWriter(Sink& sink)
+				: sink_(sink), end_(buffer_) {}
+
+			~TextWriter() {
+				flush();
+			}
+
+			TextWriter(const TextWriter&) = delete;
+			TextWriter& operator=(const TextWriter&) = delete;
+
+			void write(std::string_view text) {
+				if (text.size() > room()) {
+					flush();
+					if (text.size() > room()) {
+						sink_(text.data(), text.size());
+						return;
+					}
+				}
+				std::memcpy(end_, text.data(), text.size());
+				end_ += text.size();
+			}
+
+			template<class T>
+			void write(const T& value, const TextFormat& format) {
+				std::to_chars_result result = toChars(end_, buffer_ + BufferSize, value, format);
+				if (result.ec != std::errc()) {
+					flush();
+					result = toChars(end_, buffer_ + BufferSize, value, format);
+				}
+				if (result.ec == std::errc()) {
+					end_ = result.ptr;
+					return;
+				}
+				// only a precision in the thousands of digits doesn't fit an empty buffer, that one value goes through the heap
+				std::string text(2 * BufferSize, '\0');
+				while ((result = toChars(&text[0], &text[0] + text.size(), value, format)).ec != std::errc())
+					text.resize(2 * text.size());
+				sink_(text.data(), static_cast<size_t>(result.ptr - text.data()));
+			}
+
+			void flush() {
+				if (end_ != buffer_)
+					sink_(buffer_, static_cast<size_t>(end_ - buffer_));
+				end_ = buffer_;
+			}
+
+		private:
+			// big enough for any long double written in fixed notation at the usual precisions
+			static constexpr size_t BufferSize = size_t(1) << 14;
+
+			size_t room() const {
+				return static_cast<size_t>(buffer_ + BufferSize - end_);
+			}
+
+			template<class T>
+			static std::to_chars_result toChars(char* first, char* last, const T& value, const TextFormat& format) {
+				if constexpr (IsReducedFloat<T>::value) {
+					return toChars(first, last, static_cast<float>(value), format);
+				}
+				else if constexpr (std::is_floating_point<T>::value) {
+					if (format.precision < 0)
+						return std::to_chars(first, last, value, format.floatFormat);
+					return std::to_chars(first, last, value, format.floatFormat, format.precision);
+				}
+				else if constexpr (std::is_same<T, bool>::value) {
+					return std::to_chars(first, last, static_cast<int>(value));
+				}
+				else {
+					return std::to_chars(first, last, value);
+				}
+			}
+
+			Sink& sink_;
+			char* end_;
+			char buffer_[BufferSize];
+		};
+
+		/// <summary>
+		/// Writes columns x rows elements, the element at col, row is data[row * rowStride + col * columnStride]
+		/// </summary>
+		template<class T, class Sink>
+		void formatText(Sink& sink, const T* data, int columns, int rows, std::ptrdiff_t rowStride, std::ptrdiff_t columnStride, const TextFormat& format) {
+			TextWriter<Sink> writer(sink);
+			for (int row = 0; row < rows; row++) {
+				if (row != 0)
+					writer.write(format.rowSeparator);
+				const T* element = data + row * rowStride;
+				for (int col = 0; col < columns; col++, element += columnStride) {
+					if (col != 0)
+						writer.write(format.delimiter);
+					writer.write(format.prefix);
+					writer.write(*element, format);
+					writer.write(format.suffix);
+				}
+			}
+		}
+
+		template<class T>
+		void writeText(std::ostream& os, const T* data, int columns, int rows, std::ptrdiff_t rowStride, std::ptrdiff_t columnStride, const TextFormat& format) {
+			auto sink = [&os](const char* text, size_t size) { os.write(text, static_cast<std::streamsize>(size)); };
+			formatText(sink, data, columns, rows, rowStride, columnStride, format);
+		}
+
+		template<class T>
+		std::string toText(const T* data, int columns, int rows, std::ptrdiff_t rowStride, std::ptrdiff_t columnStride, const TextFormat& format) {
+			std::string text;
+			auto sink = [&text](const char* part, size_t size) { text.append(part, size); };
+			formatText(sink, data, columns, rows, rowStride, columnStride, format);
+			return text;
+		}
+	}
+}
@@ -0,0 +1,345 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace matrices {
+
+	/// <summary>
+	/// How the heavy operations (products, element-wise arithmetic, transposes and factorisations) are run
+	/// </summary>
+	enum class Execution {
+		/// Always on the calling thread
+		Sequential,
+		/// Always split across the thread pool
+		Parallel,
+		/// Split across the thread pool once the work is above the parallel threshold
+		Automatic
+	};
+
+	namespace detail {
+
+		inline std::atomic<Execution>& globalExecution() {
+			static std::atomic<Execution> execution(Execution::Automatic);
+			return execution;
+		}
+
+		inline std::atomic<size_t>& globalParallelThreshold() {
+			static std::atomic<size_t> threshold(size_t(1) << 18);
+			return threshold;
+		}
+
+		/// <summary>
+		/// Set by ScopedExecution, takes priority over the global setting on this thread
+		/// </summary>
+		inline Execution*& threadExecution() {
+			thread_local Execution* execution = nullptr;
+			return execution;
+		}
+	}
+
+	/// <summary>
+	/// Sets how operations are run on every thread that doesn't have a ScopedExecution active
+	/// </summary>
+	inline void setExecution(Execution execution) {
+		detail::globalExecution().store(execution);
+	}
+
+	/// <summary>
+	/// Gets the execution policy in effect on the calling thread
+	/// </summary>
+	inline Execution getExecution() {
+		Execution* local = detail::threadExecution();
+		return local ? *local : detail::globalExecution().load();
+	}
+
+	/// <summary>
+	/// Sets the amount of work, roughly in element updates or multiply-adds, an operation needs before
+	/// Execution::Automatic splits it across threads
+	/// </summary>
+	inline void setParallelThreshold(size_t work) {
+		detail::globalParallelThreshold().store(work);
+	}
+
+	/// <summary>
+	/// Gets the amount of work an operation needs before Execution::Automatic splits it across threads
+	/// </summary>
+	inline size_t getParallelThreshold() {
+		return detail::globalParallelThreshold().load();
+	}
+
+	/// <summary>
+	/// Overrides the execution policy on the current thread until it goes out of scope
+	/// </summary>
+	class ScopedExecution {
+	public:
+		explicit ScopedExecution(Execution execution)
+			: execution_(execution), previous_(detail::threadExecution()) {
+			detail::threadExecution() = &execution_;
+		}
+
+		~ScopedExecution() {
+			detail::threadExecution() = previous_;
+		}
+
+		ScopedExecution(const ScopedExecution&) = delete;
+		ScopedExecution& operator=(const ScopedExecution&) = delete;
+
+	private:
+		Execution execution_;
+		Execution* previous_;
+	};
+
+	namespace detail {
+
+		/// <summary>
+		/// Work stealing thread pool owned by the library
+		/// </summary>
+		/// <remarks>
+		/// Every worker has its own deque, it takes work from the back of it and steals from the front
+		/// of the others when it runs dry. Ranges are split in half recursively so the large halves are
+		/// the ones that get stolen. Threads outside the pool share one extra deque and help run tasks
+		/// while they wait, so nested parallel loops can't deadlock. The number of workers is the number
+		/// of hardware threads minus the caller, or MATRICES_NUM_THREADS - 1 if that is set.
+		/// </remarks>
+		class ThreadPool {
+		public:
+			explicit ThreadPool(unsigned threads)
+				: queues_(std::max(threads, 1u)) {
+				for (unsigned i = 1; i < queues_.size(); i++)
+					workers_.emplace_back([this, i] { workerLoop(i); });
+			}
+
+			~ThreadPool() {
+				{
+					std::lock_guard<std::mutex> lock(sleepMutex_);
+					stop_ = true;
+				}
+				wake_.notify_all();
+				for (auto& worker : workers_)
+					worker.join();
+			}
+
+			ThreadPool(const ThreadPool&) = delete;
+			ThreadPool& operator=(const ThreadPool&) = delete;
+
+			/// <summary>
+			/// Threads that take part in a parallel loop, the workers plus the caller
+			/// </summary>
+			unsigned size() const {
+				return static_cast<unsigned>(queues_.size());
+			}
+
+			/// <summary>
+			/// Runs body(begin, end) over sub ranges of [begin, end) no smaller than grain, returning once all of them are done
+			/// </summary>
+			/// <remarks>The first exception thrown by body is rethrown on the calling thread</remarks>
+			template<class F>
+			void parallelFor(std::ptrdiff_t begin, std::ptrdiff_t end, std::ptrdiff_t grain, const F& body) {
+				if (end <= begin)
+					return;
+				grain = std::max<std::ptrdiff_t>(grain, 1);
+				if (size() == 1 || end - begin <= grain) {
+					body(begin, end);
+					return;
+				}
+				Job job;
+				job.pending.store(1);
+				Task root{ &invoke<F>, &body, begin, end, grain, &job };
+				run(root);
+				while (job.pending.load(std::memory_order_acquire) != 0) {
+					Task task;
+					if (findTask(currentQueue(), task))
+						run(task);
+					else
+						std::this_thread::yield();
+				}
+				if (job.error)
+					std::rethrow_exception(job.error);
+			}
+
+		private:
+			struct Job {
+				std::atomic<int> pending{ 0 };
+				std::mutex errorMutex;
+				std::exception_ptr error;
+			};
+
+			struct Task {
+				void (*invoke)(const void* body, std::ptrdiff_t begin, std::ptrdiff_t end);
+				const void* body;
+				std::ptrdiff_t begin, end, grain;
+				Job* job;
+			};
+
+			struct Queue {
+				std::mutex mutex;
+				std::deque<Task> tasks;
+			};
+
+			template<class F>
+			static void invoke(const void* body, std::ptrdiff_t begin, std::ptrdiff_t end) {
+				(*static_cast<const F*>(body))(begin, end);
+			}
+
+			/// <summary>
+			/// Index of the deque owned by the calling thread, 0 for threads outside the pool
+			/// </summary>
+			static unsigned& currentQueue() {
+				thread_local unsigned index = 0;
+				return index;
+			}
+
+			/// <summary>
+			/// Splits off the upper halves of a task for other threads to steal until it is down to its grain, then runs it
+			/// </summary>
+			void run(Task task) {
+				while (task.end - task.begin > task.grain) {
+					std::ptrdiff_t mid = task.begin + (task.end - task.begin) / 2;
+					Task upper = task;
+					upper.begin = mid;
+					task.end = mid;
+					task.job->pending.fetch_add(1, std::memory_order_relaxed);
+					push(upper);
+				}
+				try {
+					task.invoke(task.body, task.begin, task.end);
+				}
+				catch (...) {
+					std::lock_guard<std::mutex> lock(task.job->errorMutex);
+					if (!task.job->error)
+						task.job->error = std::current_exception();
+				}
+				task.job->pending.fetch_sub(1, std::memory_order_release);
+			}
+
+			void push(const Task& task) {
+				Queue& queue = queues_[currentQueue()];
+				{
+					std::lock_guard<std::mutex> lock(queue.mutex);
+					queue.tasks.push_back(task);
+				}
+				// seq_cst pairs with the worker's increment of sleeping_ and check of queued_, so either the
+				// worker sees this task or this sees the worker and wakes it, a sleeping worker can't miss it
+				queued_.fetch_add(1, std::memory_order_seq_cst);
+				if (sleeping_.load(std::memory_order_seq_cst) > 0) {
+					{ std::lock_guard<std::mutex> lock(sleepMutex_); }
+					wake_.notify_one();
+				}
+			}
+
+			/// <summary>
+			/// Takes the newest task from the thread's own deque, otherwise steals the oldest from another one
+			/// </summary>
+			bool findTask(unsigned self, Task& task) {
+				if (queued_.load(std::memory_order_acquire) == 0)
+					return false;
+				{
+					Queue& own = queues_[self];
+					std::lock_guard<std::mutex> lock(own.mutex);
+					if (!own.tasks.empty()) {
+						task = own.tasks.back();
+						own.tasks.pop_back();
+						queued_.fetch_sub(1, std::memory_order_relaxed);
+						return true;
+					}
+				}
+				for (size_t i = 1; i < queues_.size(); i++) {
+					Queue& victim = queues_[(self + i) % queues_.size()];
+					std::lock_guard<std::mutex> lock(victim.mutex);
+					if (!victim.tasks.empty()) {
+						task = victim.tasks.front();
+						victim.tasks.pop_front();
+						queued_.fetch_sub(1, std::memory_order_relaxed);
+						return true;
+					}
+				}
+				return false;
+			}
+
+			void workerLoop(unsigned index) {
+				currentQueue() = index;
+				for (;;) {
+					Task task;
+					if (findTask(index, task)) {
+						run(task);
+						continue;
+					}
+					std::unique_lock<std::mutex> lock(sleepMutex_);
+					if (stop_)
+						return;
+					sleeping_.fetch_add(1, std::memory_order_seq_cst);
+					wake_.wait(lock, [this] { return stop_ || queued_.load(std::memory_order_seq_cst) > 0; });
+					sleeping_.fetch_sub(1);
+				}
+			}
+
+			std::vector<Queue> queues_;
+			std::vector<std::thread> workers_;
+			std::atomic<int> queued_{ 0 };
+			std::atomic<int> sleeping_{ 0 };
+			std::mutex sleepMutex_;
+			std::condition_variable wake_;
+			bool stop_ = false;
+		};
+
+		/// <summary>
+		/// Number of threads the pool is created with
+		/// </summary>
+		inline unsigned defaultThreadCount() {
+			if (const char* env = std::getenv("MATRICES_NUM_THREADS")) {
+				int n = std::atoi(env);
+				if (n > 0)
+					return static_cast<unsigned>(n);
+			}
+			return std::max(std::thread::hardware_concurrency(), 1u);
+		}
+
+		/// <summary>
+		/// The library's thread pool, started the first time it is needed
+		/// </summary>
+		inline ThreadPool& threadPool() {
+			static ThreadPool pool(defaultThreadCount());
+			return pool;
+		}
+
+		/// <summary>
+		/// Whether an operation of the given size should be split across threads under the current policy
+		/// </summary>
+		/// <param name="work">Roughly the number of element updates or multiply-adds</param>
+		inline bool shouldParallelize(size_t work) {
+			switch (getExecution()) {
+			case Execution::Sequential:
+				return false;
+			case Execution::Parallel:
+				return threadPool().size() > 1;
+			default:
+				return work >= getParallelThreshold() && threadPool().size() > 1;
+			}
+		}
+
+		/// <summary>
+		/// Runs body(begin, end) over [begin, end), split across the pool if the work is big enough
+		/// </summary>
+		/// <param name="work">Total work of the whole range, compared against the parallel threshold</param>
+		/// <param name="grain">Smallest sub range handed to a thread</param>
+		template<class F>
+		void parallelFor(std::ptrdiff_t begin, std::ptrdiff_t end, std::ptrdiff_t grain, size_t work, const F& body) {
+			if (end <= begin)
+				return;
+			if (!shouldParallelize(work)) {
+				body(begin, end);
+				return;
+			}
+			threadPool().parallelFor(begin, end, grain, body);
+		}
+	}
+}
@@ -0,0 +1,280 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+
+namespace matrices {
+	namespace detail {
+
+		/// <summary>
+		/// Side of the square tiles the transposes work on, a tile of doubles from each side fits in L1 together
+		/// </summary>
+		constexpr int TransposeTile = 32;
+
+		/// <summary>
+		/// Size in bytes above which an out of place transpose writes around the cache
+		/// </summary>
+		/// <remarks>
+		/// A tile only writes part of every cache line it touches in the destination, so each line is read
+		/// in before it's written. Past this size the tiles are built in a buffer and streamed out instead
+		/// </remarks>
+		constexpr size_t TransposeStreamBytes = size_t(1) << 23;
+
+		/// <summary>
+		/// Signature of a kernel that transposes a tile of at most TransposeTile x TransposeTile elements
+		/// </summary>
+		/// <remarks>dst[c * ldd + r] = src[r * lds + c] for every row r and column c of the tile</remarks>
+		template<class T>
+		using TransposeTileFn = void (*)(int rows, int cols, const T* src, std::ptrdiff_t lds, T* dst, std::ptrdiff_t ldd);
+
+		template<class T>
+		void transposeTileScalar(int rows, int cols, const T* src, std::ptrdiff_t lds, T* dst, std::ptrdiff_t ldd) {
+			for (int r = 0; r < rows; r++)
+				for (int c = 0; c < cols; c++)
+					dst[c * ldd + r] = src[r * lds + c];
+		}
+
+#ifdef MATRICES_X86
+		/// <summary>
+		/// Tile transpose for 8 byte elements in 4 x 4 register blocks, the elements are only moved so any 8 byte type works
+		/// </summary>
+		MATRICES_TARGET("avx2")
+		inline void transposeTile8(int rows, int cols, const void* srcBytes, std::ptrdiff_t lds, void* dstBytes, std::ptrdiff_t ldd) {
+			const double* src = static_cast<const double*>(srcBytes);
+			double* dst = static_cast<double*>(dstBytes);
+			int r = 0;
+			for (; r + 4 <= rows; r += 4) {
+				int c = 0;
+				for (; c + 4 <= cols; c += 4) {
+					const double* s = src + r * lds + c;
+					__m256d r0 = _mm256_loadu_pd(s);
+					__m256d r1 = _mm256_loadu_pd(s + lds);
+					__m256d r2 = _mm256_loadu_pd(s + 2 * lds);
+					__m256d r3 = _mm256_loadu_pd(s + 3 * lds);
+					__m256d t0 = _mm256_unpacklo_pd(r0, r1);
+					__m256d t1 = _mm256_unpackhi_pd(r0, r1);
+					__m256d t2 = _mm256_unpacklo_pd(r2, r3);
+					__m256d t3 = _mm256_unpackhi_pd(r2, r3);
+					double* d = dst + c * ldd + r;
+					_mm256_storeu_pd(d, _mm256_permute2f128_pd(t0, t2, 0x20));
+					_mm256_storeu_pd(d + ldd, _mm256_permute2f128_pd(t1, t3, 0x20));
+					_mm256_storeu_pd(d + 2 * ldd, _mm256_permute2f128_pd(t0, t2, 0x31));
+					_mm256_storeu_pd(d + 3 * ldd, _mm256_permute2f128_pd(t1, t3, 0x31));
+				}
+				for (; c < cols; c++)
+					for (int i = r; i < r + 4; i++)
+						dst[c * ldd + i] = src[i * lds + c];
+			}
+			for (; r < rows; r++)
+				for (int c = 0; c < cols; c++)
+					dst[c * ldd + r] = src[r * lds + c];
+		}
+
+		/// <summary>
+		/// Tile transpose for 4 byte elements in 8 x 8 register blocks, the elements are only moved so any 4 byte type works
+		/// </summary>
+		MATRICES_TARGET("avx2")
+		inline void transposeTile4(int rows, int cols, const void* srcBytes, std::ptrdiff_t lds, void* dstBytes, std::ptrdiff_t ldd) {
+			const float* src = static_cast<const float*>(srcBytes);
+			float* dst = static_cast<float*>(dstBytes);
+			int r = 0;
+			for (; r + 8 <= rows; r += 8) {
+				int c = 0;
+				for (; c + 8 <= cols; c += 8) {
+					const float* s = src + r * lds + c;
+					__m256 t0 = _mm256_unpacklo_ps(_mm256_loadu_ps(s), _mm256_loadu_ps(s + lds));
+					__m256 t1 = _mm256_unpackhi_ps(_mm256_loadu_ps(s), _mm256_loadu_ps(s + lds));
+					__m256 t2 = _mm256_unpacklo_ps(_mm256_loadu_ps(s + 2 * lds), _mm256_loadu_ps(s + 3 * lds));
+					__m256 t3 = _mm256_unpackhi_ps(_mm256_loadu_ps(s + 2 * lds), _mm256_loadu_ps(s + 3 * lds));
+					__m256 t4 = _mm256_unpacklo_ps(_mm256_loadu_ps(s + 4 * lds), _mm256_loadu_ps(s + 5 * lds));
+					__m256 t5 = _mm256_unpackhi_ps(_mm256_loadu_ps(s + 4 * lds), _mm256_loadu_ps(s + 5 * lds));
+					__m256 t6 = _mm256_unpacklo_ps(_mm256_loadu_ps(s + 6 * lds), _mm256_loadu_ps(s + 7 * lds));
+					__m256 t7 = _mm256_unpackhi_ps(_mm256_loadu_ps(s + 6 * lds), _mm256_loadu_ps(s + 7 * lds));
+					__m256 u0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+					__m256 u1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+					__m256 u2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+					__m256 u3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+					__m256 u4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+					__m256 u5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+					__m256 u6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+					__m256 u7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+					float* d = dst + c * ldd + r;
+					_mm256_storeu_ps(d, _mm256_permute2f128_ps(u0, u4, 0x20));
+					_mm256_storeu_ps(d + ldd, _mm256_permute2f128_ps(u1, u5, 0x20));
+					_mm256_storeu_ps(d + 2 * ldd, _mm256_permute2f128_ps(u2, u6, 0x20));
+					_mm256_storeu_ps(d + 3 * ldd, _mm256_permute2f128_ps(u3, u7, 0x20));
+					_mm256_storeu_ps(d + 4 * ldd, _mm256_permute2f128_ps(u0, u4, 0x31));
+					_mm256_storeu_ps(d + 5 * ldd, _mm256_permute2f128_ps(u1, u5, 0x31));
+					_mm256_storeu_ps(d + 6 * ldd, _mm256_permute2f128_ps(u2, u6, 0x31));
+					_mm256_storeu_ps(d + 7 * ldd, _mm256_permute2f128_ps(u3, u7, 0x31));
+				}
+				for (; c < cols; c++)
+					for (int i = r; i < r + 8; i++)
+						dst[c * ldd + i] = src[i * lds + c];
+			}
+			for (; r < rows; r++)
+				for (int c = 0; c < cols; c++)
+					dst[c * ldd + r] = src[r * lds + c];
+		}
+
+		template<class T>
+		void transposeTileAvx2(int rows, int cols, const T* src, std::ptrdiff_t lds, T* dst, std::ptrdiff_t ldd) {
+			if constexpr (sizeof(T) == 8)
+				transposeTile8(rows, cols, src, lds, dst, ldd);
+			else
+				transposeTile4(rows, cols, src, lds, dst, ldd);
+		}
+
+		/// <summary>
+		/// Copies bytes with non temporal stores wherever the destination is 32 byte aligned
+		/// </summary>
+		MATRICES_TARGET("avx2")
+		inline void streamCopy(void* dstBytes, const void* srcBytes, size_t bytes) {
+			char* dst = static_cast<char*>(dstBytes);
+			const char* src = static_cast<const char*>(srcBytes);
+			size_t head = std::min(bytes, (32 - (reinterpret_cast<std::uintptr_t>(dst) & 31)) & 31);
+			std::memcpy(dst, src, head);
+			for (size_t i = head; i + 32 <= bytes; i += 32)
+				_mm256_stream_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)));
+			size_t tail = head + (bytes - head) / 32 * 32;
+			std::memcpy(dst + tail, src + tail, bytes - tail);
+		}
+
+		/// <summary>
+		/// Tile transpose into a buffer in L1 that is then streamed out to the destination a row at a time
+		/// </summary>
+		template<class T>
+		void transposeTileStreamed(int rows, int cols, const T* src, std::ptrdiff_t lds, T* dst, std::ptrdiff_t ldd) {
+			alignas(64) T buffer[TransposeTile * TransposeTile];
+			transposeTileAvx2(rows, cols, src, lds, buffer, TransposeTile);
+			for (int c = 0; c < cols; c++)
+				streamCopy(dst + c * ldd, buffer + c * TransposeTile, rows * sizeof(T));
+		}
+#endif
+
+		/// <summary>
+		/// Picks the widest tile kernel the CPU can run, only plain 4 and 8 byte types have vector kernels
+		/// </summary>
+		/// <param name="stream">Whether the destination is too big for the cache, which selects the streaming kernel</param>
+		template<class T>
+		TransposeTileFn<T> transposeTileKernel(bool stream = false) {
+#ifdef MATRICES_X86
+			if constexpr (std::is_trivially_copyable<T>::value && (sizeof(T) == 8 || sizeof(T) == 4)) {
+				static const bool avx2 = simd::level() >= simd::Level::AVX2;
+				if (avx2)
+					return stream ? &transposeTileStreamed<T> : &transposeTileAvx2<T>;
+			}
+#endif
+			return &transposeTileScalar<T>;
+		}
+
+		/// <summary>
+		/// Makes the streamed stores of the calling thread visible before anything else reads them
+		/// </summary>
+		inline void streamFence() {
+#ifdef MATRICES_X86
+			_mm_sfence();
+#endif
+		}
+
+		/// <summary>
+		/// Cache oblivious transpose, halves the longer side until the pieces are single tiles
+		/// </summary>
+		template<class T>
+		void transposeRecursive(int rows, int cols, const T* src, std::ptrdiff_t lds, T* dst, std::ptrdiff_t ldd, TransposeTileFn<T> tile) {
+			if (rows <= TransposeTile && cols <= TransposeTile) {
+				tile(rows, cols, src, lds, dst, ldd);
+			}
+			else if (rows >= cols) {
+				int half = rows / 2;
+				transposeRecursive(half, cols, src, lds, dst, ldd, tile);
+				transposeRecursive(rows - half, cols, src + half * lds, lds, dst + half, ldd, tile);
+			}
+			else {
+				int half = cols / 2;
+				transposeRecursive(rows, half, src, lds, dst, ldd, tile);
+				transposeRecursive(rows, cols - half, src + half, lds, dst + half * ldd, ldd, tile);
+			}
+		}
+
+		/// <summary>
+		/// Out of place transpose, dst[c * ldd + r] = src[r * lds + c]
+		/// </summary>
+		/// <param name="rows">Rows of src, columns of dst</param>
+		/// <param name="cols">Columns of src, rows of dst</param>
+		/// <remarks>Bands of rows are handed to the thread pool and each band is transposed cache obliviously</remarks>
+		template<class T>
+		void transposeInto(int rows, int cols, const T* src, std::ptrdiff_t lds, T* dst, std::ptrdiff_t ldd) {
+			bool stream = static_cast<size_t>(rows) * cols * sizeof(T) >= TransposeStreamBytes;
+			TransposeTileFn<T> tile = transposeTileKernel<T>(stream);
+			constexpr int band = 4 * TransposeTile;
+			int bands = (rows + band - 1) / band;
+			parallelFor(0, bands, 1, static_cast<size_t>(rows) * cols, [&](std::ptrdiff_t first, std::ptrdiff_t last) {
+				int begin = static_cast<int>(first) * band;
+				int end = std::min(rows, static_cast<int>(last) * band);
+				transposeRecursive(end - begin, cols, src + begin * lds, lds, dst + begin, ldd, tile);
+				if (stream)
+					streamFence();
+			});
+		}
+
+		/// <summary>
+		/// Transposes a square matrix in place by swapping mirrored tiles through a buffer on the stack
+		/// </summary>
+		template<class T>
+		void transposeSquare(int n, T* a, std::ptrdiff_t lda) {
+			TransposeTileFn<T> tile = transposeTileKernel<T>();
+			int blocks = (n + TransposeTile - 1) / TransposeTile;
+			parallelFor(0, blocks, 1, static_cast<size_t>(n) * n, [&](std::ptrdiff_t first, std::ptrdiff_t last) {
+				T buffer[TransposeTile * TransposeTile];
+				for (std::ptrdiff_t bi = first; bi < last; bi++) {
+					int i = static_cast<int>(bi) * TransposeTile;
+					int rows = std::min(TransposeTile, n - i);
+					for (int j = i; j < n; j += TransposeTile) {
+						int cols = std::min(TransposeTile, n - j);
+						T* upper = a + i * lda + j;
+						T* lower = a + j * lda + i;
+						// buffer = transpose(upper), upper = transpose(lower), lower = buffer
+						tile(rows, cols, upper, lda, buffer, TransposeTile);
+						if (i != j)
+							tile(cols, rows, lower, lda, upper, lda);
+						for (int r = 0; r < cols; r++)
+							std::copy(buffer + r * TransposeTile, buffer + r * TransposeTile + rows, lower + r * lda);
+					}
+				}
+			});
+		}
+
+		/// <summary>
+		/// Transposes a rows x cols matrix stored contiguously in place by following the cycles of the permutation
+		/// </summary>
+		/// <remarks>Needs one bit per element of extra memory, but jumps around memory so it is much slower than going through a copy</remarks>
+		template<class T>
+		void transposeCycles(int rows, int cols, T* a) {
+			size_t count = static_cast<size_t>(rows) * cols;
+			if (count < 3)
+				return;
+			std::vector<bool> visited(count);
+			// the element at p = r * cols + c ends up at c * rows + r, the first and last never move
+			for (size_t start = 1; start + 1 < count; start++) {
+				if (visited[start])
+					continue;
+				T carry = std::move(a[start]);
+				size_t p = start;
+				do {
+					size_t next = (p % cols) * rows + p / cols;
+					std::swap(carry, a[next]);
+					visited[next] = true;
+					p = next;
+				} while (p != start);
+			}
+		}
+	}
+}
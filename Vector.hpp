@@ -0,0 +1,300 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <initializer_list>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "Allocators.hpp"
+#include "Expression.hpp"
+#include "Instrumentation.hpp"
+#include "Precision.hpp"
+#include "Simd.hpp"
+#include "TextFormat.hpp"
+#include "ThreadPool.hpp"
+
+namespace matrices {
+
+	/// <summary>
+	/// A column of numbers, what a matrix is multiplied with in A * x
+	/// </summary>
+	/// <remarks>
+	/// Takes part in expressions as a matrix with one column, so u + v * 2 is evaluated in one pass and
+	/// Matrix(v) gives the column. The elements are aligned like a Matrix's for the vector kernels
+	/// </remarks>
+	template<class T, class alloc = AlignedAllocator<T>>
+	class Vector : public MatrixExpression<Vector<T, alloc>> {
+
+	public:
+		using value_type = T;
+		using allocator_type = alloc;
+		using storage_type = std::vector<T, alloc>;
+		static constexpr bool isExpressionLeaf = true;
+
+		storage_type inner_;
+
+		/// <summary>
+		/// A vector of size zeros
+		/// </summary>
+		/// <param name="allocator">Where the elements are stored, e.g. an ArenaAllocator on a particular Arena</param>
+		explicit Vector(int size, const alloc& allocator = alloc())
+			: inner_(static_cast<size_t>(size), T(), allocator) {}
+
+		/// <summary>
+		/// A vector with every element set to value
+		/// </summary>
+		Vector(int size, T value, const alloc& allocator = alloc())
+			: inner_(static_cast<size_t>(size), value, allocator) {}
+
+		Vector(std::initializer_list<T> values, const alloc& allocator = alloc())
+			: inner_(values, allocator) {}
+
+		/// <summary>
+		/// Copies the elements of a std::vector, e.g. the right hand side given to solve
+		/// </summary>
+		template<class A>
+		explicit Vector(const std::vector<T, A>& values, const alloc& allocator = alloc())
+			: inner_(values.begin(), values.end(), allocator) {
+			detail::recordCopy(inner_.size() * sizeof(T));
+		}
+
+		Vector(const Vector& other)
+			: inner_(other.inner_) {
+			detail::recordCopy(inner_.size() * sizeof(T));
+		}
+
+		Vector(Vector&&) noexcept = default;
+
+		Vector& operator=(const Vector& other) {
+			inner_ = other.inner_;
+			detail::recordCopy(inner_.size() * sizeof(T));
+			return *this;
+		}
+
+		Vector& operator=(Vector&&) noexcept = default;
+
+		/// <summary>
+		/// Evaluates an expression with a single column, such as u + v * 2, into a new vector
+		/// </summary>
+		/// <remarks>Throws std::invalid_argument if the expression has more than one column</remarks>
+		template<class E>
+		Vector(const MatrixExpression<E>& expression, const alloc& allocator = alloc())
+			: inner_(allocator) {
+			const E& e = expression.self();
+			if (e.columns() != 1)
+				throw std::invalid_argument("Matrix dimensions do not match");
+			inner_.resize(static_cast<size_t>(e.rows()));
+			assign(e);
+		}
+
+		/// <summary>
+		/// Evaluates an expression with a single column into this vector, resizing it if the length differs
+		/// </summary>
+		/// <param name="expression">The expression to evaluate, it may refer to this vector</param>
+		/// <returns>This vector</returns>
+		template<class E>
+		Vector& operator=(const MatrixExpression<E>& expression) {
+			const E& e = expression.self();
+			if (e.columns() != 1)
+				throw std::invalid_argument("Matrix dimensions do not match");
+			if (e.rows() != size()) {
+				Vector temp(e, inner_.get_allocator());
+				*this = std::move(temp);
+				return *this;
+			}
+			assign(e);
+			return *this;
+		}
+
+		/// <summary>
+		/// Number of elements
+		/// </summary>
+		int size() const {
+			return static_cast<int>(inner_.size());
+		}
+
+		/// <summary>
+		/// Always 1, used when the vector is part of an expression
+		/// </summary>
+		int columns() const {
+			return 1;
+		}
+
+		/// <summary>
+		/// Number of elements, used when the vector is part of an expression
+		/// </summary>
+		int rows() const {
+			return size();
+		}
+
+		/// <summary>
+		/// Unchecked read of element row, used when the vector is part of an expression
+		/// </summary>
+		const T& elementAt(int, int row) const {
+			return inner_[row];
+		}
+
+		/// <summary>
+		/// Unchecked access to an element
+		/// </summary>
+		T& operator[](int index) {
+			return inner_[index];
+		}
+
+		const T& operator[](int index) const {
+			return inner_[index];
+		}
+
+		/// <summary>
+		/// Returns the element at index
+		/// </summary>
+		/// <remarks>Will throw an error if out of range</remarks>
+		T& at(int index) {
+			if (index < 0 || index >= size())
+				throw std::out_of_range("Index out of range");
+			return inner_[index];
+		}
+
+		const T& at(int index) const {
+			if (index < 0 || index >= size())
+				throw std::out_of_range("Index out of range");
+			return inner_[index];
+		}
+
+		T* data() {
+			return inner_.data();
+		}
+
+		const T* data() const {
+			return inner_.data();
+		}
+
+		typename storage_type::iterator begin() {
+			return inner_.begin();
+		}
+
+		typename storage_type::iterator end() {
+			return inner_.end();
+		}
+
+		typename storage_type::const_iterator begin() const {
+			return inner_.begin();
+		}
+
+		typename storage_type::const_iterator end() const {
+			return inner_.end();
+		}
+
+		/// <summary>
+		/// Sets every element to value
+		/// </summary>
+		void fill(T value) {
+			detail::simd::fill(inner_.data(), value, inner_.size());
+		}
+
+		/// <summary>
+		/// Sum of the products of the elements of this vector and other
+		/// </summary>
+		/// <remarks>Throws std::invalid_argument if the lengths differ, the 16 bit floats and small integers sum in float and int32</remarks>
+		template<class B>
+		T dot(const Vector<T, B>& other) const {
+			if (other.size() != size())
+				throw std::invalid_argument("Matrix dimensions do not match");
+			using Acc = detail::AccumulatorType<T>;
+			if constexpr (std::is_same<Acc, T>::value) {
+				return detail::simd::kernels<T>().dot(inner_.data(), other.inner_.data(), inner_.size());
+			}
+			else {
+				Acc sum = Acc();
+				for (size_t i = 0; i < inner_.size(); i++)
+					sum += static_cast<Acc>(inner_[i]) * static_cast<Acc>(other.inner_[i]);
+				return static_cast<T>(sum);
+			}
+		}
+
+		/// <summary>
+		/// Euclidean length of the vector
+		/// </summary>
+		double norm() const {
+			return std::sqrt(detail::simd::sumSquares(inner_.data(), inner_.size()));
+		}
+
+		/// <summary>
+		/// Adds a vector or an expression with one column to this vector in place
+		/// </summary>
+		/// <returns>This vector</returns>
+		template<class E>
+		Vector& operator+=(const MatrixExpression<E>& arg) {
+			assign(*this + arg.self());
+			return *this;
+		}
+
+		/// <summary>
+		/// Subtracts a vector or an expression with one column from this vector in place
+		/// </summary>
+		/// <returns>This vector</returns>
+		template<class E>
+		Vector& operator-=(const MatrixExpression<E>& arg) {
+			assign(*this - arg.self());
+			return *this;
+		}
+
+		/// <summary>
+		/// Multiplies every element by a scalar in place
+		/// </summary>
+		/// <returns>This vector</returns>
+		template<class S, typename std::enable_if<std::is_arithmetic<S>::value, int>::type = 0>
+		Vector& operator*=(S arg) {
+			assign(*this * arg);
+			return *this;
+		}
+
+		/// <summary>
+		/// Writes the vector into a string as a column, by default in the same format as operator<<
+		/// </summary>
+		/// <param name="format">Brackets, delimiters and precision, e.g. TextFormat::csv()</param>
+		std::string toString(const TextFormat& format = TextFormat()) const {
+			return detail::toText(inner_.data(), 1, size(), 1, 1, format);
+		}
+
+		/// <summary>
+		/// Streams the vector straight to os as a column without building a string first
+		/// </summary>
+		/// <param name="format">Brackets, delimiters and precision, e.g. TextFormat::csv()</param>
+		void print(std::ostream& os, const TextFormat& format = TextFormat()) const {
+			detail::writeText(os, inner_.data(), 1, size(), 1, 1, format);
+		}
+
+		/// <summary>
+		/// Writes every element of an expression of the same length into this vector
+		/// </summary>
+		/// <param name="e">The expression, it may read from this vector as every element only depends on its own position</param>
+		/// <remarks>A plain sum or difference of two vectors goes to the vector kernels, anything else is one fused loop</remarks>
+		template<class E>
+		void assign(const E& e) {
+			detail::OperationScope scope(Operation::Arithmetic, static_cast<double>(inner_.size()));
+			if constexpr (detail::IsBinaryOfLeaves<E, Vector, detail::AddOp>::value) {
+				detail::simd::add(e.left().inner_.data(), e.right().inner_.data(), inner_.data(), inner_.size());
+			}
+			else if constexpr (detail::IsBinaryOfLeaves<E, Vector, detail::SubOp>::value) {
+				detail::simd::sub(e.left().inner_.data(), e.right().inner_.data(), inner_.data(), inner_.size());
+			}
+			else {
+				T* out = inner_.data();
+				detail::parallelFor(0, size(), detail::simd::ParallelChunk, inner_.size(), [&](std::ptrdiff_t first, std::ptrdiff_t last) {
+					for (std::ptrdiff_t row = first; row < last; row++)
+						out[row] = static_cast<T>(e.elementAt(0, static_cast<int>(row)));
+				});
+			}
+		}
+
+		friend std::ostream& operator<<(std::ostream& os, const Vector& vector) {
+			vector.print(os);
+			return os;
+		}
+	};
+}
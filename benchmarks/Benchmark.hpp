@@ -0,0 +1,101 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace benchmark {
+
+	/// <summary>
+	/// Timing of one operation at one size and element type
+	/// </summary>
+	struct Result {
+		std::string name;
+		std::string type;
+		int size;
+		double best;     // seconds per call, fastest sample
+		double median;   // seconds per call, median sample
+		double flops;    // floating point operations per call, 0 if it isn't arithmetic
+		double bytes;    // bytes read and written per call
+		size_t calls;    // total calls timed
+
+		double gflops() const { return flops / median * 1e-9; }
+		double gbytes() const { return bytes / median * 1e-9; }
+	};
+
+	/// <summary>
+	/// Stops the compiler throwing away a result that is never used
+	/// </summary>
+	template<class T>
+	inline void keep(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+		asm volatile("" : : "g"(&value) : "memory");
+#else
+		static const void* volatile sink;
+		sink = &value;
+#endif
+	}
+
+	/// <summary>
+	/// Calls body until every sample takes at least sampleTime seconds and reports the time per call
+	/// </summary>
+	/// <remarks>The first call is a warm up and isn't timed, so pools, caches and pages are ready</remarks>
+	template<class F>
+	Result measure(const std::string& name, const std::string& type, int size, double flops, double bytes,
+		double sampleTime, int samples, F&& body) {
+		using clock = std::chrono::steady_clock;
+		body();
+
+		size_t calls = 1;
+		for (;;) {
+			auto start = clock::now();
+			for (size_t i = 0; i < calls; i++)
+				body();
+			double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+			if (elapsed >= sampleTime || calls >= (size_t(1) << 30))
+				break;
+			calls = elapsed <= 0 ? calls * 10 : std::max(calls + 1, static_cast<size_t>(calls * sampleTime / elapsed * 1.2));
+		}
+
+		std::vector<double> times;
+		for (int sample = 0; sample < samples; sample++) {
+			auto start = clock::now();
+			for (size_t i = 0; i < calls; i++)
+				body();
+			times.push_back(std::chrono::duration<double>(clock::now() - start).count() / calls);
+		}
+		std::sort(times.begin(), times.end());
+		return { name, type, size, times.front(), times[times.size() / 2], flops, bytes, calls * samples };
+	}
+
+	inline void printHeader(std::FILE* out) {
+		std::fprintf(out, "%-22s %-7s %7s %12s %12s %10s %10s\n", "benchmark", "type", "size", "best (us)", "median (us)", "GFLOP/s", "GB/s");
+	}
+
+	inline void print(std::FILE* out, const Result& result) {
+		std::fprintf(out, "%-22s %-7s %7d %12.2f %12.2f %10.2f %10.2f\n", result.name.c_str(), result.type.c_str(), result.size,
+			result.best * 1e6, result.median * 1e6, result.gflops(), result.gbytes());
+		std::fflush(out);
+	}
+
+	/// <summary>
+	/// Writes every result as a JSON document that can be compared between commits
+	/// </summary>
+	inline void writeJson(std::ostream& os, const std::vector<Result>& results, const std::string& compiler, unsigned threads) {
+		os << "{\n  \"compiler\": \"" << compiler << "\",\n  \"threads\": " << threads << ",\n  \"results\": [\n";
+		char line[512];
+		for (size_t i = 0; i < results.size(); i++) {
+			const Result& r = results[i];
+			std::snprintf(line, sizeof(line),
+				"    { \"name\": \"%s\", \"type\": \"%s\", \"size\": %d, \"best_s\": %.9g, \"median_s\": %.9g, "
+				"\"flops\": %.17g, \"bytes\": %.17g, \"gflops\": %.6g, \"gbytes\": %.6g, \"calls\": %zu }%s\n",
+				r.name.c_str(), r.type.c_str(), r.size, r.best, r.median, r.flops, r.bytes, r.gflops(), r.gbytes(),
+				r.calls, i + 1 < results.size() ? "," : "");
+			os << line;
+		}
+		os << "  ]\n}\n";
+	}
+}
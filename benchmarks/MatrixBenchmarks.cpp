@@ -0,0 +1,284 @@
+// Benchmarks for the hot paths of Matrix, nothing outside the repository is needed
+//
+//   g++ -std=c++17 -O3 -march=native -pthread benchmarks/MatrixBenchmarks.cpp -o matrix-benchmarks
+//   ./matrix-benchmarks [--quick] [--filter=multiply] [--time=0.05] [--json=results.json]
+//
+// Every benchmark is run for a range of sizes and element types, the table goes to stdout and
+// --json writes the same numbers in a form that can be compared across commits
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../Matrix.hpp"
+#include "Benchmark.hpp"
+
+namespace {
+
+	/// <summary>
+	/// Stands in for a ROOT TH1 and TH2, it only adds up the weights in each bin
+	/// </summary>
+	struct MockHistogram {
+		explicit MockHistogram(int bins)
+			: weights(static_cast<size_t>(bins) * bins) {}
+
+		void Fill(double x, double w) {
+			weights[static_cast<size_t>(x)] += w;
+		}
+
+		void Fill(double x, double y, double w) {
+			weights[static_cast<size_t>(x) + static_cast<size_t>(y) * stride] += w;
+		}
+
+		void FillN(int n, const double* x, const double* w) {
+			for (int i = 0; i < n; i++)
+				Fill(x[i], w[i]);
+		}
+
+		void FillN(int n, const double* x, const double* y, const double* w) {
+			for (int i = 0; i < n; i++)
+				Fill(x[i], y[i], w[i]);
+		}
+
+		std::vector<double> weights;
+		size_t stride = 0;
+	};
+
+	struct Options {
+		bool quick = false;
+		double sampleTime = 0.05;
+		int samples = 5;
+		std::string filter;
+		std::string json;
+	};
+
+	template<class T> const char* typeName();
+	template<> const char* typeName<float>() { return "float"; }
+	template<> const char* typeName<double>() { return "double"; }
+	template<> const char* typeName<int>() { return "int"; }
+	template<> const char* typeName<matrices::bfloat16>() { return "bfloat16"; }
+	template<> const char* typeName<matrices::half>() { return "half"; }
+
+	/// <summary>
+	/// An n x n matrix of values between -1 and 1, or -10 and 10 for integers, with a heavy diagonal so it can always be inverted
+	/// </summary>
+	template<class T>
+	matrices::Matrix<T> randomMatrix(int n, unsigned seed) {
+		std::mt19937 generator(seed);
+		std::uniform_real_distribution<double> distribution(-1, 1);
+		matrices::Matrix<T> m(n, n);
+		for (auto& element : m.inner_)
+			element = static_cast<T>(!std::is_integral<T>::value ? distribution(generator) : distribution(generator) * 10);
+		for (int i = 0; i < n; i++)
+			m.inner_[static_cast<size_t>(i) * n + i] += static_cast<T>(n);
+		return m;
+	}
+
+	class Runner {
+	public:
+		explicit Runner(const Options& options)
+			: options_(options) {}
+
+		template<class F>
+		void run(const std::string& name, const char* type, int size, double flops, double bytes, F&& body) {
+			if (!options_.filter.empty() && name.find(options_.filter) == std::string::npos)
+				return;
+			results_.push_back(benchmark::measure(name, type, size, flops, bytes, options_.sampleTime, options_.samples, body));
+			benchmark::print(stdout, results_.back());
+		}
+
+		const std::vector<benchmark::Result>& results() const { return results_; }
+		const Options& options() const { return options_; }
+
+	private:
+		Options options_;
+		std::vector<benchmark::Result> results_;
+	};
+
+	std::vector<int> cubicSizes(const Options& options) {
+		return options.quick ? std::vector<int>{ 32, 256 } : std::vector<int>{ 16, 64, 256, 512, 1024 };
+	}
+
+	std::vector<int> squareSizes(const Options& options) {
+		return options.quick ? std::vector<int>{ 64, 1024 } : std::vector<int>{ 64, 256, 1024, 2048, 4096 };
+	}
+
+	template<class T>
+	void arithmetic(Runner& runner) {
+		const char* type = typeName<T>();
+		double s = sizeof(T);
+		for (int n : cubicSizes(runner.options())) {
+			auto a = randomMatrix<T>(n, 1), b = randomMatrix<T>(n, 2);
+			matrices::Matrix<T> c(n, n);
+			double n3 = static_cast<double>(n) * n * n;
+			runner.run("multiply", type, n, 2 * n3, 3 * s * n * n, [&] { c = a * b; benchmark::keep(c); });
+			if (std::is_floating_point<T>::value && n >= 256) {
+				// one level of Strassen-Winograd, GFLOP/s is worked out from the classical flop count
+				int threshold = matrices::getStrassenThreshold();
+				matrices::setStrassenThreshold(n);
+				runner.run("multiply_strassen", type, n, 2 * n3, 3 * s * n * n, [&] { c = a * b; benchmark::keep(c); });
+				matrices::setStrassenThreshold(threshold);
+			}
+		}
+		for (int n : squareSizes(runner.options())) {
+			auto a = randomMatrix<T>(n, 1), b = randomMatrix<T>(n, 2);
+			matrices::Matrix<T> c(n, n);
+			double n2 = static_cast<double>(n) * n;
+			runner.run("add", type, n, n2, 3 * s * n2, [&] { c = a + b; benchmark::keep(c); });
+			runner.run("subtract", type, n, n2, 3 * s * n2, [&] { c = a - b; benchmark::keep(c); });
+			runner.run("add_subtract_scale", type, n, 3 * n2, 3 * s * n2, [&] { c = a + b - a * 2; benchmark::keep(c); });
+			runner.run("add_assign", type, n, n2, 3 * s * n2, [&] { c += a; benchmark::keep(c); });
+			runner.run("transpose", type, n, 0, 2 * s * n2, [&] { a.transpose(); benchmark::keep(a); });
+			runner.run("transposed", type, n, 0, 2 * s * n2, [&] { c = b.transposed(); benchmark::keep(c); });
+			runner.run("operator[]", type, n, n2, s * n2, [&] {
+				T sum = T();
+				for (int row = 0; row < n; row++)
+					for (int col = 0; col < n; col++)
+						sum += a[col][row];
+				benchmark::keep(sum);
+			});
+		}
+	}
+
+	void precision(Runner& runner) {
+		for (int n : cubicSizes(runner.options())) {
+			auto a = randomMatrix<float>(n, 1), b = randomMatrix<float>(n, 2);
+			matrices::Matrix<float> c(n, n);
+			double n3 = static_cast<double>(n) * n * n;
+			runner.run("multiply_double_accumulate", "float", n, 2 * n3, 12.0 * n * n, [&] { matrices::multiply<double>(a, b, c); benchmark::keep(c); });
+			auto qa = matrices::quantize(a), qb = matrices::quantize(b);
+			runner.run("multiply_quantized", "int8", n, 2 * n3, 6.0 * n * n, [&] { c = qa * qb; benchmark::keep(c); });
+		}
+	}
+
+	template<class T>
+	void matrixVector(Runner& runner) {
+		const char* type = typeName<T>();
+		double s = sizeof(T);
+		const int batch = 16;
+		for (int n : squareSizes(runner.options())) {
+			auto a = randomMatrix<T>(n, 1);
+			matrices::Vector<T> x(n, T(1)), y(n);
+			double n2 = static_cast<double>(n) * n;
+			runner.run("gemv", type, n, 2 * n2, s * n2, [&] { matrices::multiply(a, x, y); benchmark::keep(y); });
+			runner.run("gemv_transposed", type, n, 2 * n2, s * n2, [&] { matrices::multiplyTransposed(a, x, y); benchmark::keep(y); });
+			std::vector<matrices::Vector<T>> xs(batch, x);
+			runner.run("gemv_batched", type, n, 2 * n2 * batch, s * n2, [&] { auto ys = matrices::multiply(a, xs); benchmark::keep(ys); });
+		}
+	}
+
+	template<class T>
+	void factorisations(Runner& runner) {
+		const char* type = typeName<T>();
+		double s = sizeof(T);
+		for (int n : cubicSizes(runner.options())) {
+			auto a = randomMatrix<T>(n, 3);
+			double n3 = static_cast<double>(n) * n * n;
+			runner.run("getDeterminant", type, n, 2 * n3 / 3, 2 * s * n * n, [&] { a.invalidate(); double det = a.getDeterminant(); benchmark::keep(det); });
+			runner.run("getDeterminant_cached", type, n, 0, 0, [&] { double det = a.getDeterminant(); benchmark::keep(det); });
+			runner.run("invert", type, n, 2 * n3, 2 * s * n * n, [&] { a.invert(); benchmark::keep(a); });
+			auto b = randomMatrix<T>(n, 7);
+			matrices::Matrix<T> x(n, n);
+			runner.run("solve", type, n, 8 * n3 / 3, 3 * s * n * n, [&] { a.invalidate(); x = matrices::solve(a, b); benchmark::keep(x); });
+			auto spd = a.transposed() * a;
+			runner.run("solve_cholesky", type, n, 7 * n3 / 3, 3 * s * n * n, [&] { spd.invalidate(); x = matrices::solve(spd, b, matrices::Solver::Cholesky); benchmark::keep(x); });
+			runner.run("getEigenvalues", type, n, 4 * n3 / 3, s * n * n, [&] { auto values = spd.getEigenvalues(); benchmark::keep(values); });
+			runner.run("eigenSystem", type, n, 9 * n3, 2 * s * n * n, [&] { auto system = matrices::eigenSystem(spd); benchmark::keep(system); });
+		}
+		for (int n : squareSizes(runner.options())) {
+			auto a = randomMatrix<T>(n, 4);
+			double n2 = static_cast<double>(n) * n;
+			runner.run("normalise", type, n, 3 * n2, 3 * s * n2, [&] { a.inner_[0] += 1; a.normalise(); benchmark::keep(a); });
+		}
+	}
+
+	template<class T>
+	void output(Runner& runner) {
+		const char* type = typeName<T>();
+		for (int n : squareSizes(runner.options())) {
+			if (n > 1024)
+				continue;
+			auto a = randomMatrix<T>(n, 5);
+			double bytes = static_cast<double>(a.toString().size());
+			runner.run("toString", type, n, 0, bytes, [&] { std::string text = a.toString(); benchmark::keep(text); });
+		}
+	}
+
+	template<class T>
+	void histograms(Runner& runner) {
+		const char* type = typeName<T>();
+		double s = sizeof(T);
+		for (int n : squareSizes(runner.options())) {
+			auto a = randomMatrix<T>(n, 6);
+			double n2 = static_cast<double>(n) * n;
+			MockHistogram hist(n);
+			hist.stride = static_cast<size_t>(n);
+			runner.run("fillHistogram", type, n, 0, s * n2, [&] { a.fillHistogram(&hist, 1); benchmark::keep(hist); });
+			runner.run("fill2DHistogram", type, n, 0, s * n2, [&] { a.fill2DHistogram(&hist, 1); benchmark::keep(hist); });
+		}
+	}
+
+	Options parse(int argc, char** argv) {
+		Options options;
+		for (int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			if (arg == "--quick")
+				options.quick = true;
+			else if (arg.rfind("--filter=", 0) == 0)
+				options.filter = arg.substr(9);
+			else if (arg.rfind("--time=", 0) == 0)
+				options.sampleTime = std::atof(arg.c_str() + 7);
+			else if (arg.rfind("--json=", 0) == 0)
+				options.json = arg.substr(7);
+			else {
+				std::fprintf(stderr, "usage: %s [--quick] [--filter=name] [--time=seconds per sample] [--json=file]\n", argv[0]);
+				std::exit(1);
+			}
+		}
+		if (options.quick)
+			options.sampleTime = std::min(options.sampleTime, 0.01);
+		return options;
+	}
+
+	std::string compilerName() {
+#if defined(__clang__)
+		return "clang " __clang_version__;
+#elif defined(__GNUC__)
+		return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+		return "msvc " + std::to_string(_MSC_VER);
+#else
+		return "unknown";
+#endif
+	}
+}
+
+int main(int argc, char** argv) {
+	Runner runner(parse(argc, argv));
+	benchmark::printHeader(stdout);
+
+	arithmetic<float>(runner);
+	arithmetic<double>(runner);
+	arithmetic<int>(runner);
+	arithmetic<matrices::bfloat16>(runner);
+	arithmetic<matrices::half>(runner);
+	precision(runner);
+	matrixVector<float>(runner);
+	matrixVector<double>(runner);
+	factorisations<float>(runner);
+	factorisations<double>(runner);
+	output<double>(runner);
+	output<int>(runner);
+	histograms<double>(runner);
+	histograms<int>(runner);
+
+	if (!runner.options().json.empty()) {
+		std::ofstream json(runner.options().json);
+		benchmark::writeJson(json, runner.results(), compilerName(), matrices::detail::threadPool().size());
+	}
+	return 0;
+}
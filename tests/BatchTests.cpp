@@ -0,0 +1,73 @@
+// Batches of small matrices against the same operations one matrix at a time
+
+#include <cmath>
+#include <vector>
+
+#include "Testing.hpp"
+
+namespace {
+
+	using namespace testing;
+
+	template<class T, int N>
+	void batchOf(size_t size, double tolerance) {
+		matrices::MatrixBatch<T, N, N> batch(size);
+		std::vector<matrices::Matrix<double>> originals;
+		for (size_t i = 0; i < size; i++) {
+			auto m = randomMatrix<double>(N, N, static_cast<unsigned>(50 + i));
+			for (int d = 0; d < N; d++)
+				m.inner_[static_cast<size_t>(d) * N + d] += 2;
+			typename matrices::MatrixBatch<T, N, N>::matrix_type fixed;
+			for (int e = 0; e < N * N; e++)
+				fixed.inner_[e] = static_cast<T>(m.inner_[e]);
+			batch.set(i, fixed);
+			originals.push_back(m);
+		}
+
+		auto determinants = batch.determinants();
+		for (size_t i = 0; i < size; i++)
+			CHECK(std::abs(determinants[i] - originals[i].getDeterminant()) <= tolerance * std::abs(originals[i].getDeterminant()));
+
+		auto squared = batch * batch;
+		for (size_t i = 0; i < size; i++)
+			CHECK(maxDifference(squared.get(i), naiveProduct(originals[i], originals[i])) <= tolerance * 10);
+
+		CHECK(batch.invert() == 0);
+		for (size_t i = 0; i < size; i++)
+			CHECK(maxDifference(naiveProduct(originals[i], batch.get(i)), identity(N)) <= tolerance * 100);
+	}
+
+	void batches() {
+		batchOf<double, 2>(37, 1e-12);
+		batchOf<double, 3>(37, 1e-12);
+		batchOf<double, 4>(37, 1e-12);
+		batchOf<double, 5>(9, 1e-12);
+		batchOf<float, 4>(37, 1e-4);
+		batchOf<float, 6>(17, 1e-4);
+
+		// exactly singular matrices have a determinant of 0, not NaN
+		matrices::MatrixBatch<double, 4, 4> ones(3);
+		ones.fill(1);
+		matrices::MatrixBatch<float, 5, 5> zeros(3);
+		for (double det : ones.determinants())
+			CHECK(det == 0);
+		for (float det : zeros.determinants())
+			CHECK(det == 0);
+		CHECK(ones.invert() == 3);
+
+		matrices::MatrixBatch<double, 3, 3> small(5);
+		CHECK_THROWS(small.get(5), std::out_of_range);
+		matrices::MatrixBatch<double, 3, 3> shorter(4);
+		CHECK_THROWS(small * shorter, std::invalid_argument);
+
+		// matrices that come back after a shrink are 0 like any other new ones
+		small.fill(5);
+		small.resize(2);
+		small.resize(7);
+		for (size_t index = 2; index < 7; index++)
+			CHECK(small.get(index).getAt(2, 2) == 0);
+		CHECK(small.get(1).getAt(2, 2) == 5);
+	}
+
+	Registration batchesTest("batches", batches);
+}
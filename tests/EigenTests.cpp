@@ -0,0 +1,34 @@
+// Symmetric eigensystems checked by reconstruction and orthogonality
+
+#include <algorithm>
+#include <cmath>
+
+#include "Testing.hpp"
+
+namespace {
+
+	using namespace testing;
+
+	void eigenvalues() {
+		unsigned seed = 40;
+		for (int n : { 1, 4, 8, 9, 40, 130 }) {
+			auto a = randomSpd(n, seed++);
+			auto system = matrices::eigenSystem(a);
+			matrices::Matrix<double> scaled = system.vectors;
+			for (int row = 0; row < n; row++)
+				for (int col = 0; col < n; col++)
+					scaled.inner_[static_cast<size_t>(row) * n + col] *= system.values[col];
+			CHECK(maxDifference(a * system.vectors, scaled) <= 1e-10 * n);
+			CHECK(maxDifference(system.vectors.view().transposed() * system.vectors, identity(n)) <= 1e-12 * n);
+			CHECK(std::is_sorted(system.values.begin(), system.values.end()));
+
+			auto values = a.getEigenvalues();
+			double worst = 0;
+			for (int i = 0; i < n; i++)
+				worst = std::max(worst, std::abs(values[i] - system.values[i]));
+			CHECK(worst <= 1e-10 * n);
+		}
+	}
+
+	Registration eigenvaluesTest("eigenvalues", eigenvalues);
+}
@@ -0,0 +1,28 @@
+// Lazy expressions, including ones that read the matrix or vector they're assigned to
+
+#include "Testing.hpp"
+
+namespace {
+
+	using namespace testing;
+
+	void expressions() {
+		auto a = randomMatrix<double>(5, 4, 70), b = randomMatrix<double>(5, 4, 71);
+		matrices::Matrix<double> expected(5, 4);
+		for (size_t i = 0; i < expected.inner_.size(); i++)
+			expected.inner_[i] = (a.inner_[i] + b.inner_[i]) * 2 - b.inner_[i];
+		auto c = a;
+		c = c + b;
+		c = c * 2 - b;
+		CHECK(maxDifference(c, expected) == 0);
+		c = a;
+		c += c;
+		CHECK(maxDifference(c, a * 2.0) == 0);
+
+		matrices::Vector<double> u = { 1, 2, 3 };
+		u = u + u * 2.0;
+		CHECK(u[0] == 3 && u[1] == 6 && u[2] == 9);
+	}
+
+	Registration expressionsTest("expressions", expressions);
+}
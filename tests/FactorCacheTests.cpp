@@ -0,0 +1,92 @@
+// Cached factorisations, determinant, trace and norms, which every way of changing a matrix has to forget
+
+#include <cstring>
+#include <vector>
+
+#include "Testing.hpp"
+
+namespace {
+
+	using namespace testing;
+
+	/// <summary>
+	/// Asks for everything the cache keeps, so it all has to be worked out again after a change
+	/// </summary>
+	void fillCache(const matrices::Matrix<double>& m) {
+		m.getDeterminant();
+		m.getTrace();
+		m.getNorm();
+		m.luFactors();
+		m.choleskyFactors();
+	}
+
+	/// <summary>
+	/// True if everything m has cached matches what a matrix built from scratch with the same elements works out
+	/// </summary>
+	bool matchesFresh(const matrices::Matrix<double>& m) {
+		matrices::Matrix<double> fresh(m.columns(), m.rows());
+		std::memcpy(fresh.inner_.data(), m.inner_.data(), m.inner_.size() * sizeof(double));
+		bool same = m.getDeterminant() == fresh.getDeterminant() && m.getTrace() == fresh.getTrace();
+		for (matrices::Norm norm : { matrices::Norm::Frobenius, matrices::Norm::One, matrices::Norm::Infinity, matrices::Norm::Max })
+			same = same && m.getNorm(norm) == fresh.getNorm(norm);
+		same = same && m.luFactors()->lu == fresh.luFactors()->lu && m.luFactors()->pivots == fresh.luFactors()->pivots;
+		same = same && m.choleskyFactors()->info == fresh.choleskyFactors()->info && m.choleskyFactors()->l == fresh.choleskyFactors()->l;
+		return same;
+	}
+
+	/// <summary>
+	/// Fills the cache of a random non symmetric matrix, changes it with mutate and checks nothing stale is left
+	/// </summary>
+	template<class F>
+	void checkForgets(const char* how, const F& mutate) {
+		auto m = randomSpd(6, 90);
+		m.inner_[1] += 0.5;
+		fillCache(m);
+		mutate(m);
+		testing::check(matchesFresh(m), how, testing::currentTest, __LINE__);
+	}
+
+	void factorCache() {
+		auto m = randomSpd(6, 90);
+		CHECK(matchesFresh(m));
+		fillCache(m);
+		CHECK(matchesFresh(m));
+		// a copy can share what's cached, but changing it mustn't change the original's
+		auto copy = m;
+		copy.fill(2);
+		CHECK(matchesFresh(m) && matchesFresh(copy));
+
+		auto other = randomMatrix<double>(6, 6, 91);
+		checkForgets("add", [](matrices::Matrix<double>& a) { a.add(3, 2, 4); });
+		checkForgets("fill", [](matrices::Matrix<double>& a) { a.fill(0.25); });
+		checkForgets("getAt", [](matrices::Matrix<double>& a) { a.getAt(4, 2) += 1; });
+		checkForgets("+=", [&](matrices::Matrix<double>& a) { a += other; });
+		checkForgets("-=", [&](matrices::Matrix<double>& a) { a -= other * 0.5; });
+		checkForgets("*= matrix", [&](matrices::Matrix<double>& a) { a *= other; });
+		checkForgets("*= scalar", [](matrices::Matrix<double>& a) { a *= 3.0; });
+		checkForgets("/=", [](matrices::Matrix<double>& a) { a /= 4.0; });
+		checkForgets("= expression", [&](matrices::Matrix<double>& a) { a = a + other; });
+		checkForgets("transpose", [](matrices::Matrix<double>& a) { a.transpose(); });
+		checkForgets("invert", [](matrices::Matrix<double>& a) { a.invert(); });
+		checkForgets("view", [](matrices::Matrix<double>& a) { a.view().elementAt(1, 3) = 7; });
+		checkForgets("row", [](matrices::Matrix<double>& a) { a.row(2).fill(1); });
+		checkForgets("column", [](matrices::Matrix<double>& a) { a.column(0).fill(-1); });
+		checkForgets("block", [](matrices::Matrix<double>& a) { a.block(1, 1, 2, 3).fill(0); });
+		checkForgets("diagonal", [](matrices::Matrix<double>& a) { a.diagonal().fill(9); });
+		checkForgets("invalidate", [](matrices::Matrix<double>& a) {
+			a.inner_[7] = 5;
+			a.invalidate();
+		});
+
+		// a view kept from before the query doesn't know about the cache, invalidate catches up
+		auto kept = randomSpd(6, 92);
+		auto view = kept.view();
+		fillCache(kept);
+		view.elementAt(0, 0) = 100;
+		CHECK(!matchesFresh(kept));
+		kept.invalidate();
+		CHECK(matchesFresh(kept));
+	}
+
+	Registration factorCacheTest("factorCache", factorCache);
+}
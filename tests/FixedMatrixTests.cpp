@@ -0,0 +1,73 @@
+// Fixed size matrices against the dynamic Matrix with the same elements
+
+#include <cmath>
+
+#include "Testing.hpp"
+
+namespace {
+
+	using namespace testing;
+
+	template<class T, int N>
+	void squareOf(unsigned seed, double tolerance) {
+		auto m = randomMatrix<double>(N, N, seed);
+		for (int i = 0; i < N; i++)
+			m.inner_[static_cast<size_t>(i) * N + i] += 2;
+		matrices::Matrix<T> narrow = m;
+		matrices::FixedMatrix<T, N, N> fixed(narrow);
+		CHECK(maxDifference(fixed, narrow) == 0);
+
+		double det = narrow.getDeterminant();
+		CHECK(std::abs(fixed.getDeterminant() - det) <= tolerance * std::abs(det));
+
+		// closed form up to 4x4 and LU above, the inverse of the dynamic matrix is always LU
+		auto inverse = narrow;
+		inverse.invert();
+		CHECK(maxDifference(fixed.inverse(), inverse) <= tolerance * 10);
+		CHECK(maxDifference(naiveProduct(fixed, fixed.inverse()), identity(N)) <= tolerance * 10);
+
+		CHECK(maxDifference(fixed * fixed, naiveProduct(narrow, narrow)) <= tolerance);
+		matrices::Matrix<T> back(fixed * T(2) - fixed);
+		CHECK(maxDifference(back, narrow) == 0);
+
+		// a zero row gives an exact 0 through the closed forms and LU alike
+		auto singular = fixed;
+		for (int i = 0; i < N; i++)
+			singular.getAt(i, N / 2) = 0;
+		CHECK(singular.getDeterminant() == 0);
+		CHECK_THROWS(singular.invert(), std::invalid_argument);
+	}
+
+	template<int R, int C>
+	void transposeOf(unsigned seed) {
+		auto m = randomMatrix<int>(C, R, seed);
+		matrices::FixedMatrix<int, R, C> fixed(m);
+		matrices::FixedMatrix<int, C, R> transposed = fixed.transposed();
+		CHECK(maxDifference(transposed, m.transposed()) == 0);
+		CHECK(transposed.transposed() == fixed);
+	}
+
+	void fixedMatrices() {
+		squareOf<double, 1>(110, 1e-14);
+		squareOf<double, 2>(111, 1e-14);
+		squareOf<double, 3>(112, 1e-14);
+		squareOf<double, 4>(113, 1e-13);
+		squareOf<double, 5>(114, 1e-13);
+		squareOf<double, 7>(115, 1e-13);
+		squareOf<float, 3>(116, 1e-5);
+		squareOf<float, 4>(117, 1e-5);
+		squareOf<float, 6>(118, 1e-5);
+
+		transposeOf<1, 5>(120);
+		transposeOf<3, 5>(121);
+		transposeOf<5, 3>(122);
+		transposeOf<4, 4>(123);
+
+		// a Matrix of the wrong shape can't become a fixed one
+		auto wrong = randomMatrix<double>(3, 2, 124);
+		using Fixed22 = matrices::FixedMatrix<double, 2, 2>;
+		CHECK_THROWS(Fixed22{ wrong }, std::invalid_argument);
+	}
+
+	Registration fixedMatricesTest("fixedMatrices", fixedMatrices);
+}
@@ -0,0 +1,39 @@
+// Products through the packed gemm kernel against three plain loops
+
+#include "Testing.hpp"
+
+namespace {
+
+	using namespace testing;
+
+	// { m, n, k } with every dimension off the kernel tiles and panels somewhere
+	const int productShapes[][3] = { { 1, 1, 1 }, { 7, 5, 3 }, { 13, 1, 9 }, { 1, 17, 300 }, { 33, 17, 65 }, { 130, 257, 300 }, { 300, 9, 513 } };
+
+	template<class T>
+	void productsOf(double tolerance) {
+		unsigned seed = 1;
+		for (auto& shape : productShapes) {
+			int m = shape[0], n = shape[1], k = shape[2];
+			auto a = randomMatrix<T>(k, m, seed++), b = randomMatrix<T>(n, k, seed++);
+			auto expected = naiveProduct(a, b);
+			CHECK(maxDifference(a * b, expected) <= tolerance * k);
+
+			// transposed operands are read through their strides rather than copied
+			auto at = randomMatrix<T>(m, k, seed++), bt = randomMatrix<T>(k, n, seed++);
+			CHECK(maxDifference(at.view().transposed() * bt.view().transposed(), naiveProduct(at.view().transposed(), bt.view().transposed())) <= tolerance * k);
+
+			matrices::Matrix<T> c = a;
+			c *= b;
+			CHECK(maxDifference(c, expected) <= tolerance * k);
+		}
+		CHECK_THROWS(randomMatrix<T>(3, 2, 1) * randomMatrix<T>(3, 2, 2), std::invalid_argument);
+	}
+
+	void products() {
+		productsOf<double>(1e-14);
+		productsOf<float>(1e-6);
+		productsOf<int>(0);
+	}
+
+	Registration productsTest("products", products);
+}
@@ -0,0 +1,32 @@
+// Matrix vector products, transposed and batched, against three plain loops
+
+#include <vector>
+
+#include "Testing.hpp"
+
+namespace {
+
+	using namespace testing;
+
+	void vectors() {
+		const int shapes[][2] = { { 1, 1 }, { 7, 300 }, { 300, 7 }, { 5000, 9 }, { 9, 5000 } };
+		unsigned seed = 20;
+		for (auto& shape : shapes) {
+			int m = shape[0], n = shape[1];
+			auto a = randomMatrix<double>(n, m, seed++);
+			auto xm = randomMatrix<double>(1, n, seed++), tm = randomMatrix<double>(1, m, seed++);
+			matrices::Vector<double> x(xm), t(tm);
+			CHECK(maxDifference(a * x, naiveProduct(a, xm)) <= 1e-12);
+			CHECK(maxDifference(matrices::multiplyTransposed(a, t), naiveProduct(a.view().transposed(), tm)) <= 1e-12);
+			std::vector<matrices::Vector<double>> batch(3, x);
+			for (auto& y : matrices::multiply(a, batch))
+				CHECK(maxDifference(y, naiveProduct(a, xm)) <= 1e-12);
+		}
+		matrices::Vector<double> u = { 1, 2, 3 }, v = { 4, 5, 6 };
+		CHECK(u.dot(v) == 32);
+		CHECK(std::abs(u.norm() - std::sqrt(14.0)) < 1e-15);
+		CHECK_THROWS(randomMatrix<double>(2, 2, 1) * u, std::invalid_argument);
+	}
+
+	Registration vectorsTest("vectors", vectors);
+}
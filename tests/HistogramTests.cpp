@@ -0,0 +1,97 @@
+// Histogram filling through Fill and FillN, with mock histograms in place of ROOT's
+
+#include <vector>
+
+#include "Testing.hpp"
+
+namespace {
+
+	using namespace testing;
+
+	/// <summary>
+	/// Stands in for a TH1 or TH2 without FillN, the weight of every bin is kept for x * columns + y
+	/// </summary>
+	struct FillHistogram {
+		FillHistogram(int rows, int columns)
+			: columns(columns), weights(static_cast<size_t>(rows) * columns) {}
+
+		void Fill(double x, double w) {
+			weights[static_cast<size_t>(x) * columns] += w;
+		}
+
+		void Fill(double x, double y, double w) {
+			weights[static_cast<size_t>(x) * columns + static_cast<size_t>(y)] += w;
+		}
+
+		int columns;
+		std::vector<double> weights;
+		int calls = 0;
+	};
+
+	/// <summary>
+	/// The same with FillN like TH1 and TH2, which counts how many times it is handed a band
+	/// </summary>
+	struct FillNHistogram : FillHistogram {
+		using FillHistogram::FillHistogram;
+
+		void FillN(int n, const double* x, const double* w) {
+			calls++;
+			for (int i = 0; i < n; i++)
+				Fill(x[i], w[i]);
+		}
+
+		void FillN(int n, const double* x, const double* y, const double* w) {
+			calls++;
+			for (int i = 0; i < n; i++)
+				Fill(x[i], y[i], w[i]);
+		}
+	};
+
+	/// <summary>
+	/// The weights a histogram should end up with, every positive element weighs weight at its row, and column for TwoD
+	/// </summary>
+	std::vector<double> expectedWeights(const matrices::Matrix<int>& m, bool twoD, double weight) {
+		std::vector<double> weights(m.inner_.size());
+		for (int row = 0; row < m.rows(); row++)
+			for (int col = 0; col < m.columns(); col++)
+				if (m.inner_[static_cast<size_t>(row) * m.columns() + col] > 0)
+					weights[static_cast<size_t>(row) * m.columns() + (twoD ? col : 0)] += weight;
+		return weights;
+	}
+
+	void histograms() {
+		// three bands of rows, the last one shorter
+		int columns = 64;
+		int bandRows = static_cast<int>(matrices::detail::HistogramBand) / columns;
+		int rows = 2 * bandRows + 123;
+		auto m = randomMatrix<int>(columns, rows, 130);
+
+		FillHistogram fill(rows, columns);
+		FillNHistogram fillN(rows, columns);
+		m.fillHistogram(&fill, 3);
+		m.fillHistogram(&fillN, 3);
+		auto expected = expectedWeights(m, false, 3);
+		CHECK(fill.weights == expected);
+		CHECK(fillN.weights == expected);
+		CHECK(fillN.calls == 3);
+
+		// the second coordinate is the column of the element
+		FillHistogram fill2D(rows, columns);
+		FillNHistogram fillN2D(rows, columns);
+		m.fill2DHistogram(&fill2D, 2);
+		m.fill2DHistogram(&fillN2D, 2);
+		expected = expectedWeights(m, true, 2);
+		CHECK(fill2D.weights == expected);
+		CHECK(fillN2D.weights == expected);
+		CHECK(fillN2D.calls == 3);
+
+		// a band with nothing positive in it isn't handed over at all
+		matrices::Matrix<int> negative(5, 7);
+		negative.fill(-1);
+		FillNHistogram none(7, 5);
+		negative.fill2DHistogram(&none, 1);
+		CHECK(none.calls == 0 && none.weights == std::vector<double>(35));
+	}
+
+	Registration histogramsTest("histograms", histograms);
+}
@@ -0,0 +1,27 @@
+// Compound assignment that works in the matrix's own storage
+
+#include "Testing.hpp"
+
+namespace {
+
+	using namespace testing;
+
+	void inPlace() {
+		auto square = randomMatrix<double>(6, 6, 72);
+		auto product = naiveProduct(square, square);
+		square *= square;
+		CHECK(maxDifference(square, product) <= 1e-14);
+
+		// a result past the scratch limit goes through a temporary of its own
+		int tall = static_cast<int>(matrices::Matrix<double>::ProductScratchLimit) + 1;
+		auto column = randomMatrix<double>(1, tall, 73);
+		matrices::Matrix<double> scaled = column * 3.0;
+		matrices::Matrix<double> three(2, 1);
+		three.fill(3);
+		column *= three;
+		CHECK(column.columns() == 2 && column.rows() == tall);
+		CHECK(maxDifference(column.column(1), scaled) == 0);
+	}
+
+	Registration inPlaceTest("inPlace", inPlace);
+}
@@ -0,0 +1,60 @@
+// Determinants and inverses through the blocked LU factorisation
+
+#include <cmath>
+#include <cstring>
+
+#include "Testing.hpp"
+
+namespace {
+
+	using namespace testing;
+
+	/// <summary>
+	/// Inverts a singular copy of m, true if it threw and every bit of the copy is still the same
+	/// </summary>
+	template<class M>
+	bool failsUnchanged(const M& m) {
+		M copy = m;
+		try {
+			copy.invert();
+		}
+		catch (const std::invalid_argument&) {
+			return std::memcmp(copy.inner_.data(), m.inner_.data(), sizeof(m.inner_[0]) * m.inner_.size()) == 0;
+		}
+		return false;
+	}
+
+	template<class T>
+	void invertsOf(double tolerance) {
+		unsigned seed = 80;
+		for (int n : { 1, 3, 5, 40, 200 }) {
+			auto a = randomMatrix<T>(n, n, seed++);
+			for (int i = 0; i < n; i++)
+				a.inner_[static_cast<size_t>(i) * n + i] += 4;
+			auto inverse = a;
+			inverse.invert();
+			CHECK(maxDifference(naiveProduct(a, inverse), identity(n)) <= tolerance * n);
+
+			// a zero column makes it singular only once the elimination gets there, rows have been swapped and
+			// the columns before it rounded by then. The copy has to go the in place way, without a cached LU
+			auto singular = randomMatrix<T>(n, n, seed++);
+			for (int i = 0; i < n; i++)
+				singular.inner_[static_cast<size_t>(i) * n + n / 2] = 0;
+			CHECK(failsUnchanged(singular));
+			CHECK(singular.getDeterminant() == 0);
+			CHECK(failsUnchanged(singular));
+		}
+	}
+
+	void inverses() {
+		invertsOf<double>(1e-13);
+		invertsOf<float>(1e-5);
+
+		matrices::FixedMatrix<double, 6, 6> fixed;
+		for (int i = 0; i < 36; i++)
+			fixed.inner_[i] = i % 6 == 4 ? 0 : std::sin(i + 1.0);
+		CHECK(failsUnchanged(fixed));
+	}
+
+	Registration inversesTest("inverses", inverses);
+}
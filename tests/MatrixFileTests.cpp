@@ -0,0 +1,58 @@
+// Binary matrix files, saved, loaded, mapped and with broken headers
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "../MatrixFile.hpp"
+#include "Testing.hpp"
+
+namespace {
+
+	using namespace testing;
+
+	void files() {
+		auto doubles = randomMatrix<double>(9, 4, 61);
+		std::string path = (std::filesystem::temp_directory_path() / "matrix-tests.bin").string();
+		matrices::saveMatrix(doubles, path);
+		CHECK(maxDifference(matrices::loadMatrix<double>(path), doubles) == 0);
+		CHECK(maxDifference(matrices::mapMatrix<double>(path), doubles) == 0);
+		CHECK_THROWS(matrices::loadMatrix<float>(path), std::invalid_argument);
+
+		// dimensions whose byte count wraps around to what the file holds
+		matrices::FileHeader header;
+		{
+			std::ifstream in(path, std::ios::binary);
+			in.read(reinterpret_cast<char*>(&header), sizeof(header));
+		}
+		auto rewrite = [&](const matrices::FileHeader& changed, size_t bytes) {
+			std::ofstream out(path, std::ios::binary | std::ios::trunc);
+			out.write(reinterpret_cast<const char*>(&changed), sizeof(changed));
+			std::vector<char> elements(static_cast<size_t>(changed.dataOffset) + bytes - sizeof(changed));
+			out.write(elements.data(), static_cast<std::streamsize>(elements.size()));
+		};
+		auto wrapping = header;
+		wrapping.columns = 2147352580;
+		wrapping.rows = 1073807362;
+		rewrite(wrapping, 64);
+		CHECK_THROWS(matrices::loadMatrix<double>(path), std::invalid_argument);
+		CHECK_THROWS(matrices::mapMatrix<double>(path), std::invalid_argument);
+
+		// an alignment field that allows an offset a double can't be read from
+		auto misaligned = header;
+		misaligned.columns = 1;
+		misaligned.rows = 1;
+		misaligned.alignment = 1;
+		misaligned.dataOffset = 65;
+		rewrite(misaligned, sizeof(double));
+		CHECK_THROWS(matrices::loadMatrix<double>(path), std::invalid_argument);
+		CHECK_THROWS(matrices::mapMatrix<double>(path), std::invalid_argument);
+		misaligned.dataOffset = 72;
+		rewrite(misaligned, sizeof(double));
+		CHECK(matrices::mapMatrix<double>(path).size() == 1);
+		std::filesystem::remove(path);
+	}
+
+	Registration filesTest("files", files);
+}
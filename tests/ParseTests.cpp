@@ -0,0 +1,33 @@
+// Text and CSV parsing, mostly round trips through toString
+
+#include <string>
+
+#include "../MatrixFile.hpp"
+#include "Testing.hpp"
+
+namespace {
+
+	using namespace testing;
+
+	void parsing() {
+		auto ints = randomMatrix<int>(7, 5, 60);
+		CHECK(maxDifference(matrices::parseMatrix<int>(ints.toString()), ints) == 0);
+		auto doubles = randomMatrix<double>(9, 4, 61);
+		CHECK(maxDifference(matrices::parseMatrix<double>(doubles.toString(matrices::TextFormat::csv())), doubles) == 0);
+		CHECK(matrices::parseMatrix<double>("\n\n").size() == 0);
+		CHECK_THROWS(matrices::parseMatrix<double>("1 2\n3\n"), std::invalid_argument);
+		CHECK_THROWS(matrices::parseMatrix<int>("1 x\n"), std::invalid_argument);
+
+		// big enough to be split into chunks parsed on different threads
+		auto big = randomMatrix<int>(8, 300000, 62);
+		CHECK(maxDifference(matrices::parseMatrix<int>(big.toString(matrices::TextFormat::csv())), big) == 0);
+
+		// one line much longer than a chunk, the cuts after it have to be skipped rather than run backwards
+		std::string longLine = "1 2\n3" + std::string(size_t(3) << 20, ' ') + "4\n5 6\n";
+		auto parsed = matrices::parseMatrix<int>(longLine);
+		CHECK(parsed.columns() == 2 && parsed.rows() == 3);
+		CHECK(parsed.inner_[2] == 3 && parsed.inner_[3] == 4 && parsed.inner_[5] == 6);
+	}
+
+	Registration parsingTest("parsing", parsing);
+}
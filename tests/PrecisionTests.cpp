@@ -0,0 +1,22 @@
+// Products of narrow storage types that are summed in a wider accumulator
+
+#include "Testing.hpp"
+
+namespace {
+
+	using namespace testing;
+
+	void mixedPrecision() {
+		// reduced precision storage is summed in float and rounded once
+		auto a = randomMatrix<float>(300, 40, 1), b = randomMatrix<float>(30, 300, 2);
+		matrices::Matrix<matrices::bfloat16> a16 = a, b16 = b;
+		CHECK(maxDifference(a16 * b16, naiveProduct(a16, b16)) <= 0.1);
+		CHECK(maxDifference(matrices::multiply<double>(a, b), naiveProduct(a, b)) <= 1e-6);
+
+		// more than one band of rows and block of columns of wide sums
+		auto tall = randomMatrix<float>(260, 125, 3), wide = randomMatrix<float>(4090, 260, 4);
+		CHECK(maxDifference(matrices::multiply<double>(tall, wide), naiveProduct(tall, wide)) <= 1e-5);
+	}
+
+	Registration mixedPrecisionTest("mixedPrecision", mixedPrecision);
+}
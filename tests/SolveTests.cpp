@@ -0,0 +1,56 @@
+// LU, Cholesky and QR solves checked by their residuals
+
+#include <vector>
+
+#include "Testing.hpp"
+
+namespace {
+
+	using namespace testing;
+
+	void solves() {
+		unsigned seed = 30;
+		for (int n : { 1, 5, 64, 130 }) {
+			auto a = randomMatrix<double>(n, n, seed++);
+			for (int i = 0; i < n; i++)
+				a.inner_[static_cast<size_t>(i) * n + i] += 4;
+			auto b = randomMatrix<double>(3, n, seed++);
+			CHECK(maxDifference(a * matrices::solve(a, b), b) <= 1e-10);
+			CHECK(maxDifference(a * (a / b), b) <= 1e-10);
+
+			auto spd = randomSpd(n, seed++);
+			CHECK(maxDifference(spd * matrices::solve(spd, b, matrices::Solver::Cholesky), b) <= 1e-10);
+
+			auto copy = spd;
+			auto x = b;
+			matrices::solveInPlace(copy, x, matrices::Solver::Cholesky);
+			CHECK(maxDifference(spd * x, b) <= 1e-10);
+
+			std::vector<double> rhs(b.inner_.begin(), b.inner_.begin() + n);
+			matrices::Vector<double> solution(matrices::solve(a, rhs));
+			CHECK(maxDifference(a * solution, matrices::Vector<double>(rhs)) <= 1e-10);
+		}
+
+		// least squares, the residual of the QR solution is orthogonal to the columns of the design
+		auto design = randomMatrix<double>(7, 200, seed++);
+		auto measured = randomMatrix<double>(2, 200, seed++);
+		auto fit = matrices::solve(design, measured);
+		matrices::Matrix<double> residual = design * fit - measured;
+		CHECK(maxDifference(design.view().transposed() * residual, matrices::Matrix<double>(2, 7)) <= 1e-10);
+
+		// wide enough for the reflectors to be applied to several chunks of columns at once
+		auto wide = randomMatrix<double>(520, 560, seed++);
+		auto wideMeasured = randomMatrix<double>(300, 560, seed++);
+		auto factors = wide;
+		auto wideFit = wideMeasured;
+		matrices::solveInPlace(factors, wideFit, matrices::Solver::QR);
+		matrices::Matrix<double> wideResidual = wide * wideFit - wideMeasured;
+		CHECK(maxDifference(wide.view().transposed() * wideResidual, matrices::Matrix<double>(300, 520)) <= 1e-8);
+
+		matrices::Matrix<double> singular(3, 3);
+		singular.fill(1);
+		CHECK_THROWS(matrices::solve(singular, randomMatrix<double>(1, 3, 1)), std::invalid_argument);
+	}
+
+	Registration solvesTest("solves", solves);
+}
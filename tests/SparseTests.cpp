@@ -0,0 +1,121 @@
+// CSR and CSC matrices against the dense matrices they stand for
+
+#include <random>
+#include <vector>
+
+#include "../SparseMatrix.hpp"
+#include "Testing.hpp"
+
+namespace {
+
+	using namespace testing;
+
+	/// <summary>
+	/// Counts what a sparse matrix fills, one entry per row
+	/// </summary>
+	struct RowCounter {
+		explicit RowCounter(int rows)
+			: counts(rows) {}
+
+		void Fill(double x, double w) {
+			counts[static_cast<size_t>(x)] += w;
+		}
+
+		std::vector<double> counts;
+	};
+
+	/// <summary>
+	/// count random elements of a columns x rows matrix with one row and one column left empty, the
+	/// first few are repeated so there are duplicates to sum
+	/// </summary>
+	std::vector<matrices::SparseEntry<double>> randomEntries(int columns, int rows, int count, unsigned seed) {
+		std::mt19937 generator(seed);
+		std::uniform_int_distribution<int> col(0, columns - 1), row(0, rows - 1);
+		std::uniform_real_distribution<double> value(-1, 1);
+		std::vector<matrices::SparseEntry<double>> entries;
+		while (static_cast<int>(entries.size()) < count) {
+			matrices::SparseEntry<double> entry{ col(generator), row(generator), value(generator) };
+			if (entry.col != columns / 3 && entry.row != rows / 2)
+				entries.push_back(entry);
+		}
+		for (int i = 0; i < count / 10; i++)
+			entries.push_back({ entries[i].col, entries[i].row, value(generator) });
+		return entries;
+	}
+
+	matrices::Matrix<double> denseOf(int columns, int rows, const std::vector<matrices::SparseEntry<double>>& entries) {
+		matrices::Matrix<double> dense(columns, rows);
+		for (auto& entry : entries)
+			dense.inner_[static_cast<size_t>(entry.row) * columns + entry.col] += entry.value;
+		return dense;
+	}
+
+	template<matrices::SparseFormat Format>
+	void sparseOf(int columns, int rows, int count, unsigned seed) {
+		auto entries = randomEntries(columns, rows, count, seed);
+		auto dense = denseOf(columns, rows, entries);
+		matrices::SparseMatrix<double, Format> sparse(columns, rows, entries);
+		CHECK(maxDifference(sparse.toDense(), dense) <= 1e-15);
+		CHECK(sparse.getAt(columns / 3, rows / 2) == 0 && sparse.getAt(columns - 1, rows - 1) == dense.inner_.back());
+
+		matrices::SparseMatrix<double, Format> fromDense(dense);
+		size_t nonZeros = 0;
+		for (double v : dense.inner_)
+			nonZeros += v != 0;
+		CHECK(fromDense.nonZeros() == nonZeros);
+		CHECK(maxDifference(fromDense.toDense(), dense) == 0);
+
+		constexpr auto Other = Format == matrices::SparseFormat::CSR ? matrices::SparseFormat::CSC : matrices::SparseFormat::CSR;
+		matrices::SparseMatrix<double, Other> converted(sparse);
+		CHECK(maxDifference(converted.toDense(), sparse.toDense()) == 0);
+
+		auto xm = randomMatrix<double>(1, columns, seed + 1);
+		std::vector<double> x(xm.inner_.begin(), xm.inner_.end());
+		matrices::Matrix<double> y(1, rows);
+		auto product = sparse * x;
+		std::copy(product.begin(), product.end(), y.inner_.begin());
+		CHECK(maxDifference(y, naiveProduct(dense, xm)) <= 1e-13);
+
+		auto block = randomMatrix<double>(5, columns, seed + 2);
+		CHECK(maxDifference(sparse * block, naiveProduct(dense, block)) <= 1e-13);
+
+		auto rightEntries = randomEntries(7, columns, count / 2 + 1, seed + 3);
+		matrices::SparseMatrix<double, Format> right(7, columns, rightEntries);
+		CHECK(maxDifference((sparse * right).toDense(), naiveProduct(dense, denseOf(7, columns, rightEntries))) <= 1e-13);
+
+		RowCounter counter(rows);
+		sparse.fillHistogram(&counter, 2);
+		bool counted = true;
+		for (int row = 0; row < rows; row++) {
+			int positive = 0;
+			for (int col = 0; col < columns; col++)
+				positive += dense.inner_[static_cast<size_t>(row) * columns + col] > 0;
+			counted = counted && counter.counts[row] == 2.0 * positive;
+		}
+		CHECK(counted);
+
+		CHECK_THROWS(sparse * randomMatrix<double>(2, columns + 1, 1), std::invalid_argument);
+		CHECK_THROWS(sparse.getAt(columns, 0), std::out_of_range);
+	}
+
+	void sparse() {
+		sparseOf<matrices::SparseFormat::CSR>(2, 3, 1, 100);
+		sparseOf<matrices::SparseFormat::CSC>(3, 2, 1, 100);
+		sparseOf<matrices::SparseFormat::CSR>(37, 23, 60, 101);
+		sparseOf<matrices::SparseFormat::CSC>(37, 23, 60, 102);
+		sparseOf<matrices::SparseFormat::CSR>(200, 300, 900, 103);
+		sparseOf<matrices::SparseFormat::CSC>(300, 200, 900, 104);
+
+		// a CSC product big enough to be split across the pool, each chunk of columns sums into its own copy
+		auto entries = randomEntries(1500, 2000, 20000, 105);
+		matrices::CscMatrix<double> wide(1500, 2000, entries);
+		auto block = randomMatrix<double>(16, 1500, 106);
+		CHECK(maxDifference(wide * block, naiveProduct(denseOf(1500, 2000, entries), block)) <= 1e-13);
+
+		matrices::CsrMatrix<double> empty(4, 3);
+		CHECK(empty.nonZeros() == 0 && maxDifference(empty.toDense(), matrices::Matrix<double>(4, 3)) == 0);
+		CHECK_THROWS(matrices::CsrMatrix<double>(2, 2, { { 2, 0, 1.0 } }), std::out_of_range);
+	}
+
+	Registration sparseTest("sparse", sparse);
+}
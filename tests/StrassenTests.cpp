@@ -0,0 +1,25 @@
+// Strassen-Winograd products with a threshold low enough for a few levels of recursion
+
+#include "Testing.hpp"
+
+namespace {
+
+	using namespace testing;
+
+	void strassen() {
+		int threshold = matrices::getStrassenThreshold();
+		matrices::setStrassenThreshold(8);
+		const int shapes[][3] = { { 16, 16, 16 }, { 33, 47, 29 }, { 64, 64, 64 }, { 65, 31, 70 }, { 9, 100, 17 } };
+		unsigned seed = 10;
+		for (auto& shape : shapes) {
+			int m = shape[0], n = shape[1], k = shape[2];
+			auto a = randomMatrix<double>(k, m, seed++), b = randomMatrix<double>(n, k, seed++);
+			CHECK(maxDifference(a * b, naiveProduct(a, b)) <= 1e-12);
+			auto af = randomMatrix<float>(k, m, seed++), bf = randomMatrix<float>(n, k, seed++);
+			CHECK(maxDifference(af * bf, naiveProduct(af, bf)) <= 1e-4);
+		}
+		matrices::setStrassenThreshold(threshold);
+	}
+
+	Registration strassenTest("strassen", strassen);
+}
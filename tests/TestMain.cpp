@@ -0,0 +1,54 @@
+// Correctness checks for Matrix, nothing outside the repository is needed
+//
+//   g++ -std=c++17 -O2 -march=native -pthread tests/*.cpp -o matrix-tests
+//   ./matrix-tests [--filter=solve]
+//
+// Every feature has its own file of tests that registers itself with Testing.hpp. Results are
+// compared with plain loops worked out in double, every failed check is printed with its line and
+// the exit code is 1 if any failed. The pool is started with 4 threads unless MATRICES_NUM_THREADS
+// says otherwise, so the parallel paths are taken on small machines too
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string>
+
+#include "Testing.hpp"
+
+int main(int argc, char** argv) {
+	std::string filter;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg.rfind("--filter=", 0) == 0) {
+			filter = arg.substr(9);
+		}
+		else {
+			std::fprintf(stderr, "usage: %s [--filter=name]\n", argv[0]);
+			return 1;
+		}
+	}
+#if defined(_WIN32)
+	_putenv_s("MATRICES_NUM_THREADS", std::getenv("MATRICES_NUM_THREADS") ? std::getenv("MATRICES_NUM_THREADS") : "4");
+#else
+	setenv("MATRICES_NUM_THREADS", "4", 0);
+#endif
+
+	// the files register in whatever order they are linked, so they're run by name
+	auto tests = testing::registry();
+	std::sort(tests.begin(), tests.end(), [](const testing::Test& l, const testing::Test& r) { return std::strcmp(l.name, r.name) < 0; });
+	for (const testing::Test& test : tests) {
+		if (!filter.empty() && std::string(test.name).find(filter) == std::string::npos)
+			continue;
+		testing::currentTest = test.name;
+		try {
+			test.run();
+		}
+		catch (const std::exception& e) {
+			testing::check(false, e.what(), test.name, 0);
+		}
+	}
+	std::printf("%d checks, %d failed\n", testing::checks, testing::failures);
+	return testing::failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#include "../Matrix.hpp"
+
+namespace testing {
+
+	/// <summary>
+	/// A group of checks that can be picked with --filter
+	/// </summary>
+	struct Test {
+		const char* name;
+		void (*run)();
+	};
+
+	inline std::vector<Test>& registry() {
+		static std::vector<Test> tests;
+		return tests;
+	}
+
+	/// <summary>
+	/// Adds a test to the ones main runs, one of these sits next to every test function
+	/// </summary>
+	struct Registration {
+		Registration(const char* name, void (*run)()) {
+			registry().push_back({ name, run });
+		}
+	};
+
+	inline int checks = 0;
+	inline int failures = 0;
+	inline const char* currentTest = "";
+
+	inline void check(bool ok, const char* what, const char* test, int line) {
+		checks++;
+		if (!ok) {
+			failures++;
+			std::printf("FAILED %s line %d: %s\n", test, line, what);
+		}
+	}
+
+#define CHECK(condition) testing::check((condition), #condition, testing::currentTest, __LINE__)
+
+#define CHECK_THROWS(expression, exception)                  \
+	do {                                                     \
+		bool thrown = false;                                 \
+		try { expression; } catch (const exception&) { thrown = true; } \
+		testing::check(thrown, #expression " throws " #exception, testing::currentTest, __LINE__); \
+	} while (false)
+
+	/// <summary>
+	/// A columns x rows matrix of values between -1 and 1, or -10 and 10 for integers
+	/// </summary>
+	template<class T>
+	matrices::Matrix<T> randomMatrix(int columns, int rows, unsigned seed) {
+		std::mt19937 generator(seed);
+		std::uniform_real_distribution<double> distribution(-1, 1);
+		matrices::Matrix<T> m(columns, rows);
+		for (auto& element : m.inner_)
+			element = static_cast<T>(std::is_integral<T>::value ? std::round(distribution(generator) * 10) : distribution(generator));
+		return m;
+	}
+
+	/// <summary>
+	/// A random symmetric positive definite n x n matrix
+	/// </summary>
+	inline matrices::Matrix<double> randomSpd(int n, unsigned seed) {
+		auto b = randomMatrix<double>(n, n, seed);
+		matrices::Matrix<double> a = b.transposed() * b;
+		for (int i = 0; i < n; i++)
+			a.inner_[static_cast<size_t>(i) * n + i] += n;
+		return a;
+	}
+
+	/// <summary>
+	/// Largest absolute difference between two expressions of the same shape, infinite if the shapes differ
+	/// </summary>
+	template<class L, class R>
+	double maxDifference(const L& l, const R& r) {
+		if (l.columns() != r.columns() || l.rows() != r.rows())
+			return INFINITY;
+		double worst = 0;
+		for (int row = 0; row < l.rows(); row++)
+			for (int col = 0; col < l.columns(); col++) {
+				double d = std::abs(static_cast<double>(l.elementAt(col, row)) - static_cast<double>(r.elementAt(col, row)));
+				worst = std::isnan(d) ? INFINITY : std::max(worst, d);
+			}
+		return worst;
+	}
+
+	/// <summary>
+	/// a * b with three loops in double
+	/// </summary>
+	template<class L, class R>
+	matrices::Matrix<double> naiveProduct(const L& a, const R& b) {
+		matrices::Matrix<double> c(b.columns(), a.rows());
+		for (int i = 0; i < a.rows(); i++)
+			for (int j = 0; j < b.columns(); j++) {
+				double sum = 0;
+				for (int p = 0; p < a.columns(); p++)
+					sum += static_cast<double>(a.elementAt(p, i)) * static_cast<double>(b.elementAt(j, p));
+				c.inner_[static_cast<size_t>(i) * c.dimx_ + j] = sum;
+			}
+		return c;
+	}
+
+	inline matrices::Matrix<double> identity(int n) {
+		matrices::Matrix<double> m(n, n);
+		for (int i = 0; i < n; i++)
+			m.inner_[static_cast<size_t>(i) * n + i] = 1;
+		return m;
+	}
+}
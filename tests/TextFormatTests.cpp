@@ -0,0 +1,45 @@
+// Text output through operator<<, toString and print with different formats
+
+#include <charconv>
+#include <sstream>
+#include <string>
+
+#include "Testing.hpp"
+
+namespace {
+
+	using namespace testing;
+
+	void textFormats() {
+		matrices::Matrix<double> m(2, 2);
+		m.inner_ = { 1, -2.5, 0.125, 3 };
+		CHECK(m.toString() == "(1.000000) (-2.500000) \n(0.125000) (3.000000) ");
+		std::ostringstream streamed;
+		streamed << m;
+		CHECK(streamed.str() == m.toString());
+		CHECK(m.toString(matrices::TextFormat::csv()) == "1,-2.5\n0.125,3");
+
+		matrices::Matrix<int> ints(3, 1);
+		ints.inner_ = { 7, -8, 9 };
+		CHECK(ints.toString(matrices::TextFormat::csv()) == "7,-8,9");
+
+		// enough elements to go through the buffer several times
+		auto big = randomMatrix<double>(300, 200, 140);
+		std::ostringstream printed;
+		big.print(printed, matrices::TextFormat::csv());
+		CHECK(printed.str() == big.toString(matrices::TextFormat::csv()));
+		CHECK(printed.str().size() > (size_t(1) << 16));
+
+		// a single element longer than the whole buffer
+		matrices::TextFormat precise;
+		precise.precision = 20000;
+		matrices::Matrix<double> huge(1, 1);
+		huge.inner_[0] = 1e300;
+		std::string expected(20400, ' ');
+		auto result = std::to_chars(&expected[0], &expected[0] + expected.size(), 1e300, std::chars_format::fixed, 20000);
+		expected.resize(static_cast<size_t>(result.ptr - expected.data()));
+		CHECK(huge.toString(precise) == "(" + expected + ") ");
+	}
+
+	Registration textFormatsTest("textFormats", textFormats);
+}
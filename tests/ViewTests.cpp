@@ -0,0 +1,26 @@
+// Strided views, including ones that read the matrix being written through them
+
+#include "Testing.hpp"
+
+namespace {
+
+	using namespace testing;
+
+	void views() {
+		// expressions that read other positions of the matrix being written
+		auto t = randomMatrix<double>(3, 3, 74);
+		auto transposed = t.transposed();
+		t = t.view().transposed() * 1.0;
+		CHECK(maxDifference(t, transposed) == 0);
+		auto s = randomMatrix<double>(4, 4, 75);
+		matrices::Matrix<double> symmetric = s + s.transposed();
+		s += s.view().transposed();
+		CHECK(maxDifference(s, symmetric) == 0);
+		auto r = randomMatrix<double>(4, 3, 76);
+		matrices::Matrix<double> difference = r - r.transposed().transposed() * 0.5;
+		r -= r.view() * 0.5;
+		CHECK(maxDifference(r, difference) == 0);
+	}
+
+	Registration viewsTest("views", views);
+}